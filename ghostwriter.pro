@@ -112,6 +112,7 @@ HEADERS += src/MainWindow.h \
     src/Token.h \
     src/HtmlPreview.h \
     src/ExportFormat.h \
+    src/ExportJob.h \
     src/Exporter.h \
     src/Theme.h \
     src/ThemeFactory.h \
@@ -123,6 +124,7 @@ HEADERS += src/MainWindow.h \
     src/ThemePreviewer.h \
     src/ThemeEditorDialog.h \
     src/ExporterFactory.h \
+    src/ProcessorProbe.h \
     src/ColorHelper.h \
     src/MarkdownEditorTypes.h \
     src/AppSettings.h \
@@ -137,10 +139,12 @@ HEADERS += src/MainWindow.h \
     src/MessageBoxHelper.h \
     src/GraphicsFadeEffect.h \
     src/SundownExporter.h \
+    src/RenderCache.h \
     src/StyleSheetManagerDialog.h \
     src/SimpleFontDialog.h \
     src/HighlighterLineStates.h \
     src/HighlightTokenizer.h \
+    src/BackgroundTokenizer.h \
     src/MarkdownTokenizer.h \
     src/EffectsMenuBar.h \
     src/TimeLabel.h \
@@ -159,12 +163,14 @@ HEADERS += src/MainWindow.h \
     src/spelling/dictionary_manager.h \
     src/spelling/dictionary_ref.h \
     src/spelling/spell_checker.h \
+    src/spelling/spelling_cache.h \
     src/sundown/autolink.h \
     src/sundown/buffer.h \
     src/sundown/houdini.h \
     src/sundown/html_blocks.h \
     src/sundown/html.h \
     src/sundown/markdown.h \
+    src/sundown/scan.h \
     src/sundown/stack.h
 
 SOURCES += src/AppMain.cpp \
@@ -174,6 +180,7 @@ SOURCES += src/AppMain.cpp \
     src/HtmlPreview.cpp \
     src/Exporter.cpp \
     src/ExportFormat.cpp \
+    src/ExportJob.cpp \
     src/Theme.cpp \
     src/ThemeFactory.cpp \
     src/CommandLineExporter.cpp \
@@ -182,6 +189,7 @@ SOURCES += src/AppMain.cpp \
     src/ThemePreviewer.cpp \
     src/ThemeEditorDialog.cpp \
     src/ExporterFactory.cpp \
+    src/ProcessorProbe.cpp \
     src/ColorHelper.cpp \
     src/AppSettings.cpp \
     src/DocumentManager.cpp \
@@ -195,7 +203,9 @@ SOURCES += src/AppMain.cpp \
     src/StyleSheetManagerDialog.cpp \
     src/SimpleFontDialog.cpp \
     src/SundownExporter.cpp \
+    src/RenderCache.cpp \
     src/HighlightTokenizer.cpp \
+    src/BackgroundTokenizer.cpp \
     src/MarkdownTokenizer.cpp \
     src/EffectsMenuBar.cpp \
     src/TimeLabel.cpp \
@@ -211,6 +221,7 @@ SOURCES += src/AppMain.cpp \
     src/spelling/dictionary_dialog.cpp \
     src/spelling/dictionary_manager.cpp \
     src/spelling/spell_checker.cpp \
+    src/spelling/spelling_cache.cpp \
     src/sundown/autolink.c \
     src/sundown/buffer.c \
     src/sundown/houdini_href_e.c \
@@ -218,6 +229,7 @@ SOURCES += src/AppMain.cpp \
     src/sundown/html_smartypants.c \
     src/sundown/html.c \
     src/sundown/markdown.c \
+    src/sundown/scan.c \
     src/sundown/stack.c
 
 # Allow for updating translations
@@ -0,0 +1,54 @@
+--[[
+  Render worker for ghostwriter's Live HTML Preview.
+
+  Run under the Lua interpreter of pandoc 3 and up, this keeps pandoc
+  loaded between renders:
+
+      pandoc lua render-worker.lua <input format> [--smart]
+
+  Each request is the byte count of a UTF-8 Markdown document on a line of
+  its own, followed by the document.  Each response is a status (0 for
+  success) and the byte count of the HTML (or of the error message) on a
+  line of their own, followed by the HTML or error message.  An empty
+  document is answered with empty HTML, which ghostwriter uses to check
+  that the worker is up.
+--]]
+
+local inputFormat = arg[1] or "markdown"
+local smart = (arg[2] == "--smart")
+local reader = inputFormat .. (smart and "+smart" or "-smart")
+
+local function render(text)
+    return pandoc.write(pandoc.read(text, reader), "html")
+end
+
+io.stdout:setvbuf("full")
+
+while true do
+    local header = io.read("*l")
+    local size = header and tonumber(header)
+
+    if not size then
+        break
+    end
+
+    local text = ""
+
+    if size > 0 then
+        text = io.read(size)
+
+        if not text or #text < size then
+            break
+        end
+    end
+
+    local ok, result = true, ""
+
+    if size > 0 then
+        ok, result = pcall(render, text)
+        result = tostring(result)
+    end
+
+    io.write(ok and 0 or 1, " ", #result, "\n", result)
+    io.flush()
+end
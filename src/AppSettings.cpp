@@ -61,6 +61,7 @@
 #define GW_HUD_ROW_COLORS_KEY "HUD/alternateRowColors"
 #define GW_DESKTOP_COMPOSITING_KEY "HUD/desktopCompositingEnabled"
 #define GW_HUD_OPACITY_KEY "HUD/opacity"
+#define GW_LARGE_DOCUMENT_THRESHOLD_KEY "Performance/largeDocumentThreshold"
 
 AppSettings* AppSettings::instance = NULL;
 
@@ -116,6 +117,7 @@ void AppSettings::store()
     appSettings.setValue(GW_HUD_ROW_COLORS_KEY, QVariant(alternateHudRowColorsEnabled));
     appSettings.setValue(GW_DESKTOP_COMPOSITING_KEY, QVariant(desktopCompositingEnabled));
     appSettings.setValue(GW_HUD_OPACITY_KEY, QVariant(hudOpacity));
+    appSettings.setValue(GW_LARGE_DOCUMENT_THRESHOLD_KEY, QVariant(largeDocumentThreshold));
     appSettings.sync();
 }
 
@@ -466,6 +468,19 @@ void AppSettings::setHudOpacity(int value)
     hudOpacity = value;
 }
 
+int AppSettings::getLargeDocumentThreshold() const
+{
+    return largeDocumentThreshold;
+}
+
+void AppSettings::setLargeDocumentThreshold(int characters)
+{
+    if (characters > 0)
+    {
+        largeDocumentThreshold = characters;
+    }
+}
+
 AppSettings::AppSettings()
 {
     QCoreApplication::setOrganizationName("ghostwriter");
@@ -698,4 +713,10 @@ AppSettings::AppSettings()
     alternateHudRowColorsEnabled = appSettings.value(GW_HUD_ROW_COLORS_KEY, QVariant(false)).toBool();
     desktopCompositingEnabled = appSettings.value(GW_DESKTOP_COMPOSITING_KEY, QVariant(true)).toBool();
     hudOpacity = appSettings.value(GW_HUD_OPACITY_KEY, QVariant(200)).toInt();
+    largeDocumentThreshold = appSettings.value(GW_LARGE_DOCUMENT_THRESHOLD_KEY, QVariant(DEFAULT_LARGE_DOCUMENT_THRESHOLD)).toInt();
+
+    if (largeDocumentThreshold <= 0)
+    {
+        largeDocumentThreshold = DEFAULT_LARGE_DOCUMENT_THRESHOLD;
+    }
 }
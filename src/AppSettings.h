@@ -39,6 +39,7 @@ class AppSettings
         static const int MIN_TAB_WIDTH = 1;
         static const int MAX_TAB_WIDTH = 8;
         static const int DEFAULT_TAB_WIDTH = 4;
+        static const int DEFAULT_LARGE_DOCUMENT_THRESHOLD = 1024 * 1024;
 
         static AppSettings* getInstance();
         ~AppSettings();
@@ -145,6 +146,9 @@ class AppSettings
         int getHudOpacity() const;
         void setHudOpacity(int value);
 
+        int getLargeDocumentThreshold() const;
+        void setLargeDocumentThreshold(int characters);
+
     private:
         AppSettings();
 
@@ -186,6 +190,7 @@ class AppSettings
         bool alternateHudRowColorsEnabled;
         bool desktopCompositingEnabled;
         int hudOpacity;
+        int largeDocumentThreshold;
 };
 
 #endif // APPSETTINGS_H
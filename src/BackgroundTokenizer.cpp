@@ -0,0 +1,266 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QFuture>
+#include <QHash>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QThread>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
+
+#include "BackgroundTokenizer.h"
+#include "MarkdownStates.h"
+#include "MarkdownTokenizer.h"
+
+// Minimum number of blocks in each chunk tokenized by a worker thread, so
+// that small documents aren't split up more than is worthwhile.
+//
+#define GW_TOKENIZER_MIN_CHUNK_SIZE 256
+
+// Maximum number of blocks past an even split at which to look for a blank
+// line to start a chunk on.
+//
+#define GW_TOKENIZER_MAX_CHUNK_SEEK 64
+
+/*
+ * A range of blocks [start, end) of a snapshot to be tokenized by a single
+ * worker thread.
+ */
+struct TokenizerChunk
+{
+    int start;
+    int end;
+    const QStringList* texts;
+    TokenizedBlock* blocks;
+};
+
+static bool isBlankLine(const QString& text)
+{
+    for (int i = 0; i < text.length(); i++)
+    {
+        if (!text[i].isSpace())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void tokenizeBlock
+(
+    MarkdownTokenizer& tokenizer,
+    const QStringList& texts,
+    int index,
+    int previousState,
+    TokenizedBlock& block
+)
+{
+    const QString& text = texts.at(index);
+    int nextState = MarkdownStateUnknown;
+
+    if ((index + 1) < texts.size())
+    {
+        nextState = tokenizer.lookAhead(texts.at(index + 1));
+    }
+
+    tokenizer.clear();
+    tokenizer.tokenize(text, MarkdownStateUnknown, previousState, nextState);
+
+    block.tokens = tokenizer.getTokens();
+    block.textHash = qHash(text);
+    block.textLength = text.length();
+    block.previousState = previousState;
+    block.nextState = nextState;
+    block.state = tokenizer.getState();
+}
+
+static void tokenizeChunk(TokenizerChunk& chunk)
+{
+    MarkdownTokenizer tokenizer;
+
+    // Guess that the chunk follows a blank line, which is what it would
+    // follow at the start of the document.
+    //
+    int previousState = MarkdownStateUnknown;
+
+    for (int i = chunk.start; i < chunk.end; i++)
+    {
+        tokenizeBlock(tokenizer, *chunk.texts, i, previousState, chunk.blocks[i]);
+        previousState = chunk.blocks[i].state;
+    }
+}
+
+BackgroundTokenizer::BackgroundTokenizer
+(
+    QTextDocument* document,
+    QObject* parent
+)
+    : QObject(parent), document(document), restartPending(false)
+{
+    futureWatcher = new QFutureWatcher< QVector<TokenizedBlock> >(this);
+    connect(futureWatcher, SIGNAL(finished()), this, SLOT(onTokenizationFinished()));
+}
+
+BackgroundTokenizer::~BackgroundTokenizer()
+{
+    ;
+}
+
+void BackgroundTokenizer::tokenize()
+{
+    if (isRunning())
+    {
+        restartPending = true;
+        return;
+    }
+
+    restartPending = false;
+
+    QStringList texts;
+    QVector<int> revisions;
+
+    texts.reserve(document->blockCount());
+    revisions.reserve(document->blockCount());
+
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next())
+    {
+        texts.append(block.text());
+        revisions.append(block.revision());
+    }
+
+    QFuture< QVector<TokenizedBlock> > future =
+        QtConcurrent::run
+        (
+            &BackgroundTokenizer::tokenizeSnapshot,
+            texts,
+            revisions
+        );
+
+    futureWatcher->setFuture(future);
+}
+
+bool BackgroundTokenizer::isRunning() const
+{
+    return futureWatcher->isRunning();
+}
+
+const QVector<TokenizedBlock>& BackgroundTokenizer::getResults() const
+{
+    return results;
+}
+
+void BackgroundTokenizer::onTokenizationFinished()
+{
+    if (restartPending)
+    {
+        tokenize();
+        return;
+    }
+
+    results = futureWatcher->result();
+    emit finished();
+}
+
+QVector<TokenizedBlock> BackgroundTokenizer::tokenizeSnapshot
+(
+    const QStringList texts,
+    const QVector<int> revisions
+)
+{
+    int blockCount = texts.size();
+    QVector<TokenizedBlock> blocks(blockCount);
+
+    for (int i = 0; i < blockCount; i++)
+    {
+        blocks[i].revision = revisions.at(i);
+    }
+
+    // Split the blocks into chunks of roughly equal size, one per core,
+    // moving the start of each chunk forward to the next blank line where
+    // possible so that the guessed previous state is likely to be right.
+    //
+    int chunkCount =
+        qMax(1, qMin(QThread::idealThreadCount(), blockCount / GW_TOKENIZER_MIN_CHUNK_SIZE));
+    int chunkSize = blockCount / chunkCount;
+    QVector<TokenizerChunk> chunks;
+    int start = 0;
+
+    chunks.reserve(chunkCount);
+
+    for (int i = 1; i <= chunkCount; i++)
+    {
+        int end = blockCount;
+
+        if (i < chunkCount)
+        {
+            end = qMax(start, i * chunkSize);
+
+            int seekLimit = qMin(blockCount, end + GW_TOKENIZER_MAX_CHUNK_SEEK);
+
+            for (int j = end; j < seekLimit; j++)
+            {
+                if (isBlankLine(texts.at(j)))
+                {
+                    end = j;
+                    break;
+                }
+            }
+        }
+
+        if (end > start)
+        {
+            TokenizerChunk chunk;
+            chunk.start = start;
+            chunk.end = end;
+            chunk.texts = &texts;
+            chunk.blocks = blocks.data();
+            chunks.append(chunk);
+            start = end;
+        }
+    }
+
+    QtConcurrent::blockingMap(chunks, tokenizeChunk);
+
+    // Stitch the chunks together, tokenizing again the blocks at the start
+    // of each chunk whose previous state was guessed wrong.  Once a block's
+    // previous state matches, the rest of its chunk is already correct.
+    // Tokenizing again may run on into the next chunk, whose first block
+    // will then match.
+    //
+    MarkdownTokenizer tokenizer;
+
+    for (int c = 1; c < chunks.size(); c++)
+    {
+        int i = chunks[c].start;
+
+        while
+        (
+            (i < blockCount)
+            && (blocks[i].previousState != blocks[i - 1].state)
+        )
+        {
+            tokenizeBlock(tokenizer, texts, i, blocks[i - 1].state, blocks[i]);
+            i++;
+        }
+    }
+
+    return blocks;
+}
@@ -0,0 +1,130 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef BACKGROUNDTOKENIZER_H
+#define BACKGROUNDTOKENIZER_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "Token.h"
+
+class QTextDocument;
+
+/**
+ * The tokens and line state produced for one block of a document by the
+ * BackgroundTokenizer, along with the inputs that produced them.  The fields
+ * mirror the token cache of TextBlockData, into which they are installed.
+ */
+struct TokenizedBlock
+{
+    int revision;
+    uint textHash;
+    int textLength;
+    int previousState;
+    int nextState;
+    int state;
+    QVector<Token> tokens;
+};
+
+/**
+ * Tokenizes a snapshot of a QTextDocument's blocks with the MarkdownTokenizer
+ * on worker threads, so that large documents can be tokenized without
+ * blocking the user interface.
+ *
+ * The snapshot is split into chunks of blocks, one or more per processor
+ * core, which are tokenized in parallel.  Since a block's line state depends
+ * on the state of the block before it, each chunk (other than the first)
+ * starts by guessing that it follows a blank line.  Once all chunks are
+ * done, any block whose guessed previous state turned out to be wrong is
+ * tokenized again, until the states converge with those that were guessed.
+ * As chunks are split on blank lines, this is rarely more than a line or two
+ * past the start of a chunk.
+ *
+ * Only one snapshot is tokenized at a time.  If tokenize() is called again
+ * while a snapshot is being tokenized, the results of that snapshot are
+ * discarded, and a new snapshot of the document is tokenized once it is
+ * finished.
+ */
+class BackgroundTokenizer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor.  Takes as a parameter the text document whose blocks
+         * are to be tokenized.
+         */
+        BackgroundTokenizer(QTextDocument* document, QObject* parent = NULL);
+
+        /**
+         * Destructor.
+         */
+        virtual ~BackgroundTokenizer();
+
+        /**
+         * Takes a snapshot of the document's blocks and begins tokenizing it
+         * on worker threads.  The finished() signal is emitted when done.
+         */
+        void tokenize();
+
+        /**
+         * Returns true if a snapshot is currently being tokenized.
+         */
+        bool isRunning() const;
+
+        /**
+         * Returns the tokenized blocks of the last snapshot to finish, in
+         * document order.  Each block's revision (see QTextBlock::revision())
+         * at the time of the snapshot is included, so that blocks which have
+         * since been edited can be skipped.
+         */
+        const QVector<TokenizedBlock>& getResults() const;
+
+    signals:
+        /**
+         * Emitted when the results of the latest snapshot are available.
+         */
+        void finished();
+
+    private slots:
+        void onTokenizationFinished();
+
+    private:
+        QTextDocument* document;
+        QFutureWatcher< QVector<TokenizedBlock> >* futureWatcher;
+        QVector<TokenizedBlock> results;
+        bool restartPending;
+
+        /*
+         * Tokenizes the given snapshot of block texts and revisions.  This
+         * method is run on a worker thread.
+         */
+        static QVector<TokenizedBlock> tokenizeSnapshot
+        (
+            const QStringList texts,
+            const QVector<int> revisions
+        );
+
+};
+
+#endif // BACKGROUNDTOKENIZER_H
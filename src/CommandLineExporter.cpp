@@ -18,12 +18,470 @@
  ***********************************************************************/
 
 #include <QProcess>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QObject>
 #include <QDir>
+#include <QHash>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QCoreApplication>
 
 #include "CommandLineExporter.h"
+#include "ExportJob.h"
 
+// Maximum time in milliseconds to wait for a command to finish.
+#define GW_COMMAND_TIMEOUT 30000
+
+// Interval in milliseconds at which a cancelable command is checked for
+// having been canceled while waiting for it to finish.
+//
+#define GW_COMMAND_CANCEL_POLL_INTERVAL 20
+
+// Maximum time in milliseconds to wait for a render worker to start and
+// answer its first (empty) request.
+//
+#define GW_RENDER_WORKER_START_TIMEOUT 10000
+
+// Number of render worker failures in a row after which the worker is
+// given up on.
+//
+#define GW_RENDER_WORKER_MAX_FAILURES 3
+
+/*
+ * A render worker process, which is kept running between renders and fed
+ * documents over the protocol described for
+ * CommandLineExporter::setHtmlRenderWorkerCommand().  Since a QProcess
+ * must be used on the thread that created it, the workers are only used on
+ * the RenderWorkerThread.
+ */
+class RenderWorker
+{
+    public:
+        RenderWorker(const QString& command);
+        ~RenderWorker();
+
+        /*
+         * Starts the worker, and checks that it answers an empty request.
+         * Returns false if the worker could not be started or didn't
+         * answer in time.
+         */
+        bool start(const Exporter* exporter);
+
+        /*
+         * Returns true if the worker's process is still running.
+         */
+        bool isRunning() const;
+
+        /*
+         * Sends the given UTF-8 text to the worker, and reads back the
+         * response, setting succeeded to the response's status and output
+         * to its HTML or error message.  Returns false if the worker
+         * exited, timed out or gave a malformed response, or if the
+         * exporter's HTML export was canceled while waiting, after which the
+         * worker is out of step with its requests and should be discarded.
+         */
+        bool render
+        (
+            const QByteArray& text,
+            bool& succeeded,
+            QByteArray& output,
+            const Exporter* exporter,
+            int timeout = GW_COMMAND_TIMEOUT
+        );
+
+    private:
+        QString command;
+        QProcess process;
+
+        /*
+         * Waits a little for more output from the worker.  Returns false if
+         * there will be no more output in time.
+         */
+        bool waitForOutput
+        (
+            const QElapsedTimer& timer,
+            int timeout,
+            const Exporter* exporter
+        );
+};
+
+RenderWorker::RenderWorker(const QString& command)
+    : command(command)
+{
+    process.setReadChannel(QProcess::StandardOutput);
+}
+
+RenderWorker::~RenderWorker()
+{
+    if (QProcess::NotRunning != process.state())
+    {
+        process.kill();
+        process.waitForFinished();
+    }
+}
+
+bool RenderWorker::start(const Exporter* exporter)
+{
+    bool succeeded = false;
+    QByteArray output;
+
+    process.start(command);
+
+    if (!process.waitForStarted())
+    {
+        return false;
+    }
+
+    return
+        render(QByteArray(), succeeded, output, exporter, GW_RENDER_WORKER_START_TIMEOUT)
+        && succeeded
+        && output.isEmpty();
+}
+
+bool RenderWorker::isRunning() const
+{
+    return QProcess::Running == process.state();
+}
+
+bool RenderWorker::render
+(
+    const QByteArray& text,
+    bool& succeeded,
+    QByteArray& output,
+    const Exporter* exporter,
+    int timeout
+)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    process.write(QByteArray::number(text.size()) + '\n');
+    process.write(text);
+
+    while (!process.canReadLine())
+    {
+        if (!waitForOutput(timer, timeout, exporter))
+        {
+            return false;
+        }
+    }
+
+    QList<QByteArray> header = process.readLine().trimmed().split(' ');
+    bool statusOk = false;
+    bool sizeOk = false;
+
+    if (2 != header.size())
+    {
+        return false;
+    }
+
+    int status = header.at(0).toInt(&statusOk);
+    int size = header.at(1).toInt(&sizeOk);
+
+    if (!statusOk || !sizeOk || (size < 0))
+    {
+        return false;
+    }
+
+    while (process.bytesAvailable() < size)
+    {
+        if (!waitForOutput(timer, timeout, exporter))
+        {
+            return false;
+        }
+    }
+
+    succeeded = (0 == status);
+    output = process.read(size);
+    return true;
+}
+
+bool RenderWorker::waitForOutput
+(
+    const QElapsedTimer& timer,
+    int timeout,
+    const Exporter* exporter
+)
+{
+    if
+    (
+        (QProcess::Running != process.state())
+        || (timer.elapsed() >= timeout)
+        || ((NULL != exporter) && exporter->isHtmlExportCanceled())
+    )
+    {
+        return false;
+    }
+
+    process.waitForReadyRead(GW_COMMAND_CANCEL_POLL_INTERVAL);
+    return true;
+}
+
+/*
+ * The thread owning the render workers, on which every render with a worker
+ * is made.  The workers are kept on a single thread of their own that lasts
+ * as long as the application, rather than on the threads rendering HTML,
+ * which come and go, so that there is a single worker per command.  Renders
+ * are queued and made one at a time, while the threads asking for them
+ * wait.  The thread is stopped along with its workers once the application
+ * quits.
+ */
+class RenderWorkerThread : public QThread
+{
+    public:
+        /*
+         * Gets the thread, starting it if needed.
+         */
+        static RenderWorkerThread* getInstance();
+
+        /*
+         * Renders the given UTF-8 text with the worker for the given
+         * command, starting the worker if needed, and waits for the render
+         * to be done.  Sets succeeded and output as RenderWorker::render()
+         * does, and started to whether the worker was (or already had
+         * been) started.  Returns false if the worker could not be started
+         * or failed, in which case it is stopped, and started again for the
+         * next render.
+         */
+        bool render
+        (
+            const QString& command,
+            const QByteArray& text,
+            const Exporter* exporter,
+            bool& started,
+            bool& succeeded,
+            QByteArray& output
+        );
+
+    protected:
+        void run();
+
+    private:
+        /*
+         * A render waiting to be made, along with its outcome.
+         */
+        struct RenderRequest
+        {
+            QString command;
+            QByteArray text;
+            const Exporter* exporter;
+            bool done;
+            bool started;
+            bool rendered;
+            bool succeeded;
+            QByteArray output;
+        };
+
+        static RenderWorkerThread* instance;
+        static QMutex instanceMutex;
+
+        // Guards the requests and the stopping flag.
+        QMutex mutex;
+        QWaitCondition requestQueued;
+        QWaitCondition requestDone;
+        QList<RenderRequest*> requests;
+        bool stopping;
+
+        // Only used on this thread.
+        QHash<QString, RenderWorker*> workers;
+
+        RenderWorkerThread();
+
+        /*
+         * Makes the given render with its command's worker, on this thread.
+         */
+        void processRequest(RenderRequest* request);
+
+        /*
+         * Stops the thread along with its workers.  Registered to be
+         * called when the application quits.
+         */
+        static void shutdown();
+};
+
+RenderWorkerThread* RenderWorkerThread::instance = NULL;
+QMutex RenderWorkerThread::instanceMutex;
+
+RenderWorkerThread* RenderWorkerThread::getInstance()
+{
+    QMutexLocker locker(&instanceMutex);
+
+    if (NULL == instance)
+    {
+        instance = new RenderWorkerThread();
+
+        // The thread is likely to be first needed on a thread of the
+        // global thread pool, so hand it over to the main thread, which
+        // stops it.
+        //
+        if (NULL != QCoreApplication::instance())
+        {
+            instance->moveToThread(QCoreApplication::instance()->thread());
+        }
+
+        instance->start();
+        qAddPostRoutine(RenderWorkerThread::shutdown);
+    }
+
+    return instance;
+}
+
+bool RenderWorkerThread::render
+(
+    const QString& command,
+    const QByteArray& text,
+    const Exporter* exporter,
+    bool& started,
+    bool& succeeded,
+    QByteArray& output
+)
+{
+    RenderRequest request;
+
+    request.command = command;
+    request.text = text;
+    request.exporter = exporter;
+    request.done = false;
+    request.started = false;
+    request.rendered = false;
+    request.succeeded = false;
+
+    QMutexLocker locker(&mutex);
+
+    if (stopping)
+    {
+        return false;
+    }
+
+    requests.append(&request);
+    requestQueued.wakeOne();
+
+    while (!request.done)
+    {
+        requestDone.wait(&mutex);
+    }
+
+    started = request.started;
+    succeeded = request.succeeded;
+    output = request.output;
+    return request.rendered;
+}
+
+void RenderWorkerThread::run()
+{
+    QMutexLocker locker(&mutex);
+
+    while (!stopping)
+    {
+        if (requests.isEmpty())
+        {
+            requestQueued.wait(&mutex);
+            continue;
+        }
+
+        RenderRequest* request = requests.takeFirst();
+
+        locker.unlock();
+        processRequest(request);
+        locker.relock();
+
+        request->done = true;
+        requestDone.wakeAll();
+    }
+
+    // Fail the renders still waiting, so that they fall back to the HTML
+    // render command.
+    //
+    foreach (RenderRequest* request, requests)
+    {
+        request->done = true;
+    }
+
+    requests.clear();
+    requestDone.wakeAll();
+    locker.unlock();
+
+    qDeleteAll(workers);
+    workers.clear();
+}
+
+RenderWorkerThread::RenderWorkerThread()
+    : QThread(NULL), stopping(false)
+{
+    ;
+}
+
+void RenderWorkerThread::processRequest(RenderRequest* request)
+{
+    RenderWorker* worker = workers.value(request->command, NULL);
+
+    // Start the worker again if it has exited, such as after a crash.
+    if ((NULL != worker) && !worker->isRunning())
+    {
+        workers.remove(request->command);
+        delete worker;
+        worker = NULL;
+    }
+
+    if (NULL == worker)
+    {
+        worker = new RenderWorker(request->command);
+
+        if (!worker->start(request->exporter))
+        {
+            delete worker;
+            return;
+        }
+
+        workers.insert(request->command, worker);
+    }
+
+    request->started = true;
+
+    if
+    (
+        !worker->render
+        (
+            request->text,
+            request->succeeded,
+            request->output,
+            request->exporter
+        )
+    )
+    {
+        // The worker can no longer be told which response belongs to
+        // which request, so stop it.  Another is started for the next
+        // render.
+        //
+        workers.remove(request->command);
+        delete worker;
+        return;
+    }
+
+    request->rendered = true;
+}
+
+void RenderWorkerThread::shutdown()
+{
+    QMutexLocker locker(&instanceMutex);
+
+    if (NULL == instance)
+    {
+        return;
+    }
+
+    instance->mutex.lock();
+    instance->stopping = true;
+    instance->requestQueued.wakeAll();
+    instance->mutex.unlock();
+
+    instance->wait();
+    delete instance;
+    instance = NULL;
+}
 
 const QString CommandLineExporter::OUTPUT_FILE_PATH_VAR = QString("${OUTPUT_FILE_PATH}");
 const QString CommandLineExporter::SMART_TYPOGRAPHY_ARG = QString("${SMART_TYPOGRAPHY_ARG}");
@@ -32,7 +490,9 @@ const QString CommandLineExporter::SMART_TYPOGRAPHY_ARG = QString("${SMART_TYPOG
 CommandLineExporter::CommandLineExporter(const QString& name)
     : Exporter(name), smartTypographyOnArgument(""),
         smartTypographyOffArgument(""),
-        htmlRenderCommand(QString())
+        htmlRenderCommand(QString()),
+        htmlRenderWorkerCommand(QString()),
+        renderWorkerFailures(0)
 {
     ;
 }
@@ -47,6 +507,12 @@ void CommandLineExporter::setHtmlRenderCommand(const QString& command)
     htmlRenderCommand = command;
 }
 
+void CommandLineExporter::setHtmlRenderWorkerCommand(const QString& command)
+{
+    htmlRenderWorkerCommand = command;
+    renderWorkerFailures.fetchAndStoreOrdered(0);
+}
+
 void CommandLineExporter::addFileExportCommand
 (
     const ExportFormat* format,
@@ -77,17 +543,56 @@ void CommandLineExporter::setSmartTypographyOffArgument(const QString& argument)
     smartTypographyOffArgument = argument;
 }
 
-void CommandLineExporter::exportToHtml(const QString& text, QString& html)
+QString CommandLineExporter::getCommand
+(
+    const ExportFormat* format,
+    const ExportOptions& options
+) const
+{
+    if (NULL == format)
+    {
+        return expandSmartTypographyArgument(htmlRenderCommand, options);
+    }
+
+    return expandSmartTypographyArgument(formatToCommandMap.value(format), options);
+}
+
+void CommandLineExporter::exportToHtml
+(
+    const QString& text,
+    const ExportOptions& options,
+    QString& html
+)
 {
     QString stderrOuptut;
+    bool rendered = false;
 
-    if (htmlRenderCommand.isNull() || htmlRenderCommand.isEmpty())
+#if QT_VERSION >= 0x050000
+    int workerFailures = renderWorkerFailures.load();
+#else
+    int workerFailures = renderWorkerFailures;
+#endif
+
+    if
+    (
+        !htmlRenderWorkerCommand.isEmpty()
+        && (workerFailures < GW_RENDER_WORKER_MAX_FAILURES)
+    )
+    {
+        rendered = renderWithWorker(text, options, html, stderrOuptut);
+    }
+
+    if (!rendered && (htmlRenderCommand.isNull() || htmlRenderCommand.isEmpty()))
     {
         html = "<center><b style='color: red'>HTML is not supported for this processor.</b></center>";
         return;
     }
 
-    if (!executeCommand(htmlRenderCommand, QString(), text, QString(), html, stderrOuptut))
+    if
+    (
+        !rendered
+        && !executeCommand(htmlRenderCommand, QString(), text, options, QString(), html, stderrOuptut, true)
+    )
     {
         html = QString("<center><b style='color: red'>") + QObject::tr("Export failed: ") + QString("%1</b></center>)").arg(htmlRenderCommand);
     }
@@ -95,6 +600,10 @@ void CommandLineExporter::exportToHtml(const QString& text, QString& html)
     {
         html = QString("<center><b style='color: red'>") + QObject::tr("Export failed: ") + QString("%1</b></center>").arg(stderrOuptut);
     }
+    else if (!options.headingAnchorPrefix.isNull())
+    {
+        html = addHeadingAnchors(html, options.headingAnchorPrefix);
+    }
 }
 
 void CommandLineExporter::exportToFile
@@ -102,6 +611,7 @@ void CommandLineExporter::exportToFile
     const ExportFormat* format,
     const QString& inputFilePath,
     const QString& text,
+    const ExportOptions& options,
     const QString& outputFilePath,
     QString& err
 )
@@ -117,7 +627,7 @@ void CommandLineExporter::exportToFile
 
     QString command = formatToCommandMap.value(format);
 
-    if (!executeCommand(command, inputFilePath, text, outputFilePath, stdoutOutput, stderrOuptut))
+    if (!executeCommand(command, inputFilePath, text, options, outputFilePath, stdoutOutput, stderrOuptut))
     {
         err = QObject::tr("Failed to execute command: ") + QString("%1").arg(command);
     }
@@ -131,44 +641,124 @@ void CommandLineExporter::exportToFile
     }
 }
 
-bool CommandLineExporter::executeCommand
+ExportJob* CommandLineExporter::createExportJob
 (
-    const QString& command,
+    const ExportFormat* format,
     const QString& inputFilePath,
-    const QString& textInput,
-    const QString& outputFilePath,
+    const QByteArray& text,
+    const ExportOptions& options,
+    const QString& outputFilePath
+)
+{
+    if (!formatToCommandMap.contains(format))
+    {
+        return Exporter::createExportJob(format, inputFilePath, text, options, outputFilePath);
+    }
+
+    QString command = formatToCommandMap.value(format) + QString(" ");
+    QString workingDirectory;
+
+    // Stream stdout to the output file path if the path variable wasn't
+    // set in the command string.
+    //
+    bool redirectOutput = !command.contains(OUTPUT_FILE_PATH_VAR);
+
+    command = expandOutputFilePath(command, outputFilePath);
+    command = expandSmartTypographyArgument(command, options);
+
+    if (!inputFilePath.isNull() && !inputFilePath.isEmpty())
+    {
+        workingDirectory = QFileInfo(inputFilePath).dir().path();
+    }
+
+    return new ProcessExportJob
+    (
+        command,
+        workingDirectory,
+        text,
+        outputFilePath,
+        redirectOutput
+    );
+}
+
+bool CommandLineExporter::renderWithWorker
+(
+    const QString& text,
+    const ExportOptions& options,
     QString& stdoutOutput,
     QString& stderrOutput
 )
 {
-    QProcess process;
-    process.setReadChannel(QProcess::StandardOutput);
+    QString command = expandSmartTypographyArgument(htmlRenderWorkerCommand, options);
+    bool started = false;
+    bool succeeded = false;
+    QByteArray output;
 
-    QString expandedCommand = command + QString(" ");
-
-    if (!outputFilePath.isNull() && !outputFilePath.isEmpty())
+    if
+    (
+        !RenderWorkerThread::getInstance()->render
+        (
+            command,
+            text.toUtf8(),
+            this,
+            started,
+            succeeded,
+            output
+        )
+    )
     {
-        // Redirect stdout to the output file path if the path variable wasn't
-        // set in the command string.
+        if (isHtmlExportCanceled())
+        {
+            return false;
+        }
+
+        // A worker that couldn't be started at all, such as with a
+        // processor that can't run the worker script, is given up on
+        // right away, so that renders go back to the HTML render command
+        // without waiting on the worker each time.
         //
-        if (!expandedCommand.contains(OUTPUT_FILE_PATH_VAR))
+        if (started)
         {
-            process.setStandardOutputFile(outputFilePath);
+            renderWorkerFailures.fetchAndAddOrdered(1);
         }
         else
         {
-            // Surround file path with quotes in case there are spaces in the
-            // path.
-            //
-            QString outputFilePathWithQuotes = QString('\"') +
-                outputFilePath + '\"';
-            expandedCommand.replace(OUTPUT_FILE_PATH_VAR, outputFilePathWithQuotes);
+            renderWorkerFailures.fetchAndStoreOrdered(GW_RENDER_WORKER_MAX_FAILURES);
+        }
+
+        return false;
+    }
+
+    renderWorkerFailures.fetchAndStoreOrdered(0);
+
+    if (succeeded)
+    {
+        stdoutOutput = QString::fromUtf8(output.data(), output.size());
+    }
+    else
+    {
+        stderrOutput = QString::fromUtf8(output.data(), output.size());
+
+        if (stderrOutput.isEmpty())
+        {
+            stderrOutput = QObject::tr("Render worker failed");
         }
     }
 
+    return true;
+}
+
+QString CommandLineExporter::expandSmartTypographyArgument
+(
+    const QString& command,
+    const ExportOptions& options
+) const
+{
+    QString expandedCommand = command;
+
     if
     (
-        this->getSmartTypographyEnabled() &&
+        options.smartTypographyEnabled &&
         !this->smartTypographyOnArgument.isNull()
     )
     {
@@ -180,7 +770,7 @@ bool CommandLineExporter::executeCommand
     }
     else if
     (
-        !this->getSmartTypographyEnabled() &&
+        !options.smartTypographyEnabled &&
         !this->smartTypographyOffArgument.isNull()
     )
     {
@@ -191,6 +781,61 @@ bool CommandLineExporter::executeCommand
         );
     }
 
+    return expandedCommand;
+}
+
+QString CommandLineExporter::expandOutputFilePath
+(
+    const QString& command,
+    const QString& outputFilePath
+) const
+{
+    QString expandedCommand = command;
+
+    // Surround file path with quotes in case there are spaces in the
+    // path.
+    //
+    QString outputFilePathWithQuotes = QString('\"') +
+        outputFilePath + '\"';
+    expandedCommand.replace(OUTPUT_FILE_PATH_VAR, outputFilePathWithQuotes);
+
+    return expandedCommand;
+}
+
+bool CommandLineExporter::executeCommand
+(
+    const QString& command,
+    const QString& inputFilePath,
+    const QString& textInput,
+    const ExportOptions& options,
+    const QString& outputFilePath,
+    QString& stdoutOutput,
+    QString& stderrOutput,
+    bool cancelable
+)
+{
+    QProcess process;
+    process.setReadChannel(QProcess::StandardOutput);
+
+    QString expandedCommand = command + QString(" ");
+
+    if (!outputFilePath.isNull() && !outputFilePath.isEmpty())
+    {
+        // Redirect stdout to the output file path if the path variable wasn't
+        // set in the command string.
+        //
+        if (!expandedCommand.contains(OUTPUT_FILE_PATH_VAR))
+        {
+            process.setStandardOutputFile(outputFilePath);
+        }
+        else
+        {
+            expandedCommand = expandOutputFilePath(expandedCommand, outputFilePath);
+        }
+    }
+
+    expandedCommand = expandSmartTypographyArgument(expandedCommand, options);
+
     if (!inputFilePath.isNull() && !inputFilePath.isEmpty())
     {
         process.setWorkingDirectory(QFileInfo(inputFilePath).dir().path());
@@ -210,15 +855,40 @@ bool CommandLineExporter::executeCommand
             process.closeWriteChannel();
         }
 
-        if (!process.waitForFinished())
+        if (!cancelable)
         {
-            return false;
+            if (!process.waitForFinished(GW_COMMAND_TIMEOUT))
+            {
+                return false;
+            }
         }
         else
         {
-            stdoutOutput = QString::fromUtf8(process.readAllStandardOutput().data());
-            stderrOutput = QString::fromUtf8(process.readAllStandardError().data());
+            QElapsedTimer timer;
+            timer.start();
+
+            while (!process.waitForFinished(GW_COMMAND_CANCEL_POLL_INTERVAL))
+            {
+                if
+                (
+                    (QProcess::NotRunning == process.state())
+                    || (timer.elapsed() >= GW_COMMAND_TIMEOUT)
+                )
+                {
+                    return false;
+                }
+
+                if (isHtmlExportCanceled())
+                {
+                    process.kill();
+                    process.waitForFinished();
+                    return false;
+                }
+            }
         }
+
+        stdoutOutput = QString::fromUtf8(process.readAllStandardOutput().data());
+        stderrOutput = QString::fromUtf8(process.readAllStandardError().data());
     }
 
     return true;
@@ -22,6 +22,7 @@
 
 #include <QString>
 #include <QMap>
+#include <QAtomicInt>
 
 #include "Exporter.h"
 
@@ -52,6 +53,31 @@ class CommandLineExporter : public Exporter
          */
         void setHtmlRenderCommand(const QString& command);
 
+        /**
+         * Sets the command with which to start a render worker, that is, a
+         * processor that is kept running between renders for the Live HTML
+         * Preview, saving the cost of starting the processor for each
+         * render.  Documents are sent to the worker over its stdin, and
+         * their HTML read back from its stdout, using the following
+         * protocol.  Each request is the byte count of a UTF-8 document on
+         * a line of its own, followed by the document.  Each response is a
+         * status (0 for success) and the byte count of the HTML (or of the
+         * error message) on a line of their own, followed by the HTML or
+         * error message.  An empty document must be answered with empty
+         * HTML, which is used to check that the worker is up once it has
+         * been started.
+         *
+         * A worker that has exited is started again for the next render,
+         * whereas a worker that stops answering is killed.  Renders fall
+         * back to the HTML render command while the worker can't be used.
+         * The worker is given up on after several failures in a row, or
+         * straight away if it can't be started and answer its first
+         * request.
+         * As with the HTML render command, you can add the value of the
+         * SMART_TYPOGRAPHY_ARG constant to the command string.
+         */
+        void setHtmlRenderWorkerCommand(const QString& command);
+
         /**
          * Adds a command to execute for exporting text to the specified
          * export format.
@@ -87,10 +113,29 @@ class CommandLineExporter : public Exporter
         void setSmartTypographyOffArgument(const QString& argument);
 
         /**
-         * Exports the given text to html, returning the HTML in the html
-         * parameter for use in the Live HTML Preview.
+         * Returns the command run to export to the given format, or the
+         * HTML render command if the format is NULL, with its smart
+         * typography argument expanded according to the given options.
+         */
+        QString getCommand
+        (
+            const ExportFormat* format,
+            const ExportOptions& options
+        ) const;
+
+        /**
+         * Exports the given text to html with the given options, returning
+         * the HTML in the html parameter for use in the Live HTML Preview.
+         * If cancelHtmlExport() is called while the command (or render
+         * worker) is running, the command's process (or the worker) is
+         * killed.
          */
-        void exportToHtml(const QString& text, QString& html);
+        void exportToHtml
+        (
+            const QString& text,
+            const ExportOptions& options,
+            QString& html
+        );
 
         /**
          * Exports the given text to the given format and output file path.
@@ -102,10 +147,28 @@ class CommandLineExporter : public Exporter
             const ExportFormat* format,
             const QString& inputFilePath,
             const QString& text,
+            const ExportOptions& options,
             const QString& outputFilePath,
             QString& err
         );
 
+        /**
+         * Creates a job to export the given text to the given format and
+         * output file path in the background.  The text is fed to the
+         * command in chunks, and the command's stdout, if it doesn't write
+         * the output file itself, is written straight to the file.  The
+         * command is not timed out, and canceling the job kills the command
+         * along with any processes it started.
+         */
+        ExportJob* createExportJob
+        (
+            const ExportFormat* format,
+            const QString& inputFilePath,
+            const QByteArray& text,
+            const ExportOptions& options,
+            const QString& outputFilePath
+        );
+
         /**
          * Contains the variable string for output file path.  Callers can
          * set this exporter to use a command having the output file path
@@ -168,15 +231,54 @@ class CommandLineExporter : public Exporter
         QString smartTypographyOnArgument;
         QString smartTypographyOffArgument;
         QString htmlRenderCommand;
+        QString htmlRenderWorkerCommand;
+        QAtomicInt renderWorkerFailures;
+
+        /*
+         * Renders the given text with the render worker for the expanded
+         * worker command, starting the worker if needed.  Returns false if
+         * the worker failed, in which case the text should be rendered with
+         * the HTML render command instead.
+         */
+        bool renderWithWorker
+        (
+            const QString& text,
+            const ExportOptions& options,
+            QString& stdoutOutput,
+            QString& stderrOutput
+        );
+
+        /*
+         * Returns the given command with the smart typography argument
+         * variable replaced according to whether smart typography is
+         * enabled in the given options.
+         */
+        QString expandSmartTypographyArgument
+        (
+            const QString& command,
+            const ExportOptions& options
+        ) const;
+
+        /*
+         * Returns the given command with the output file path variable
+         * replaced by the given output file path.
+         */
+        QString expandOutputFilePath
+        (
+            const QString& command,
+            const QString& outputFilePath
+        ) const;
 
         bool executeCommand
         (
             const QString& command,
             const QString& inputFilePath,
             const QString& textInput,
+            const ExportOptions& options,
             const QString& outputFilePath,
             QString& stdoutOutput,
-            QString& stderrOutput
+            QString& stderrOutput,
+            bool cancelable = false
         );
 
 
@@ -44,6 +44,7 @@
 #include "MarkdownHighlighter.h"
 #include "MarkdownTokenizer.h"
 #include "ExportDialog.h"
+#include "ExportJob.h"
 #include "MessageBoxHelper.h"
 #include "ThemeFactory.h"
 
@@ -438,12 +439,41 @@ void DocumentManager::exportFile()
 {
     ExportDialog exportDialog(document);
 
-    connect(&exportDialog, SIGNAL(exportStarted(QString)), this, SIGNAL(operationStarted(QString)));
-    connect(&exportDialog, SIGNAL(exportComplete()), this, SIGNAL(operationFinished()));
+    connect(&exportDialog, SIGNAL(exportStarted(ExportJob*)), this, SLOT(onExportStarted(ExportJob*)));
 
     exportDialog.exec();
 }
 
+void DocumentManager::onExportStarted(ExportJob* job)
+{
+    connect(job, SIGNAL(progress(QString)), this, SIGNAL(operationUpdate(QString)));
+    connect(job, SIGNAL(finished(QString)), this, SLOT(onExportFinished(QString)));
+
+    ExportBatchJob* batch = qobject_cast<ExportBatchJob*>(job);
+
+    if (NULL != batch)
+    {
+        connect(batch, SIGNAL(summaryReady(QString)), this, SLOT(onExportSummaryReady(QString)));
+    }
+
+    emit operationStarted(job->getDescription());
+}
+
+void DocumentManager::onExportFinished(const QString& err)
+{
+    emit operationFinished();
+
+    if (!err.isNull())
+    {
+        MessageBoxHelper::critical(parentWidget, tr("Export failed."), err);
+    }
+}
+
+void DocumentManager::onExportSummaryReady(const QString& summary)
+{
+    MessageBoxHelper::information(parentWidget, tr("Export complete."), summary);
+}
+
 void DocumentManager::printPreview()
 {
     QPrintPreviewDialog printPreviewDialog(&printer, parentWidget);
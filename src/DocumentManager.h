@@ -31,6 +31,7 @@
 #include "TextDocument.h"
 
 class QFileSystemWatcher;
+class ExportJob;
 
 /**
  * Manages the life-cycle of a document, facilitating user interaction for
@@ -222,6 +223,9 @@ class DocumentManager : public QObject
         void onFileChangedExternally(const QString& path);
         void printFileToPrinter(QPrinter* printer);
         void autoSaveFile();
+        void onExportStarted(ExportJob* job);
+        void onExportFinished(const QString& err);
+        void onExportSummaryReady(const QString& summary);
 
     private:
         static const QString FILE_CHOOSER_FILTER;
@@ -17,6 +17,7 @@
  *
  ***********************************************************************/
 
+#include <QFile>
 #include <QFileInfo>
 #include <QList>
 #include <QString>
@@ -27,6 +28,9 @@
 #include <QGroupBox>
 #include <QComboBox>
 #include <QCheckBox>
+#include <QPushButton>
+#include <QMenu>
+#include <QAction>
 #include <QLabel>
 #include <QSettings>
 #include <QDesktopServices>
@@ -35,10 +39,13 @@
 #include "ExportDialog.h"
 #include "ExporterFactory.h"
 #include "Exporter.h"
+#include "ExportJob.h"
+#include "RenderCache.h"
 #include "MessageBoxHelper.h"
 
 #define GW_LAST_EXPORTER_KEY "Export/lastUsedExporter"
 #define GW_SMART_TYPOGRAPHY_KEY "Export/smartTypographyEnabled"
+#define GW_EXPORT_PROFILE_KEY "Export/profileFormats"
 
 ExportDialog::ExportDialog(TextDocument* document, QWidget* parent)
     : QDialog(parent), document(document)
@@ -93,38 +100,14 @@ ExportDialog::ExportDialog(TextDocument* document, QWidget* parent)
     int selectedIndex = 0;
 
     QSettings settings;
-    QString lastExporterName =
+    preferredExporterName =
         settings.value(GW_LAST_EXPORTER_KEY, QString()).toString();
 
     for (int i = 0; i < exporters.length(); i++)
     {
-        Exporter* exporter = exporters[i];
+        addExporter(exporters[i]);
 
-        exporterComboBox->addItem
-        (
-            exporter->getName(),
-            qVariantFromValue((void *) exporters[i])
-        );
-
-        QList<const ExportFormat*> formats =
-            exporter->getSupportedFormats();
-
-        // Build file filter list
-        QString filter = "";
-
-        for (int j = 0; j < formats.length(); j++)
-        {
-            filter += formats[j]->getNamedFilter();
-
-            if ((j + 1) < formats.length())
-            {
-                filter += QString(";;");
-            }
-        }
-
-        fileFilters.append(filter);
-
-        if (exporter->getName() == lastExporterName)
+        if (exporters[i]->getName() == preferredExporterName)
         {
             selectedIndex = i;
         }
@@ -190,11 +173,20 @@ ExportDialog::ExportDialog(TextDocument* document, QWidget* parent)
     smartTypographyCheckBox = new QCheckBox(tr("Smart Typography"));
     smartTypographyCheckBox->setChecked(smartTypographyEnabled);
 
+    profileFormatNames =
+        settings.value(GW_EXPORT_PROFILE_KEY, QStringList()).toStringList();
+    profileMenu = new QMenu(this);
+    profileButton = new QPushButton();
+    profileButton->setMenu(profileMenu);
+    buildProfileMenu(exporters[selectedIndex]);
+
     QGroupBox* optionsGroupBox = new QGroupBox(tr("Export Options"));
     QGridLayout* optionsLayout = new QGridLayout();
     optionsLayout->addWidget(new QLabel(tr("Markdown Converter:")), 0, 0, 1, 1);
     optionsLayout->addWidget(exporterComboBox, 0, 1, 1, 1, Qt::AlignLeft);
     optionsLayout->addWidget(smartTypographyCheckBox, 0, 2, 1, 2);
+    optionsLayout->addWidget(new QLabel(tr("Also Export To:")), 1, 0, 1, 1);
+    optionsLayout->addWidget(profileButton, 1, 1, 1, 3, Qt::AlignLeft);
     optionsGroupBox->setLayout(optionsLayout);
 
     QVBoxLayout* layout = new QVBoxLayout(this);
@@ -204,13 +196,24 @@ ExportDialog::ExportDialog(TextDocument* document, QWidget* parent)
 
     connect(exporterComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(onExporterChanged(int)));
     connect(fileDialogWidget, SIGNAL(filterSelected(QString)), this, SLOT(onFilterSelected(QString)));
+    connect(profileMenu, SIGNAL(triggered(QAction*)), this, SLOT(onProfileFormatToggled(QAction*)));
+    connect(ExporterFactory::getInstance(), SIGNAL(exportersAdded()), this, SLOT(onExportersAdded()));
 }
 
 ExportDialog::~ExportDialog()
 {
     QSettings settings;
-    settings.setValue(GW_LAST_EXPORTER_KEY, exporterComboBox->currentText());
+    QString exporterName = exporterComboBox->currentText();
+
+    // Keep the exporter last used if it has yet to be found.
+    if (!ExporterFactory::getInstance()->isDiscoveryFinished())
+    {
+        exporterName = preferredExporterName;
+    }
+
+    settings.setValue(GW_LAST_EXPORTER_KEY, exporterName);
     settings.setValue(GW_SMART_TYPOGRAPHY_KEY, smartTypographyCheckBox->isChecked());
+    settings.setValue(GW_EXPORT_PROFILE_KEY, profileFormatNames);
 }
 
 void ExportDialog::accept()
@@ -228,36 +231,152 @@ void ExportDialog::accept()
         QVariant exporterVariant = exporterComboBox->itemData(selectedIndex);
         Exporter* exporter = (Exporter*) exporterVariant.value<void*>();
 
+        const ExportFormat* selectedFormat = NULL;
+
         foreach (const ExportFormat* format, exporter->getSupportedFormats())
         {
             if (format->getNamedFilter() == selectedFilter)
             {
-                QString err;
+                selectedFormat = format;
+                break;
+            }
+        }
+
+        if (NULL == selectedFormat)
+        {
+            return;
+        }
+
+        // Export in the background, so that the editor can be used in the
+        // meantime.  The text is encoded only once, and shared by the jobs
+        // for each format in the export profile, as are the options.
+        //
+        ExportOptions options;
+        options.smartTypographyEnabled = smartTypographyCheckBox->isChecked();
+
+        // Name the files for the other formats in the profile after the
+        // selected file, skipping formats whose file would overwrite one
+        // already being exported.
+        //
+        QFileInfo outputFileInfo(fileName);
+        QStringList outputFilePaths;
+        QList<const ExportFormat*> profileFormats;
+        QStringList existingFilePaths;
+        QStringList collidingFormatNames;
+
+        outputFilePaths << fileName;
+
+        foreach (const ExportFormat* format, exporter->getSupportedFormats())
+        {
+            if
+            (
+                (format == selectedFormat)
+                || !profileFormatNames.contains(format->getName())
+            )
+            {
+                continue;
+            }
 
-                QApplication::setOverrideCursor(Qt::WaitCursor);
-                emit exportStarted(tr("exporting to %1").arg(fileName));
+            QString outputFilePath = outputFileInfo.completeBaseName();
+            QString fileSuffix = format->getDefaultFileExtension();
 
-                exporter->setSmartTypographyEnabled(smartTypographyCheckBox->isChecked());
-                exporter->exportToFile
+            if (!fileSuffix.isNull() && !fileSuffix.isEmpty())
+            {
+                outputFilePath += "." + fileSuffix;
+            }
+
+            outputFilePath = outputFileInfo.dir().filePath(outputFilePath);
+
+            if (outputFilePaths.contains(outputFilePath))
+            {
+                collidingFormatNames << format->getName();
+                continue;
+            }
+
+            outputFilePaths << outputFilePath;
+            profileFormats << format;
+
+            if (QFile::exists(outputFilePath))
+            {
+                existingFilePaths << outputFilePath;
+            }
+        }
+
+        // The file dialog has only asked about replacing the selected file,
+        // so ask about the files of the other formats as well.
+        //
+        bool replaceExistingFiles = true;
+
+        if (!existingFilePaths.isEmpty())
+        {
+            int response =
+                MessageBoxHelper::question
                 (
-                    format,
-                    this->document->getFilePath(),
-                    document->toPlainText(),
-                    fileName,
-                    err
+                    this,
+                    tr("Files for other formats in the export profile already exist:") +
+                        QString("\n\n") + existingFilePaths.join("\n"),
+                    tr("Would you like to replace them?  Choose No to skip those formats."),
+                    QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel,
+                    QMessageBox::No
                 );
 
-                emit exportComplete();
-                QApplication::restoreOverrideCursor();
+            if (QMessageBox::Cancel == response)
+            {
+                return;
+            }
+
+            replaceExistingFiles = (QMessageBox::Yes == response);
+        }
+
+        QByteArray text = document->toPlainText().toUtf8();
+        ExportJob* job =
+            createExportJob(exporter, selectedFormat, text, options, fileName);
+
+        if (!profileFormats.isEmpty() || !collidingFormatNames.isEmpty())
+        {
+            ExportBatchJob* batch = new ExportBatchJob(fileName);
+
+            batch->addJob(selectedFormat->getName(), job);
+            job = batch;
+
+            for (int i = 0; i < profileFormats.size(); i++)
+            {
+                const ExportFormat* format = profileFormats.at(i);
+                QString outputFilePath = outputFilePaths.at(i + 1);
 
-                if (!err.isNull())
+                if
+                (
+                    !replaceExistingFiles
+                    && existingFilePaths.contains(outputFilePath)
+                )
                 {
-                    MessageBoxHelper::critical(this, tr("Export failed."), err);
+                    batch->addSkippedFormat
+                    (
+                        format->getName(),
+                        tr("%1 already exists").arg(outputFilePath)
+                    );
+                    continue;
                 }
 
-                break;
+                batch->addJob
+                (
+                    format->getName(),
+                    createExportJob(exporter, format, text, options, outputFilePath)
+                );
+            }
+
+            foreach (QString formatName, collidingFormatNames)
+            {
+                batch->addSkippedFormat
+                (
+                    formatName,
+                    tr("its file would overwrite that of another format")
+                );
             }
         }
+
+        emit exportStarted(job);
+        job->start();
     }
 }
 
@@ -272,6 +391,8 @@ void ExportDialog::onExporterChanged(int index)
     QVariant exporterVariant = exporterComboBox->itemData(index);
     Exporter* exporter = (Exporter*) exporterVariant.value<void*>();
 
+    preferredExporterName = exporter->getName();
+
     if (exporter->getSupportedFormats().length() > 0)
     {
         const ExportFormat* format = exporter->getSupportedFormats().at(0);
@@ -283,6 +404,7 @@ void ExportDialog::onExporterChanged(int index)
     }
 
     fileDialogWidget->setNameFilter(fileFilters[index]);
+    buildProfileMenu(exporter);
 }
 
 void ExportDialog::onFilterSelected(const QString& filter)
@@ -304,3 +426,162 @@ void ExportDialog::onFilterSelected(const QString& filter)
         }
     }
 }
+
+void ExportDialog::onExportersAdded()
+{
+    QList<Exporter*> exporters =
+        ExporterFactory::getInstance()->getFileExporters();
+    int preferredIndex = -1;
+
+    for (int i = 0; i < exporters.length(); i++)
+    {
+        int index = exporterComboBox->count() - 1;
+
+        while
+        (
+            (index >= 0)
+            && (exporterComboBox->itemData(index).value<void*>() != exporters[i])
+        )
+        {
+            index--;
+        }
+
+        if (index < 0)
+        {
+            addExporter(exporters[i]);
+            index = exporterComboBox->count() - 1;
+        }
+
+        if (exporters[i]->getName() == preferredExporterName)
+        {
+            preferredIndex = index;
+        }
+    }
+
+    if ((preferredIndex >= 0) && (preferredIndex != exporterComboBox->currentIndex()))
+    {
+        exporterComboBox->setCurrentIndex(preferredIndex);
+    }
+}
+
+void ExportDialog::onProfileFormatToggled(QAction* action)
+{
+    QString formatName = action->data().toString();
+
+    profileFormatNames.removeAll(formatName);
+
+    if (action->isChecked())
+    {
+        profileFormatNames.append(formatName);
+    }
+
+    updateProfileButton();
+}
+
+void ExportDialog::buildProfileMenu(Exporter* exporter)
+{
+    profileMenu->clear();
+
+    foreach (const ExportFormat* format, exporter->getSupportedFormats())
+    {
+        QAction* action = profileMenu->addAction(format->getName());
+
+        action->setData(format->getName());
+        action->setCheckable(true);
+        action->setChecked(profileFormatNames.contains(format->getName()));
+    }
+
+    updateProfileButton();
+}
+
+void ExportDialog::updateProfileButton()
+{
+    QStringList checkedFormatNames;
+
+    foreach (QAction* action, profileMenu->actions())
+    {
+        if (action->isChecked())
+        {
+            checkedFormatNames << action->text();
+        }
+    }
+
+    if (checkedFormatNames.isEmpty())
+    {
+        profileButton->setText(tr("No Other Formats"));
+    }
+    else
+    {
+        profileButton->setText(checkedFormatNames.join(", "));
+    }
+}
+
+ExportJob* ExportDialog::createExportJob
+(
+    Exporter* exporter,
+    const ExportFormat* format,
+    const QByteArray& text,
+    const ExportOptions& options,
+    const QString& outputFilePath
+)
+{
+    // The document's path is part of the key, since relative paths to
+    // images and the like are resolved against its directory, as are the
+    // files it refers to, which may be embedded in the exported file.
+    //
+    QString variant = document->getFilePath() + QString("\n") +
+        RenderCache::describeReferencedFiles(text, document->getFilePath());
+    QByteArray key =
+        RenderCache::computeKey
+        (
+            exporter,
+            format,
+            options,
+            variant,
+            text
+        );
+
+    if (RenderCache::getInstance()->containsFile(key))
+    {
+        return new CachedExportJob(key, outputFilePath);
+    }
+
+    ExportJob* job = exporter->createExportJob
+    (
+        format,
+        document->getFilePath(),
+        text,
+        options,
+        outputFilePath
+    );
+
+    job->setCacheKey(key);
+    return job;
+}
+
+void ExportDialog::addExporter(Exporter* exporter)
+{
+    exporterComboBox->addItem
+    (
+        exporter->getName(),
+        qVariantFromValue((void *) exporter)
+    );
+
+    QList<const ExportFormat*> formats =
+        exporter->getSupportedFormats();
+
+    // Build file filter list
+    QString filter = "";
+
+    for (int j = 0; j < formats.length(); j++)
+    {
+        filter += formats[j]->getNamedFilter();
+
+        if ((j + 1) < formats.length())
+        {
+            filter += QString(";;");
+        }
+    }
+
+    fileFilters.append(filter);
+}
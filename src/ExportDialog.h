@@ -24,16 +24,24 @@
 
 #include "TextDocument.h"
 
+class Exporter;
+class ExportFormat;
+class ExportJob;
+struct ExportOptions;
 class QFileDialog;
 class QComboBox;
 class QCheckBox;
+class QPushButton;
+class QMenu;
+class QAction;
 
 /**
  * A custom file dialog for exporting a document to a number of formats.  Export
  * logic is performed by Exporters, which are provided by ExporterFactory.  The
  * user can select which exporter to use in a combo box.  Also, an option for
  * enabling/disabling smart typography during export is provided in the form of
- * a checkbox.
+ * a checkbox.  The user can also pick further formats to export to alongside
+ * the selected one, which are remembered as an export profile.
  */
 class ExportDialog : public QDialog
 {
@@ -49,19 +57,14 @@ class ExportDialog : public QDialog
 
     signals:
         /**
-         * Emitted when an export operation has begun, so that some sort of
-         * notification can be provided to the user by the calling program,
-         * such as displaying a progress bar.
+         * Emitted when the user has accepted the dialog and the export is
+         * about to begin in the background, so that the calling program can
+         * connect to the job's signals to keep the user informed of its
+         * progress, such as with a progress bar, and of its outcome.  The
+         * job outlives the dialog, and is started once this signal has been
+         * handled.
          */
-        void exportStarted(const QString& description);
-
-        /**
-         * Emitted when an exprot operation has completed, so that some sort of
-         * notification can be provided to the user by the calling program,
-         * such as removing a progress bar previously shown when the export
-         * operation began.
-         */
-        void exportComplete();
+        void exportStarted(ExportJob* job);
 
     private slots:
         /*
@@ -86,12 +89,60 @@ class ExportDialog : public QDialog
          */
         void onFilterSelected(const QString& filter);
 
+        /*
+         * Called when the search for installed Markdown processors has
+         * finished, to add their exporters to the combo box.
+         */
+        void onExportersAdded();
+
+        /*
+         * Called when the user checks or unchecks a format to export to
+         * alongside the selected one.
+         */
+        void onProfileFormatToggled(QAction* action);
+
     private:
         QFileDialog* fileDialogWidget;
         QComboBox* exporterComboBox;
         QCheckBox* smartTypographyCheckBox;
+        QPushButton* profileButton;
+        QMenu* profileMenu;
         TextDocument* document;
         QStringList fileFilters;
+        QString preferredExporterName;
+        QStringList profileFormatNames;
+
+        /*
+         * Creates a job to export the given UTF-8 encoded text to the given
+         * format and output file path with the given exporter and options.
+         * If the same text was exported the same way before, the job copies
+         * the file kept in the RenderCache instead.
+         */
+        ExportJob* createExportJob
+        (
+            Exporter* exporter,
+            const ExportFormat* format,
+            const QByteArray& text,
+            const ExportOptions& options,
+            const QString& outputFilePath
+        );
+
+        /*
+         * Fills the menu of formats to export to alongside the selected
+         * one with the formats of the given exporter.
+         */
+        void buildProfileMenu(Exporter* exporter);
+
+        /*
+         * Shows the formats of the export profile on the profile button.
+         */
+        void updateProfileButton();
+
+        /*
+         * Adds the given exporter to the combo box, along with the file
+         * filter for its formats.
+         */
+        void addExporter(Exporter* exporter);
 };
 
 #endif // EXPORTDIALOG_H
@@ -0,0 +1,689 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QStringList>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QFuture>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/types.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "ExportJob.h"
+#include "Exporter.h"
+#include "ExportFormat.h"
+#include "RenderCache.h"
+
+// Interval in milliseconds at which the progress of an export is reported.
+#define GW_EXPORT_PROGRESS_INTERVAL 1000
+
+// Size of each chunk of text written to the stdin of an export command.
+#define GW_EXPORT_INPUT_CHUNK_SIZE (64 * 1024)
+
+// Maximum number of bytes of an export command's stderr kept for its
+// error message.
+//
+#define GW_EXPORT_MAX_ERROR_SIZE (64 * 1024)
+
+QList<ExportJob*> ExportJob::runningJobs;
+
+ExportJob::ExportJob(const QString& outputFilePath)
+    : QObject(NULL), outputFilePath(outputFilePath), stage(QString()),
+        finishing(false)
+{
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(GW_EXPORT_PROGRESS_INTERVAL);
+    this->connect(progressTimer, SIGNAL(timeout()), SLOT(reportProgress()));
+
+    storeWatcher = new QFutureWatcher<void>(this);
+    this->connect(storeWatcher, SIGNAL(finished()), SLOT(onFileStored()));
+}
+
+ExportJob::~ExportJob()
+{
+    storeWatcher->waitForFinished();
+    runningJobs.removeAll(this);
+}
+
+QString ExportJob::getOutputFilePath() const
+{
+    return outputFilePath;
+}
+
+QString ExportJob::getDescription() const
+{
+    return tr("exporting to %1").arg(outputFilePath);
+}
+
+void ExportJob::setCacheKey(const QByteArray& key)
+{
+    cacheKey = key;
+}
+
+void ExportJob::start()
+{
+    runningJobs.append(this);
+    elapsedTimer.start();
+    progressTimer->start();
+    startExport();
+}
+
+void ExportJob::cancel()
+{
+    ;
+}
+
+void ExportJob::cancelAll()
+{
+    QList<ExportJob*> jobs = runningJobs;
+
+    foreach (ExportJob* job, jobs)
+    {
+        job->cancel();
+    }
+}
+
+bool ExportJob::isAnyRunning()
+{
+    return !runningJobs.isEmpty();
+}
+
+void ExportJob::setStage(const QString& stage)
+{
+    this->stage = stage;
+}
+
+void ExportJob::finish(const QString& err)
+{
+    if (finishing)
+    {
+        return;
+    }
+
+    finishing = true;
+
+    if (err.isNull() && !cacheKey.isEmpty())
+    {
+        // Store a copy of the output file on a worker thread, since large
+        // files take a while to copy.  The job ends once the copy has been
+        // stored, so that the file isn't overwritten by another export of
+        // the same document in the meantime.
+        //
+        setStage(tr("caching"));
+        storeWatcher->setFuture
+        (
+            QtConcurrent::run
+            (
+                RenderCache::getInstance(),
+                &RenderCache::storeFile,
+                cacheKey,
+                outputFilePath
+            )
+        );
+        return;
+    }
+
+    endJob(err);
+}
+
+void ExportJob::onFileStored()
+{
+    endJob(QString());
+}
+
+void ExportJob::endJob(const QString& err)
+{
+    progressTimer->stop();
+    runningJobs.removeAll(this);
+
+    emit finished(err);
+    this->deleteLater();
+}
+
+void ExportJob::reportProgress()
+{
+    int seconds = elapsedTimer.elapsed() / 1000;
+
+    if (stage.isNull())
+    {
+        emit progress(tr("%1 (%2 s)").arg(getDescription()).arg(seconds));
+    }
+    else
+    {
+        emit progress
+        (
+            tr("%1 (%2, %3 s)").arg(getDescription()).arg(stage).arg(seconds)
+        );
+    }
+}
+
+
+ConcurrentExportJob::ConcurrentExportJob
+(
+    Exporter* exporter,
+    const ExportFormat* format,
+    const QString& inputFilePath,
+    const QByteArray& text,
+    const ExportOptions& options,
+    const QString& outputFilePath
+)
+    : ExportJob(outputFilePath), exporter(exporter), format(format),
+        inputFilePath(inputFilePath), text(text), options(options)
+{
+    futureWatcher = new QFutureWatcher<QString>(this);
+    this->connect(futureWatcher, SIGNAL(finished()), SLOT(onExportFinished()));
+}
+
+ConcurrentExportJob::~ConcurrentExportJob()
+{
+    futureWatcher->waitForFinished();
+}
+
+void ConcurrentExportJob::startExport()
+{
+    futureWatcher->setFuture
+    (
+        QtConcurrent::run(this, &ConcurrentExportJob::exportToFile)
+    );
+}
+
+void ConcurrentExportJob::onExportFinished()
+{
+    finish(futureWatcher->result());
+}
+
+QString ConcurrentExportJob::exportToFile() const
+{
+    QString err;
+
+    exporter->exportToFile
+    (
+        format,
+        inputFilePath,
+        QString::fromUtf8(text.constData(), text.size()),
+        options,
+        getOutputFilePath(),
+        err
+    );
+
+    return err;
+}
+
+
+CachedExportJob::CachedExportJob
+(
+    const QByteArray& key,
+    const QString& outputFilePath
+)
+    : ExportJob(outputFilePath), key(key)
+{
+    futureWatcher = new QFutureWatcher<bool>(this);
+    this->connect(futureWatcher, SIGNAL(finished()), SLOT(onCopyFinished()));
+}
+
+CachedExportJob::~CachedExportJob()
+{
+    futureWatcher->waitForFinished();
+}
+
+void CachedExportJob::startExport()
+{
+    // Copy the file on a worker thread, since large files take a while to
+    // copy.
+    //
+    futureWatcher->setFuture
+    (
+        QtConcurrent::run
+        (
+            RenderCache::getInstance(),
+            &RenderCache::copyFile,
+            key,
+            getOutputFilePath()
+        )
+    );
+}
+
+void CachedExportJob::onCopyFinished()
+{
+    if (futureWatcher->result())
+    {
+        finish(QString());
+    }
+    else
+    {
+        finish(tr("Failed to copy the cached export to %1").arg(getOutputFilePath()));
+    }
+}
+
+
+/*
+ * A process that is started in a process group of its own on Unix, so that
+ * it can be killed along with every process it starts.
+ */
+class ExportProcess : public QProcess
+{
+    public:
+        ExportProcess(QObject* parent) : QProcess(parent)
+        {
+            ;
+        }
+
+    protected:
+#if defined(Q_OS_UNIX)
+        void setupChildProcess()
+        {
+            ::setpgid(0, 0);
+        }
+#endif
+};
+
+ProcessExportJob::ProcessExportJob
+(
+    const QString& command,
+    const QString& workingDirectory,
+    const QByteArray& text,
+    const QString& outputFilePath,
+    bool redirectOutput
+)
+    : ExportJob(outputFilePath), command(command), input(text),
+        inputWritten(0), inputSent(0), inputClosed(false), canceled(false)
+{
+    process = new ExportProcess(this);
+
+    if (!workingDirectory.isNull() && !workingDirectory.isEmpty())
+    {
+        process->setWorkingDirectory(workingDirectory);
+    }
+
+    if (redirectOutput)
+    {
+        process->setStandardOutputFile(outputFilePath);
+    }
+
+    this->connect(process, SIGNAL(started()), SLOT(onStarted()));
+    this->connect(process, SIGNAL(bytesWritten(qint64)), SLOT(onBytesWritten(qint64)));
+    this->connect(process, SIGNAL(readyReadStandardOutput()), SLOT(onReadyReadStandardOutput()));
+    this->connect(process, SIGNAL(readyReadStandardError()), SLOT(onReadyReadStandardError()));
+    this->connect(process, SIGNAL(error(QProcess::ProcessError)), SLOT(onError(QProcess::ProcessError)));
+    this->connect(process, SIGNAL(finished(int, QProcess::ExitStatus)), SLOT(onFinished(int, QProcess::ExitStatus)));
+}
+
+ProcessExportJob::~ProcessExportJob()
+{
+    if (QProcess::NotRunning != process->state())
+    {
+        killProcessTree();
+        process->waitForFinished();
+    }
+}
+
+void ProcessExportJob::cancel()
+{
+    canceled = true;
+
+    if (QProcess::NotRunning != process->state())
+    {
+        // The job finishes once the process has exited.
+        killProcessTree();
+    }
+    else
+    {
+        finish(QObject::tr("Export canceled."));
+    }
+}
+
+void ProcessExportJob::startExport()
+{
+    process->start(command);
+}
+
+void ProcessExportJob::onStarted()
+{
+    writeInput();
+}
+
+void ProcessExportJob::onBytesWritten(qint64 bytes)
+{
+    inputSent += bytes;
+    writeInput();
+}
+
+void ProcessExportJob::onReadyReadStandardOutput()
+{
+    // The output of commands that write the output file themselves isn't
+    // needed, but is read so that the command doesn't block on a full pipe.
+    //
+    process->readAllStandardOutput();
+}
+
+void ProcessExportJob::onReadyReadStandardError()
+{
+    QByteArray output = process->readAllStandardError();
+
+    if (stderrOutput.size() < GW_EXPORT_MAX_ERROR_SIZE)
+    {
+        stderrOutput += output.left(GW_EXPORT_MAX_ERROR_SIZE - stderrOutput.size());
+    }
+}
+
+void ProcessExportJob::onError(QProcess::ProcessError error)
+{
+    // Other errors are followed by the process finishing.
+    if (QProcess::FailedToStart == error)
+    {
+        finish(QObject::tr("Failed to execute command: ") + command);
+    }
+}
+
+void ProcessExportJob::onFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    onReadyReadStandardError();
+
+    if (canceled)
+    {
+        finish(QObject::tr("Export canceled."));
+    }
+    else if (!stderrOutput.isEmpty())
+    {
+        finish(QString::fromUtf8(stderrOutput.data(), stderrOutput.size()));
+    }
+    else if (QProcess::CrashExit == exitStatus)
+    {
+        finish(QObject::tr("Failed to execute command: ") + command);
+    }
+    else if (0 != exitCode)
+    {
+        // Some commands fail without saying why, in which case their
+        // output file mustn't be taken for a finished export.
+        //
+        finish
+        (
+            QObject::tr("Command exited with code %1: %2")
+                .arg(exitCode).arg(command)
+        );
+    }
+    else
+    {
+        finish(QString());
+    }
+}
+
+void ProcessExportJob::writeInput()
+{
+    if (inputClosed)
+    {
+        return;
+    }
+
+    // Keep no more than a chunk waiting to be written, so that the text
+    // isn't copied into the process's write buffer all at once.
+    //
+    while
+    (
+        (inputWritten < input.size())
+        && (process->bytesToWrite() < GW_EXPORT_INPUT_CHUNK_SIZE)
+    )
+    {
+        qint64 size =
+            qMin((qint64) GW_EXPORT_INPUT_CHUNK_SIZE, input.size() - inputWritten);
+
+        process->write(input.constData() + inputWritten, size);
+        inputWritten += size;
+    }
+
+    if (inputWritten >= input.size())
+    {
+        process->closeWriteChannel();
+        inputClosed = true;
+        input.clear();
+        setStage(QString());
+    }
+    else
+    {
+        setStage(tr("sending text %1%").arg((100 * inputSent) / input.size()));
+    }
+}
+
+void ProcessExportJob::killProcessTree()
+{
+#if defined(Q_OS_WIN)
+#if QT_VERSION >= 0x050300
+    qint64 pid = process->processId();
+#else
+    qint64 pid = (NULL != process->pid()) ? process->pid()->dwProcessId : 0;
+#endif
+
+    if (pid > 0)
+    {
+        QProcess::execute
+        (
+            "taskkill",
+            QStringList() << "/T" << "/F" << "/PID" << QString::number(pid)
+        );
+    }
+#elif defined(Q_OS_UNIX)
+#if QT_VERSION >= 0x050300
+    qint64 pid = process->processId();
+#else
+    qint64 pid = process->pid();
+#endif
+
+    if (pid > 0)
+    {
+        ::kill(-((pid_t) pid), SIGKILL);
+    }
+#endif
+
+    process->kill();
+}
+
+
+ExportBatchJob::ExportBatchJob(const QString& outputFilePath)
+    : ExportJob(outputFilePath), nextJob(0), runningJobCount(0),
+        finishedJobCount(0), canceled(false)
+{
+    // Jobs that run a command spend most of their time in the command, so
+    // a job per core keeps the processors busy without the commands
+    // fighting over the cores.
+    //
+    maxRunningJobs = qMax(1, QThread::idealThreadCount());
+}
+
+ExportBatchJob::~ExportBatchJob()
+{
+    ;
+}
+
+void ExportBatchJob::addJob(const QString& formatName, ExportJob* job)
+{
+    BatchEntry entry;
+
+    entry.formatName = formatName;
+    entry.outputFilePath = job->getOutputFilePath();
+    entry.job = job;
+    entry.started = false;
+    entry.done = false;
+    entry.elapsed = 0;
+
+    // Jobs that are never started, such as when the batch is canceled,
+    // are deleted along with the batch.
+    //
+    job->setParent(this);
+    entries.append(entry);
+}
+
+void ExportBatchJob::addSkippedFormat
+(
+    const QString& formatName,
+    const QString& reason
+)
+{
+    skippedFormats << tr("%1: skipped, %2").arg(formatName).arg(reason);
+}
+
+QString ExportBatchJob::getDescription() const
+{
+    return tr("exporting to %1 formats").arg(entries.size());
+}
+
+void ExportBatchJob::cancel()
+{
+    canceled = true;
+
+    if (runningJobCount > 0)
+    {
+        // The batch finishes once the running jobs have finished.
+        for (int i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].started && !entries[i].done)
+            {
+                entries[i].job->cancel();
+            }
+        }
+    }
+    else
+    {
+        finishBatch();
+    }
+}
+
+void ExportBatchJob::startExport()
+{
+    startNextJobs();
+
+    if (0 == runningJobCount)
+    {
+        finishBatch();
+    }
+}
+
+void ExportBatchJob::onJobFinished(const QString& err)
+{
+    for (int i = 0; i < entries.size(); i++)
+    {
+        BatchEntry& entry = entries[i];
+
+        if (entry.started && !entry.done && (entry.job == this->sender()))
+        {
+            // The job deletes itself once it has finished.
+            entry.done = true;
+            entry.elapsed = entry.timer.elapsed();
+            entry.err = err;
+            entry.job = NULL;
+
+            runningJobCount--;
+            finishedJobCount++;
+            break;
+        }
+    }
+
+    setStage(tr("%1 of %2 done").arg(finishedJobCount).arg(entries.size()));
+    startNextJobs();
+
+    if (0 == runningJobCount)
+    {
+        finishBatch();
+    }
+}
+
+void ExportBatchJob::startNextJobs()
+{
+    while
+    (
+        !canceled
+        && (nextJob < entries.size())
+        && (runningJobCount < maxRunningJobs)
+    )
+    {
+        BatchEntry& entry = entries[nextJob];
+
+        nextJob++;
+        runningJobCount++;
+        entry.started = true;
+        entry.timer.start();
+
+        this->connect(entry.job, SIGNAL(finished(QString)), SLOT(onJobFinished(QString)));
+        entry.job->start();
+    }
+}
+
+void ExportBatchJob::finishBatch()
+{
+    int failureCount = 0;
+
+    for (int i = 0; i < entries.size(); i++)
+    {
+        if (!entries[i].done || !entries[i].err.isNull())
+        {
+            failureCount++;
+        }
+    }
+
+    QString summary = buildSummary();
+
+    if (failureCount > 0)
+    {
+        finish
+        (
+            tr("Export to %1 of %2 formats failed.")
+                .arg(failureCount).arg(entries.size()) +
+            QString("\n\n") + summary
+        );
+    }
+    else
+    {
+        finish(QString());
+        emit summaryReady(summary);
+    }
+}
+
+QString ExportBatchJob::buildSummary() const
+{
+    QStringList lines;
+
+    for (int i = 0; i < entries.size(); i++)
+    {
+        const BatchEntry& entry = entries[i];
+        QString seconds = QString::number(entry.elapsed / 1000.0, 'f', 1);
+
+        if (!entry.done)
+        {
+            lines << tr("%1: canceled").arg(entry.formatName);
+        }
+        else if (entry.err.isNull())
+        {
+            lines << tr("%1: %2 (%3 s)")
+                .arg(entry.formatName).arg(entry.outputFilePath).arg(seconds);
+        }
+        else
+        {
+            lines << tr("%1: failed after %2 s: %3")
+                .arg(entry.formatName).arg(seconds).arg(entry.err.trimmed());
+        }
+    }
+
+    lines << skippedFormats;
+
+    return lines.join("\n");
+}
@@ -0,0 +1,382 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef EXPORTJOB_H
+#define EXPORTJOB_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QProcess>
+#include <QFutureWatcher>
+
+#include "Exporter.h"
+
+class ExportFormat;
+
+/**
+ * An export of a document to a file, which runs in the background so that
+ * the editor can be used in the meantime.  Connect to the job's signals,
+ * then call start().  The job deletes itself once it has emitted
+ * finished().
+ */
+class ExportJob : public QObject
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor.  Takes the path of the file being exported to as
+         * parameter.
+         */
+        ExportJob(const QString& outputFilePath);
+
+        /**
+         * Destructor.
+         */
+        virtual ~ExportJob();
+
+        /**
+         * Gets the path of the file being exported to.
+         */
+        QString getOutputFilePath() const;
+
+        /**
+         * Gets a description of the export to display to the user.
+         */
+        virtual QString getDescription() const;
+
+        /**
+         * Sets the key under which the output file is stored in the
+         * RenderCache once the export has succeeded, or an empty key (the
+         * default) to leave the file out of the cache.
+         */
+        void setCacheKey(const QByteArray& key);
+
+        /**
+         * Starts the export.
+         */
+        void start();
+
+        /**
+         * Cancels the export, after which finished() is emitted with an
+         * error saying so.  Note that implementors of this class are not
+         * required to support cancellation, in which case the export runs
+         * to the end.
+         */
+        virtual void cancel();
+
+        /**
+         * Cancels every export in progress, such as when the application
+         * is quitting.
+         */
+        static void cancelAll();
+
+        /**
+         * Returns true if there are exports in progress.
+         */
+        static bool isAnyRunning();
+
+    signals:
+        /**
+         * Emitted about every second while the export is in progress, with
+         * a description of its progress and elapsed time to display to the
+         * user.
+         */
+        void progress(const QString& description);
+
+        /**
+         * Emitted when the export has finished.  The err parameter is a
+         * null QString if the export succeeded, or an error message
+         * otherwise.
+         */
+        void finished(const QString& err);
+
+    protected:
+        /*
+         * Implement this method to start the export.  Call finish() when
+         * the export is done.
+         */
+        virtual void startExport() = 0;
+
+        /*
+         * Sets the stage of the export given in the progress description,
+         * such as how much of the text has been sent to a processor, or a
+         * null QString for none.
+         */
+        void setStage(const QString& stage);
+
+        /*
+         * Ends the job with the given error message, or a null QString if
+         * the export succeeded.  If the output file is to be cached, the
+         * job ends once a copy of it has been stored in the RenderCache.
+         */
+        void finish(const QString& err);
+
+    private slots:
+        void reportProgress();
+        void onFileStored();
+
+    private:
+        static QList<ExportJob*> runningJobs;
+
+        QString outputFilePath;
+        QByteArray cacheKey;
+        QString stage;
+        QElapsedTimer elapsedTimer;
+        QTimer* progressTimer;
+        QFutureWatcher<void>* storeWatcher;
+        bool finishing;
+
+        /*
+         * Emits finished() with the given error message, and deletes the
+         * job later on.
+         */
+        void endJob(const QString& err);
+};
+
+/**
+ * Exports a document by calling Exporter::exportToFile() on a worker thread.
+ * This is the job used by exporters that have no way of exporting in the
+ * background on their own.  It cannot be canceled.
+ */
+class ConcurrentExportJob : public ExportJob
+{
+    Q_OBJECT
+
+    public:
+        ConcurrentExportJob
+        (
+            Exporter* exporter,
+            const ExportFormat* format,
+            const QString& inputFilePath,
+            const QByteArray& text,
+            const ExportOptions& options,
+            const QString& outputFilePath
+        );
+
+        virtual ~ConcurrentExportJob();
+
+    protected:
+        void startExport();
+
+    private slots:
+        void onExportFinished();
+
+    private:
+        Exporter* exporter;
+        const ExportFormat* format;
+        QString inputFilePath;
+        QByteArray text;
+        ExportOptions options;
+        QFutureWatcher<QString>* futureWatcher;
+
+        QString exportToFile() const;
+};
+
+/**
+ * Exports a document by copying the file exported from the same text and
+ * with the same options before out of the RenderCache.
+ */
+class CachedExportJob : public ExportJob
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor.  Takes the key of the cached file and the output
+         * file path.
+         */
+        CachedExportJob(const QByteArray& key, const QString& outputFilePath);
+
+        virtual ~CachedExportJob();
+
+    protected:
+        void startExport();
+
+    private slots:
+        void onCopyFinished();
+
+    private:
+        QByteArray key;
+        QFutureWatcher<bool>* futureWatcher;
+};
+
+/**
+ * Exports a document by running a command, which is fed the text over its
+ * stdin a chunk at a time.  Unless the command writes the output file
+ * itself, its stdout is written straight to the output file, without
+ * passing through memory.  Canceling the job kills the command along with
+ * any processes it started.
+ */
+class ProcessExportJob : public ExportJob
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor.  Takes the command to run, the directory in which
+         * to run it (or a null QString for the current one), the UTF-8
+         * encoded text to feed it, and the output file path, along with
+         * whether the command's stdout is to be written to the output file.
+         */
+        ProcessExportJob
+        (
+            const QString& command,
+            const QString& workingDirectory,
+            const QByteArray& text,
+            const QString& outputFilePath,
+            bool redirectOutput
+        );
+
+        virtual ~ProcessExportJob();
+
+        void cancel();
+
+    protected:
+        void startExport();
+
+    private slots:
+        void onStarted();
+        void onBytesWritten(qint64 bytes);
+        void onReadyReadStandardOutput();
+        void onReadyReadStandardError();
+        void onError(QProcess::ProcessError error);
+        void onFinished(int exitCode, QProcess::ExitStatus exitStatus);
+
+    private:
+        QString command;
+        QByteArray input;
+        qint64 inputWritten;
+        qint64 inputSent;
+        bool inputClosed;
+        QByteArray stderrOutput;
+        bool canceled;
+        QProcess* process;
+
+        /*
+         * Writes the next chunk of the input to the command's stdin, and
+         * closes its stdin once the whole input has been written.
+         */
+        void writeInput();
+
+        /*
+         * Kills the command's process along with the processes it started.
+         */
+        void killProcessTree();
+};
+
+/**
+ * Exports a document to several formats at once, such as when publishing
+ * the same document as HTML, PDF and EPUB.  Add a job for each format, then
+ * start the batch.  The jobs run concurrently, though no more of them at a
+ * time than there are processor cores.  Once every job has finished, the
+ * batch finishes with an error listing the outcome and duration of each
+ * export if any of them failed, or else emits summaryReady() with that
+ * listing after finishing.
+ */
+class ExportBatchJob : public ExportJob
+{
+    Q_OBJECT
+
+    public:
+        /**
+         * Constructor.  Takes the path of the file being exported to in the
+         * format the user chose, after which the other files are named.
+         */
+        ExportBatchJob(const QString& outputFilePath);
+
+        virtual ~ExportBatchJob();
+
+        /**
+         * Adds the given job, which has yet to be started, to the batch,
+         * taking ownership of it.  The format name is used in the summary.
+         */
+        void addJob(const QString& formatName, ExportJob* job);
+
+        /**
+         * Adds a format that was left out of the batch to the summary,
+         * along with the reason why, such as its file already existing.
+         */
+        void addSkippedFormat(const QString& formatName, const QString& reason);
+
+        QString getDescription() const;
+
+        void cancel();
+
+    signals:
+        /**
+         * Emitted after the batch has finished, if every export succeeded,
+         * with a summary of the files exported and the time each took to
+         * display to the user.
+         */
+        void summaryReady(const QString& summary);
+
+    protected:
+        void startExport();
+
+    private slots:
+        void onJobFinished(const QString& err);
+
+    private:
+        /*
+         * An export in the batch, along with its outcome.
+         */
+        struct BatchEntry
+        {
+            QString formatName;
+            QString outputFilePath;
+            ExportJob* job;
+            bool started;
+            bool done;
+            QElapsedTimer timer;
+            qint64 elapsed;
+            QString err;
+        };
+
+        QList<BatchEntry> entries;
+        QStringList skippedFormats;
+        int maxRunningJobs;
+        int nextJob;
+        int runningJobCount;
+        int finishedJobCount;
+        bool canceled;
+
+        /*
+         * Starts pending jobs until as many are running as allowed.
+         */
+        void startNextJobs();
+
+        /*
+         * Finishes the batch once none of its jobs are running.
+         */
+        void finishBatch();
+
+        /*
+         * Lists the outcome and duration of each export, followed by the
+         * formats that were skipped.
+         */
+        QString buildSummary() const;
+};
+
+#endif // EXPORTJOB_H
@@ -21,14 +21,23 @@
 #include <QString>
 #include <QStringList>
 #include <QObject>
+#include <QRegExp>
 
 #include "Exporter.h"
+#include "ExportJob.h"
 
 #include <stdio.h>
 
 
+ExportOptions::ExportOptions()
+    : smartTypographyEnabled(false), headingAnchorPrefix(QString()),
+        sourceLinesEnabled(false)
+{
+    ;
+}
+
 Exporter::Exporter(const QString& name)
-    : smartTypographyEnabled(false), name(name)
+    : htmlExportCanceled(0), name(name)
 {
     ;
 }
@@ -48,22 +57,155 @@ const QList<const ExportFormat*> Exporter::getSupportedFormats() const
     return supportedFormats;
 }
 
-bool Exporter::getSmartTypographyEnabled() const
+QString Exporter::getCommand
+(
+    const ExportFormat* format,
+    const ExportOptions& options
+) const
 {
-    return smartTypographyEnabled;
-}
+    Q_UNUSED(format)
+    Q_UNUSED(options)
 
-void Exporter::setSmartTypographyEnabled(bool enabled)
-{
-    smartTypographyEnabled = enabled;
+    return QString();
 }
 
-void Exporter::exportToHtml(const QString& text, QString& html)
+void Exporter::exportToHtml
+(
+    const QString& text,
+    const ExportOptions& options,
+    QString& html
+)
 {
     Q_UNUSED(text)
+    Q_UNUSED(options)
 
     html = QString("<center><b style='color: red'>") +
         QObject::tr("Export to HTML is not supported with this processor.") +
          QString("</b></center>)");
 }
 
+ExportJob* Exporter::createExportJob
+(
+    const ExportFormat* format,
+    const QString& inputFilePath,
+    const QByteArray& text,
+    const ExportOptions& options,
+    const QString& outputFilePath
+)
+{
+    return new ConcurrentExportJob
+    (
+        this,
+        format,
+        inputFilePath,
+        text,
+        options,
+        outputFilePath
+    );
+}
+
+void Exporter::cancelHtmlExport()
+{
+    htmlExportCanceled.fetchAndStoreOrdered(1);
+}
+
+void Exporter::clearHtmlExportCancellation()
+{
+    htmlExportCanceled.fetchAndStoreOrdered(0);
+}
+
+bool Exporter::isHtmlExportCanceled() const
+{
+#if QT_VERSION >= 0x050000
+    return 0 != htmlExportCanceled.load();
+#else
+    return 0 != htmlExportCanceled;
+#endif
+}
+
+QString Exporter::addHeadingAnchors
+(
+    const QString& html,
+    const QString& anchorPrefix
+) const
+{
+    QString anchoredHtml;
+    QRegExp idAttributeExp("\\sid\\s*=", Qt::CaseInsensitive);
+    int headingCount = 0;
+    int copied = 0;
+    int i = 0;
+
+    anchoredHtml.reserve(html.length() + 1024);
+
+    while (i < html.length())
+    {
+        int tagStart = html.indexOf('<', i);
+
+        if ((tagStart < 0) || ((tagStart + 3) >= html.length()))
+        {
+            break;
+        }
+
+        // Skip over comments, which may hold anything.
+        if (html.midRef(tagStart, 4) == QLatin1String("<!--"))
+        {
+            int commentEnd = html.indexOf("-->", tagStart + 4);
+
+            if (commentEnd < 0)
+            {
+                break;
+            }
+
+            i = commentEnd + 3;
+            continue;
+        }
+
+        QChar tagChar = html[tagStart + 1];
+        QChar levelChar = html[tagStart + 2];
+        QChar nextChar = html[tagStart + 3];
+
+        if
+        (
+            (('h' == tagChar) || ('H' == tagChar))
+            && (levelChar >= '1') && (levelChar <= '6')
+            && (('>' == nextChar) || nextChar.isSpace())
+        )
+        {
+            int tagEnd = html.indexOf('>', tagStart);
+
+            if (tagEnd < 0)
+            {
+                break;
+            }
+
+            QString tag = html.mid(tagStart, tagEnd - tagStart);
+            QString id =
+                anchorPrefix + QString::number(++headingCount);
+
+            anchoredHtml += html.midRef(copied, tagStart - copied);
+
+            if (tag.contains(idAttributeExp))
+            {
+                anchoredHtml += QString("<span id=\"%1\"></span>").arg(id);
+                anchoredHtml += tag;
+            }
+            else
+            {
+                anchoredHtml += tag.left(3);
+                anchoredHtml += QString(" id=\"%1\"").arg(id);
+                anchoredHtml += tag.mid(3);
+            }
+
+            copied = tagEnd;
+            i = tagEnd + 1;
+        }
+        else
+        {
+            i = tagStart + 1;
+        }
+    }
+
+    anchoredHtml += html.midRef(copied);
+
+    return anchoredHtml;
+}
@@ -20,11 +20,57 @@
 #ifndef _EXPORTER_H
 #define _EXPORTER_H
 
+#include <QAtomicInt>
 #include <QString>
+#include <QByteArray>
 #include <QList>
 
 #include "ExportFormat.h"
 
+class ExportJob;
+
+/**
+ * Options for a single export of text.  The options are passed along with
+ * the text rather than set on the exporter, so that exports running at the
+ * same time, such as a render of the Live HTML Preview on a worker thread
+ * and an export to a file in the background, can't change each other's
+ * options.
+ */
+struct ExportOptions
+{
+    /**
+     * Constructor.  Leaves all of the options disabled.
+     */
+    ExportOptions();
+
+    /**
+     * Whether to export using smart typography (i.e., fancy quotation
+     * marks, etc., typically using Smarty Pants).  Note that the
+     * implementation of smart typography is optional.  It is a feature that
+     * happens to be widely supported across processors, and so it was
+     * included as a built-in option that the user can toggle.
+     */
+    bool smartTypographyEnabled;
+
+    /**
+     * The prefix of the anchor ids given to headings by exportToHtml().
+     * Each heading's id is the prefix followed by the heading's sequence
+     * number in the text, starting from 1, so that the Live HTML Preview
+     * can scroll to the heading selected in the outline.  A null QString
+     * (the default) leaves the headings without anchors.
+     */
+    QString headingAnchorPrefix;
+
+    /**
+     * Whether exportToHtml() gives each top-level HTML element a
+     * data-source-line attribute holding the line of the text (counting
+     * from 0) at which the Markdown block it was rendered from starts, so
+     * that the Live HTML Preview can be scrolled in step with the editor.
+     * Note that the implementation of this option is optional.
+     */
+    bool sourceLinesEnabled;
+};
+
 /**
  * Abstract class to export text to another format (i.e., Markdown text to
  * HTML).  Subclass this class to create a custom exporter that can export
@@ -65,28 +111,55 @@ class Exporter
         const QList<const ExportFormat*> getSupportedFormats() const;
 
         /**
-         * Returns true if smart typography is enabled.
+         * Returns the command line run to export to the given format, or to
+         * render the Live HTML Preview if the format is NULL, with its smart
+         * typography argument expanded according to the given options, so
+         * that output can be told apart by the processor options it was
+         * produced with.  By default, this method returns a null QString,
+         * for exporters that don't run a command.
          */
-        bool getSmartTypographyEnabled() const;
+        virtual QString getCommand
+        (
+            const ExportFormat* format,
+            const ExportOptions& options
+        ) const;
 
         /**
-         * Set to true if smart typography should be enabled.  See comment
-         * for the protected member field smartTypographyEnabled for further
-         * information.
+         * Override this method to transform the given text into HTML for
+         * use in the Live HTML Preview, with the given options.  By default,
+         * this method will set the html paramter to have HTML-formatted error
+         * text indicating that HTML is not supported by the export processor.
          */
-        void setSmartTypographyEnabled(bool enabled);
+        virtual void exportToHtml
+        (
+            const QString& text,
+            const ExportOptions& options,
+            QString& html
+        );
 
         /**
-         * Override this method to transform the given text into HTML for
-         * use in the Live HTML Preview.  By default, this method will set the
-         * html paramter to have HTML-formatted error text indicating that HTML
-         * is not supported by the export processor.
+         * Requests that the call to exportToHtml() in progress on another
+         * thread, if any, give up as soon as possible.  The request stays in
+         * effect until clearHtmlExportCancellation() is called, which should
+         * be done before the next call to exportToHtml().  Note that
+         * implementors of this class are not required to honor the request.
          */
-        virtual void exportToHtml(const QString& text, QString& html);
+        void cancelHtmlExport();
+
+        /**
+         * Clears a request made with cancelHtmlExport().
+         */
+        void clearHtmlExportCancellation();
+
+        /**
+         * Returns true if cancelHtmlExport() has been called since the last
+         * call to clearHtmlExportCancellation().
+         */
+        bool isHtmlExportCanceled() const;
 
         /**
          * Implement this method to export the given text to a file of the
-         * given format.  Set the err variable to an error string if
+         * given format, with the given options.  Set the err variable to an error string if
          * an error occurs during export.  Note that even is export is
          * successful, it is recommended that you set the value of err
          * to a null QString (call the QString() constructor) to indicate
@@ -100,10 +173,30 @@ class Exporter
             const ExportFormat* format,
             const QString& inputFilePath,
             const QString& text,
+            const ExportOptions& options,
             const QString& outputFilePath,
             QString& err
         ) = 0;
 
+        /**
+         * Creates a job to export the given text to a file of the given
+         * format in the background, with the same parameters as
+         * exportToFile(), except that the text is encoded in UTF-8, so that
+         * jobs exporting a document to several formats can share a single
+         * encoding of it.  Connect to the job's signals, then start it.  By
+         * default, the job calls exportToFile() on a worker thread, and
+         * cannot be canceled.  Override this method for exporters that can
+         * do better, such as by streaming their output to the file.
+         */
+        virtual ExportJob* createExportJob
+        (
+            const ExportFormat* format,
+            const QString& inputFilePath,
+            const QByteArray& text,
+            const ExportOptions& options,
+            const QString& outputFilePath
+        );
+
     protected:
         /*
          * Implementors of this class should add their supported export formats
@@ -112,16 +205,20 @@ class Exporter
         QList<const ExportFormat*> supportedFormats;
 
         /*
-         * Use this flag to determine whether to export using smart typography
-         * (i.e., fancy quotation marks, etc., typically using Smarty Pants).
-         * Note that the implementation of smart typography is optional.  It
-         * is a feature that happens to be widely supported across processors,
-         * and so it was included as a built-in option that the user can
-         * toggle.
+         * Adds anchors with ids starting with the given prefix to the
+         * headings of the given HTML in a single pass, for exporters whose
+         * processors can't be made to write the anchors themselves.  Headings not having an id attribute are given one,
+         * whereas an empty anchor element is placed before headings that
+         * already have one, so as not to break links to them.
          */
-        bool smartTypographyEnabled;
+        QString addHeadingAnchors
+        (
+            const QString& html,
+            const QString& anchorPrefix
+        ) const;
 
     private:
+        QAtomicInt htmlExportCanceled;
         QString name;
 };
 
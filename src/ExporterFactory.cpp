@@ -17,14 +17,28 @@
  *
  ***********************************************************************/
 
-#include <QProcess>
+#include <QCoreApplication>
 #include <QObject>
 #include <QRegExp>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+#include <QtConcurrentRun>
+#include <QtConcurrentMap>
+
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
 
 #include "ExporterFactory.h"
 #include "SundownExporter.h"
 #include "CommandLineExporter.h"
 
+#define GW_PROCESSOR_PROBES_KEY "ExporterFactory/processorProbes"
+
 ExporterFactory* ExporterFactory::instance = NULL;
 
 ExporterFactory::~ExporterFactory()
@@ -54,43 +68,152 @@ QList<Exporter*> ExporterFactory::getHtmlExporters()
     return htmlExporters;
 }
 
-ExporterFactory::ExporterFactory()
+bool ExporterFactory::isDiscoveryFinished() const
 {
-    CommandLineExporter* exporter = NULL;
-    bool pandocIsAvailable = isCommandAvailable("pandoc --version");
-    bool mmdIsAvailable = isCommandAvailable("multimarkdown --version");
-    bool discountIsAvailable = isCommandAvailable("markdown -V");
-    bool cmarkIsAvailable = isCommandAvailable("cmark --version");
+    return discoveryFinished;
+}
+
+ExporterFactory::ExporterFactory() : discoveryFinished(false)
+{
+    discoveryTimer.start();
 
     SundownExporter* sundownExporter = new SundownExporter();
     fileExporters.append(sundownExporter);
     htmlExporters.append(sundownExporter);
 
+    // Look for the Markdown processors in the background, since running
+    // them can take a while, starting from the results of the last run of
+    // the application.
+    //
+    QStringList names;
+    QStringList commands;
+
+    names << "pandoc" << "multimarkdown" << "markdown" << "cmark";
+    commands << "pandoc --version" << "multimarkdown --version" << "markdown -V"
+        << "cmark --version";
+
+    QSettings settings;
+    QList<ProcessorProbe> probes;
+
+    settings.beginGroup(GW_PROCESSOR_PROBES_KEY);
+
+    for (int i = 0; i < names.size(); i++)
+    {
+        ProcessorProbe probe(names.at(i), commands.at(i));
+
+        probe.load(settings);
+        probes.append(probe);
+    }
+
+    settings.endGroup();
+
+    probeWatcher = new QFutureWatcher< QList<ProcessorProbe> >(this);
+    this->connect(probeWatcher, SIGNAL(finished()), SLOT(onProcessorsProbed()));
+    probeWatcher->setFuture(QtConcurrent::run(&ExporterFactory::runProbes, probes));
+}
+
+void ExporterFactory::onProcessorsProbed()
+{
+    QList<ProcessorProbe> probes = probeWatcher->result();
+    QSettings settings;
+
+    settings.beginGroup(GW_PROCESSOR_PROBES_KEY);
+
+    int cachedCount = 0;
+
+    foreach (const ProcessorProbe& probe, probes)
+    {
+        if (probe.cached)
+        {
+            cachedCount++;
+        }
+        else
+        {
+            probe.save(settings);
+        }
+    }
+
+    settings.endGroup();
+
+    addExporters(probes);
+    discoveryFinished = true;
+
+    // Log how long discovery took, and whether it was a warm start, with
+    // every probe answered from the cache, or a cold one, with at least
+    // one processor run.
+    //
+    qDebug
+    (
+        "Found %d Markdown processors in %lld ms (%s start, %d of %d "
+            "probes cached)",
+        htmlExporters.size() - 1,
+        (long long) discoveryTimer.elapsed(),
+        (cachedCount == probes.size()) ? "warm" : "cold",
+        cachedCount,
+        probes.size()
+    );
+
+    emit exportersAdded();
+}
+
+QList<ProcessorProbe> ExporterFactory::runProbes
+(
+    const QList<ProcessorProbe>& probes
+)
+{
+    return QtConcurrent::blockingMapped(probes, &ProcessorProbe::run);
+}
+
+void ExporterFactory::addExporters(const QList<ProcessorProbe>& probes)
+{
+    // The probes are in the order in which they were listed by the
+    // constructor.
+    //
+    CommandLineExporter* exporter = NULL;
+    bool pandocIsAvailable = probes.at(0).available;
+    bool mmdIsAvailable = probes.at(1).available;
+    bool discountIsAvailable = probes.at(2).available;
+    bool cmarkIsAvailable = probes.at(3).available;
+
     if (pandocIsAvailable)
     {
+        QList<int> versionNumber = extractVersionNumber(probes.at(0).output);
+        int majorVersion = 0;
+        int minorVersion = 0;
+
+        if (versionNumber.length() > 0)
+        {
+            majorVersion = versionNumber[0];
+        }
+
+        if (versionNumber.length() > 1)
+        {
+            minorVersion = versionNumber[1];
+        }
+
+        // Pandoc 3 and up can run the render worker script with its Lua
+        // interpreter, so that pandoc stays loaded between previews.  The
+        // worker isn't used on Windows, where the Lua interpreter's stdin
+        // and stdout are in text mode, which throws off the byte counts of
+        // the worker protocol.
+        //
+#ifndef Q_OS_WIN
+        if (majorVersion >= 3)
+        {
+            renderWorkerScriptPath = extractRenderWorkerScript();
+        }
+#endif
+
         addPandocExporter("Pandoc", "markdown");
 
         // Check whether version of Pandoc can read CommonMark.
-        QList<int> versionNumber = extractVersionNumber("pandoc --version");
-
-        if (versionNumber.length() > 0)
+        if
+        (
+            (majorVersion > 1) ||
+            ((1 == majorVersion) && (minorVersion >= 14))
+        )
         {
-            int majorVersion = versionNumber[0];
-            int minorVersion = 0;
-
-            if (versionNumber.length() > 1)
-            {
-                minorVersion = versionNumber[1];
-            }
-
-            if
-            (
-                (majorVersion > 1) ||
-                ((1 == majorVersion) && (minorVersion >= 14))
-            )
-            {
-                addPandocExporter("Pandoc CommonMark", "commonmark");
-            }
+            addPandocExporter("Pandoc CommonMark", "commonmark");
         }
 
         addPandocExporter("Pandoc GitHub-flavored Markdown", "markdown_github");
@@ -192,23 +315,10 @@ ExporterFactory::ExporterFactory()
     }
 }
 
-QList<int> ExporterFactory::extractVersionNumber(const QString& command) const
+QList<int> ExporterFactory::extractVersionNumber(const QString& versionOutput) const
 {
     QList<int> versionNumber;
-    QProcess process;
-    process.start(command);
-
-    if (!process.waitForStarted(500))
-    {
-        return versionNumber;
-    }
-    else if (!process.waitForFinished(500))
-    {
-        process.kill();
-        return versionNumber;
-    }
-
-    QString versionStr = QString::fromUtf8(process.readAllStandardOutput().data());
+    QString versionStr = versionOutput;
     QRegExp versionRegex("\\d+(\\.\\d+)*");
     int pos = versionRegex.indexIn(versionStr);
 
@@ -227,21 +337,78 @@ QList<int> ExporterFactory::extractVersionNumber(const QString& command) const
     return versionNumber;
 }
 
-bool ExporterFactory::isCommandAvailable(const QString& testCommand) const
+QString ExporterFactory::extractRenderWorkerScript() const
 {
-    QProcess process;
-    process.start(testCommand);
+    QFile resource(":/resources/render-worker.lua");
 
-    if (!process.waitForStarted(500))
+    if (!resource.open(QIODevice::ReadOnly))
     {
-        return false;
+        return QString();
     }
-    else if (!process.waitForFinished(500))
+
+    // Keep the script in the user's own cache directory rather than in
+    // the shared temporary directory, where another user could plant a
+    // script of their own under the expected name before it is written.
+    //
+#if QT_VERSION >= 0x050000
+    QString cacheDirPath =
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString cacheDirPath =
+        QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+
+    QDir cacheDir(cacheDirPath);
+
+    if (cacheDirPath.isEmpty() || !cacheDir.mkpath("."))
+    {
+        return QString();
+    }
+
+    QByteArray script = resource.readAll();
+    QString path = cacheDir.absoluteFilePath("render-worker.lua");
+    QFile file(path);
+
+    // Leave the script alone if it is already there, since another
+    // instance of the application may be using it.
+    //
+    if (file.open(QIODevice::ReadOnly) && (file.readAll() == script))
+    {
+        return path;
+    }
+
+    file.close();
+
+    // Write the script under a temporary name, then rename it, so that
+    // another instance of the application never runs a partial script.
+    //
+    QString tempPath = QString("%1.%2.tmp")
+        .arg(path)
+        .arg(QCoreApplication::applicationPid());
+    QFile tempFile(tempPath);
+
+    if
+    (
+        !tempFile.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || (tempFile.write(script) != script.size())
+    )
     {
-        process.kill();
+        tempFile.close();
+        QFile::remove(tempPath);
+        return QString();
     }
 
-    return true;
+    tempFile.close();
+    tempFile.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    QFile::remove(path);
+
+    if (!QFile::rename(tempPath, path))
+    {
+        QFile::remove(tempPath);
+        return QString();
+    }
+
+    return path;
 }
 
 void ExporterFactory::addPandocExporter
@@ -255,6 +422,17 @@ void ExporterFactory::addPandocExporter
     exporter->setHtmlRenderCommand(QString("pandoc %1 -f %2 -t html")
         .arg(CommandLineExporter::SMART_TYPOGRAPHY_ARG)
         .arg(inputFormat));
+
+    if (!renderWorkerScriptPath.isNull())
+    {
+        exporter->setHtmlRenderWorkerCommand
+        (
+            QString("pandoc lua \"%1\" %2 %3")
+                .arg(renderWorkerScriptPath)
+                .arg(inputFormat)
+                .arg(CommandLineExporter::SMART_TYPOGRAPHY_ARG)
+        );
+    }
     exporter->addFileExportCommand
     (
         ExportFormat::HTML,
@@ -20,15 +20,25 @@
 #ifndef EXPORTERFACTORY_H
 #define EXPORTERFACTORY_H
 
+#include <QObject>
 #include <QList>
+#include <QString>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
 
 #include "Exporter.h"
+#include "ProcessorProbe.h"
 
 /**
  * Creates Exporters for use with HTML live preview and exporting to disk.
+ * The built-in Sundown exporter is available right away, whereas the
+ * exporters for the Markdown processors installed on the system are added
+ * once the processors have been found in the background.
  */
-class ExporterFactory
+class ExporterFactory : public QObject
 {
+    Q_OBJECT
+
     public:
         /**
          * Gets the singleton instance of this class.
@@ -51,34 +61,73 @@ class ExporterFactory
          */
         QList<Exporter*> getHtmlExporters();
 
+        /**
+         * Returns true once the search for installed Markdown processors has
+         * finished and their exporters have been added.
+         */
+        bool isDiscoveryFinished() const;
+
+    signals:
+        /**
+         * Emitted once the search for installed Markdown processors has
+         * finished and their exporters have been added to the lists of
+         * file and HTML exporters.
+         */
+        void exportersAdded();
+
+    private slots:
+        void onProcessorsProbed();
+
     private:
         static ExporterFactory* instance;
         QList<Exporter*> fileExporters;
         QList<Exporter*> htmlExporters;
 
+        // Path of the render worker script given to pandoc's Lua
+        // interpreter to keep pandoc running between renders for the Live
+        // HTML Preview, or a null QString if none.
+        //
+        QString renderWorkerScriptPath;
+
+        QFutureWatcher< QList<ProcessorProbe> >* probeWatcher;
+        bool discoveryFinished;
+        QElapsedTimer discoveryTimer;
+
         /*
          * Constructor.
          */
         ExporterFactory();
 
         /*
-         * Executes the given terminal command to see if the executable is
-         * installed and available.  An example of a test command would be:
-         *
-         *      <process_name> --version
+         * Finds the executables of the given probes and runs the probes
+         * whose executables' signatures differ from the cached ones,
+         * concurrently.  This method is run on a worker thread.
+         */
+        static QList<ProcessorProbe> runProbes(const QList<ProcessorProbe>& probes);
+
+        /*
+         * Creates the exporters for the processors found by the given
+         * probes.
+         */
+        void addExporters(const QList<ProcessorProbe>& probes);
+
+        /*
+         * Copies the render worker script out of the application's
+         * resources into the user's cache directory, where interpreters can
+         * find it, returning its path, or a null QString on failure.
          */
-        bool isCommandAvailable(const QString& testCommand) const;
+        QString extractRenderWorkerScript() const;
 
         /*
-         * Executes the given terminal command to get a version number for the
-         * application.  An example of a command would be:
+         * Extracts the version number of an application from the given
+         * output of a command such as:
          *
          *      <process_name> --version
          *
          * This method will return a list of integers representing the major,
          * minor, etc., version numbers, in the order printed to stdout.
          */
-        QList<int> extractVersionNumber(const QString& command) const;
+        QList<int> extractVersionNumber(const QString& versionOutput) const;
 
         /*
          * Convenience method to create a Pandoc exporter with the given name
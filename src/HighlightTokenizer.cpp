@@ -23,8 +23,12 @@
 #include "HighlighterLineStates.h"
 
 HighlightTokenizer::HighlightTokenizer()
+    : state(HIGHLIGHTER_LINE_STATE_UNKNOWN), tokensSorted(true)
 {
-
+    // Reserving the capacity up front also ensures that the buffer is not
+    // shrunk when it is cleared with resize(0).
+    //
+    tokens.reserve(INITIAL_TOKEN_CAPACITY);
 }
 
 HighlightTokenizer::~HighlightTokenizer()
@@ -32,32 +36,51 @@ HighlightTokenizer::~HighlightTokenizer()
 
 }
 
-QList<Token> HighlightTokenizer::getTokens() const
+int HighlightTokenizer::lookAhead(const QString& text) const
 {
-    return tokens.values();
+    Q_UNUSED(text)
+
+    return HIGHLIGHTER_LINE_STATE_UNKNOWN;
 }
 
-int HighlightTokenizer::getState() const
+const QVector<Token>& HighlightTokenizer::getTokens() const
 {
-    return state;
+    if (!tokensSorted)
+    {
+        // Sort tokens by position to aid with nested formatting.  Note that
+        // the sort is stable so that a token enclosing another token at the
+        // same position is still formatted first.
+        //
+        qStableSort(tokens.begin(), tokens.end(), tokenLessThan);
+        tokensSorted = true;
+    }
+
+    return tokens;
 }
 
-bool HighlightTokenizer::backtrackRequested() const
+int HighlightTokenizer::getState() const
 {
-    return backtrack;
+    return state;
 }
 
 void HighlightTokenizer::clear()
 {
-    tokens.clear();
-    backtrack = false;
+    tokens.resize(0);
+    tokensSorted = true;
     state = HIGHLIGHTER_LINE_STATE_UNKNOWN;
 }
 
 void HighlightTokenizer::addToken(const Token& token)
 {
-    // Insert tokens sorted by position to aid with nested formatting.
-    tokens.insertMulti(token.getPosition(), token);
+    // Tokens are usually added in order of position.  Only sort the buffer
+    // later on if they are not.
+    //
+    if (!tokens.isEmpty() && (token.getPosition() < tokens.last().getPosition()))
+    {
+        tokensSorted = false;
+    }
+
+    tokens.append(token);
 }
 
 void HighlightTokenizer::setState(int state)
@@ -65,11 +88,6 @@ void HighlightTokenizer::setState(int state)
     this->state = state;
 }
 
-void HighlightTokenizer::requestBacktrack()
-{
-    backtrack = true;
-}
-
 bool HighlightTokenizer::tokenLessThan(const Token& t1, const Token& t2)
 {
     return t1.getPosition() < t2.getPosition();
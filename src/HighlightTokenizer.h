@@ -21,8 +21,7 @@
 #define HIGHLIGHT_TOKENIZER_H
 
 #include <QString>
-#include <QList>
-#include <QMap>
+#include <QVector>
 
 #include "Token.h"
 
@@ -55,6 +54,11 @@
  * Fortunately the QSyntaxHighlighter that will format the text based on these
  * tokens doesn't need to worry about the token order.  It needs to only loop
  * through the tokens and format the text accordingly.
+ *
+ * Since a tokenizer is invoked once for every line in the document, the
+ * tokens are kept in a flat buffer that is reused from one line to the next.
+ * Clearing the buffer does not release its memory, so that in the steady
+ * state no heap allocations are made while tokenizing.
  */
 class HighlightTokenizer
 {
@@ -75,16 +79,16 @@ class HighlightTokenizer
          * getState() to determine the line state for the end of the line,
          * which you can pass this method as the value of the previousState
          * parameter along with the text of the next line in the document.
-         * Call backtrackRequested() to see if the tokenizer needs to backtrack
-         * one line in order to correctly tokenize the current line.  Finally,
-         * call clear() to clean up the tokens and state for the next call.
+         * Finally, call clear() to clean up the tokens and state for the next
+         * call.
          *
          * text - the line of text to be tokenized
          * currentState - the current state of the line being passed in from the
          *                last time it was tokenized (if at all)
          * previousState - the line state of the end of the previous line
          *                 in the document
-         * nextState - the line state of the next line in the document
+         * nextState - the line state of the next line in the document, as
+         *             returned by lookAhead() for the next line's text
          *
          * Note that the above line states are intended to be used as the
          * states in QSyntaxHighlighter.  Reading the Qt documentation for
@@ -99,31 +103,41 @@ class HighlightTokenizer
         ) = 0;
 
         /**
-         * Returns the tokens produced by calling tokenize().
+         * Returns the state of the given line as far as tokenizing the line
+         * preceding it is concerned.  Unlike the state returned by
+         * getState(), this does not depend on the lines around the given
+         * line, so it can be determined for the next line in the document
+         * before that line has been tokenized.  This allows lines whose
+         * meaning depends on the line following them to be tokenized in a
+         * single forward pass through the document.
+         *
+         * The default implementation returns HIGHLIGHTER_LINE_STATE_UNKNOWN.
          */
-        QList<Token> getTokens() const;
+        virtual int lookAhead(const QString& text) const;
 
         /**
-         * Returns the line state at the end of the line that was tokenized
-         * by calling tokenize().
+         * Returns the tokens produced by calling tokenize(), sorted by
+         * position.  Tokens at the same position are returned in the order
+         * in which they were added.  The returned reference remains valid
+         * only until the next call to clear() or tokenize().
          */
-        int getState() const;
+        const QVector<Token>& getTokens() const;
 
         /**
-         * Returns true if the tokenizer needs to backtrack one line in order
-         * to successfully tokenize the current line.
+         * Returns the line state at the end of the line that was tokenized
+         * by calling tokenize().
          */
-        bool backtrackRequested() const;
+        int getState() const;
 
         /**
-         * Clears the line state, tokens, and backtrack request flag.
+         * Clears the line state and tokens.
          */
         void clear();
 
     protected:
         /**
          * Call this method to add the given token to the list that will be
-         * returned by getTokens().
+         * returned by getTokens().  Tokens may be added in any order.
          */
         void addToken(const Token& token);
 
@@ -132,16 +146,16 @@ class HighlightTokenizer
          */
         void setState(int state);
 
-        /**
-         * Call this method to ensure backtrackRequested() returns true
-         * rather than false.
+    private:
+        /*
+         * Initial capacity of the token buffer.  This is enough for all but
+         * the most heavily marked up lines.
          */
-        void requestBacktrack();
+        static const int INITIAL_TOKEN_CAPACITY = 64;
 
-    private:
         int state;
-        QMap<int, Token> tokens;
-        bool backtrack;
+        mutable QVector<Token> tokens;
+        mutable bool tokensSorted;
 
         /*
          * Compares two tokens' positions for sorting.
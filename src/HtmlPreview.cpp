@@ -17,6 +17,7 @@
  *
  ***********************************************************************/
 
+#include <algorithm>
 #include <QVariant>
 #include <QFileDialog>
 #include <QFile>
@@ -28,7 +29,6 @@
 #include <QPrintPreviewDialog>
 #include <QApplication>
 #include <QClipboard>
-#include <QStack>
 #include <QDir>
 #include <QDesktopServices>
 #include <QAction>
@@ -37,11 +37,15 @@
 #include <QSettings>
 #include <QPrinter>
 #include <QDesktopWidget>
+#include <QMouseEvent>
+#include <QTextBlock>
 
 #include "HtmlPreview.h"
 #include "Exporter.h"
 #include "ExporterFactory.h"
 #include "ExportDialog.h"
+#include "ExportJob.h"
+#include "RenderCache.h"
 #include "MessageBoxHelper.h"
 #include "StyleSheetManagerDialog.h"
 
@@ -77,8 +81,28 @@ HtmlPreview::HtmlPreview
     htmlBrowser->page()->action(QWebPage::OpenLink)->setVisible(false);
     htmlBrowser->page()->action(QWebPage::OpenLinkInNewWindow)->setVisible(false);
     connect(htmlBrowser, SIGNAL(linkClicked(QUrl)), this, SLOT(onLinkClicked(QUrl)));
-    headingTagExp.setMinimal(true);
-    headingTagExp.setPattern("[Hh][1-6]");
+    htmlBrowser->installEventFilter(this);
+    referenceDefinitionExp.setPattern("^ {0,3}\\[[^\\]]+\\]:\\s*\\S.*$");
+    listItemExp.setPattern("^([-*+]|[0-9]+[.)])(\\s.*)?$");
+    blockSeparatorExp.setPattern("<div class=\"livepreviewblock\">\\s*</div>");
+    nextBlockId = 0;
+    fullRenderNeeded = true;
+    updatePending = false;
+    renderExporter = NULL;
+    renderCanceled = false;
+    renderRevision = -1;
+    renderText = QString();
+    lastRenderedRevision = -1;
+    lastRenderedText = QString();
+    lastRenderedExporter = NULL;
+    renderIsFull = true;
+    renderFirstBlockId = 0;
+    renderPrefixCount = 0;
+    renderSuffixCount = 0;
+    navigatedLine = -1;
+
+    futureWatcher = new QFutureWatcher<QStringList>(this);
+    this->connect(futureWatcher, SIGNAL(finished()), SLOT(onHtmlReady()));
 
     this->statusBar()->setSizeGripEnabled(false);
 
@@ -114,6 +138,7 @@ HtmlPreview::HtmlPreview
     this->statusBar()->addPermanentWidget(printButton);
 
     previewerComboBox = new QComboBox(this);
+    preferredExporterName = currentExporterName;
 
     QList<Exporter*> exporters = ExporterFactory::getInstance()->getHtmlExporters();
 
@@ -146,6 +171,7 @@ HtmlPreview::HtmlPreview
 
     this->statusBar()->addWidget(previewerComboBox);
     connect(previewerComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(onPreviewerChanged(int)));
+    connect(ExporterFactory::getInstance(), SIGNAL(exportersAdded()), this, SLOT(onExportersAdded()));
 
     styleSheetComboBox = new QComboBox(this);
     styleSheetComboBox->addItem(tr("Github (Default)"));
@@ -185,8 +211,6 @@ HtmlPreview::HtmlPreview
 
     this->setCentralWidget(htmlBrowser);
 
-    futureWatcher = new QFutureWatcher<QString>(this);
-    this->connect(futureWatcher, SIGNAL(finished()), SLOT(onHtmlReady()));
     this->changeStyleSheet(cssIndex);
 
     this->connect(document, SIGNAL(filePathChanged()), SLOT(updateBaseDir()));
@@ -219,6 +243,16 @@ HtmlPreview::~HtmlPreview()
             previewerComboBox->itemText(previewerComboBox->currentIndex());
     }
 
+    // Keep the previewer last used if it has yet to be found.
+    if
+    (
+        !ExporterFactory::getInstance()->isDiscoveryFinished()
+        && !preferredExporterName.isEmpty()
+    )
+    {
+        exporterName = preferredExporterName;
+    }
+
     if (!exporterName.isNull())
     {
         settings.setValue
@@ -252,6 +286,11 @@ HtmlPreview::~HtmlPreview()
     }
 
     // Wait for thread to finish if in the middle of updating the preview.
+    if (futureWatcher->isRunning())
+    {
+        cancelRender();
+    }
+
     futureWatcher->waitForFinished();
 }
 
@@ -259,6 +298,33 @@ void HtmlPreview::updatePreview()
 {
     if (this->isVisible())
     {
+        updateLatencyTimer.start();
+
+        // Don't start rendering while the page is being rendered, since the
+        // blocks being rendered are relative to the page as it is before
+        // the render completes.  Rather, cancel the render in progress, and
+        // start over with the latest text once it has stopped.
+        //
+        if (futureWatcher->isRunning())
+        {
+            cancelRender();
+            updatePending = true;
+            return;
+        }
+
+        updatePending = false;
+
+        // Don't bother copying the text if the document hasn't changed.
+        if
+        (
+            !fullRenderNeeded
+            && (exporter == renderExporter)
+            && (document->revision() == lastRenderedRevision)
+        )
+        {
+            return;
+        }
+
         // Some markdown processors don't handle empty text very well
         // and will error.  Thus, only pass in text from the document
         // into the markdown processor if the text isn't empty or null.
@@ -271,14 +337,112 @@ void HtmlPreview::updatePreview()
         {
             QString text = document->toPlainText();
 
+            // If the text is the same as what was last rendered (i.e., after
+            // an undo), there is nothing to render.
+            //
+            if
+            (
+                !fullRenderNeeded
+                && (exporter == lastRenderedExporter)
+                && (text == lastRenderedText)
+            )
+            {
+                lastRenderedRevision = document->revision();
+                return;
+            }
+
             if (!text.isNull() && !text.isEmpty())
             {
-                QFuture<QString> future =
+                QStringList blocks;
+                QString definitions;
+
+                splitIntoBlocks(text, blocks, definitions);
+
+                // Render the whole document if the reference definitions
+                // changed, as they affect the links in every block.  Likewise
+                // for footnotes, which are collected at the end of the page.
+                //
+                renderIsFull =
+                    fullRenderNeeded
+                    || previewBlocks.isEmpty()
+                    || (definitions != referenceDefinitions)
+                    || text.contains("[^");
+
+                renderReferenceDefinitions = definitions;
+
+                if (renderIsFull)
+                {
+                    renderPrefixCount = 0;
+                    renderSuffixCount = 0;
+                    renderBlockTexts = blocks;
+                }
+                else
+                {
+                    // Find the blocks at the beginning and end of the document
+                    // that haven't changed.
+                    //
+                    int prefixCount = 0;
+                    int suffixCount = 0;
+                    int maxCount = qMin(blocks.size(), previewBlocks.size());
+
+                    while
+                    (
+                        (prefixCount < maxCount)
+                        && (blocks.at(prefixCount) == previewBlocks.at(prefixCount).text)
+                    )
+                    {
+                        prefixCount++;
+                    }
+
+                    while
+                    (
+                        (suffixCount < (maxCount - prefixCount))
+                        &&
+                        (
+                            blocks.at(blocks.size() - suffixCount - 1)
+                            == previewBlocks.at(previewBlocks.size() - suffixCount - 1).text
+                        )
+                    )
+                    {
+                        suffixCount++;
+                    }
+
+                    if
+                    (
+                        (prefixCount == blocks.size())
+                        && (prefixCount == previewBlocks.size())
+                    )
+                    {
+                        // Nothing changed.
+                        lastRenderedRevision = document->revision();
+                        lastRenderedText = text;
+                        lastRenderedExporter = exporter;
+                        return;
+                    }
+
+                    renderPrefixCount = prefixCount;
+                    renderSuffixCount = suffixCount;
+                    renderBlockTexts =
+                        blocks.mid(prefixCount, blocks.size() - prefixCount - suffixCount);
+                }
+
+                renderExporter = exporter;
+                renderCanceled = false;
+                renderRevision = document->revision();
+                renderText = text;
+                renderFirstBlockId = nextBlockId;
+                nextBlockId += renderBlockTexts.size();
+                renderExporter->clearHtmlExportCancellation();
+
+                QFuture<QStringList> future =
                     QtConcurrent::run
                     (
                         this,
-                        &HtmlPreview::exportToHtml,
-                        document->toPlainText(),
+                        &HtmlPreview::renderBlocks,
+                        renderBlockTexts,
+                        renderReferenceDefinitions,
+                        renderIsFull,
+                        renderFirstBlockId,
                         exporter
                     );
                 futureWatcher->setFuture(future);
@@ -287,115 +451,241 @@ void HtmlPreview::updatePreview()
     }
 }
 
+void HtmlPreview::onTypingResumed()
+{
+    if (futureWatcher->isRunning())
+    {
+        cancelRender();
+    }
+}
+
 void HtmlPreview::navigateToHeading(int headingSequenceNumber)
 {
-    QString anchor = QString("livepreviewhnbr%1").arg(headingSequenceNumber);
+    // Find the block holding the heading, and the heading's sequence number
+    // within the anchors of that block.
+    //
+    QString anchor = headingAnchorPrefix(-1) + QString::number(headingSequenceNumber);
+    int remaining = headingSequenceNumber;
+
+    for (int i = 0; i < previewBlocks.size(); i++)
+    {
+        const PreviewBlock& block = previewBlocks.at(i);
+
+        if (remaining <= block.headingCount)
+        {
+            anchor =
+                block.headingAnchorPrefix
+                + QString::number(block.firstHeadingNumber + remaining - 1);
+            break;
+        }
+
+        remaining -= block.headingCount;
+    }
+
     this->htmlBrowser->page()->mainFrame()->scrollToAnchor(anchor);
 }
 
-void HtmlPreview::onHtmlReady()
+void HtmlPreview::navigateToPosition(int position)
 {
-    QString html = futureWatcher->result();
+    if (previewBlocks.isEmpty() || !this->isVisible())
+    {
+        return;
+    }
 
-    if (html == this->html)
+    int line = document->findBlock(position).blockNumber();
+
+    // Leave the preview where it is if the cursor was moved here by a
+    // click in the preview.
+    //
+    if (line == navigatedLine)
     {
-        // Don't bother updating if the HTML didn't change.
+        navigatedLine = -1;
         return;
     }
 
-    // Find where the change occurred since last time, and slip an
-    // anchor in the location so that we can scroll there.
+    navigatedLine = -1;
+
+    // Find the block holding the line, and the element of the block
+    // rendered from the lines it is in.  The block's marker is scrolled to
+    // if its elements aren't marked with their source lines.
     //
-    QString anchoredHtml = "";
+    int index =
+        std::upper_bound(blockFirstLines.begin(), blockFirstLines.end(), line)
+        - blockFirstLines.begin() - 1;
 
-    QTextStream newHtmlDoc((QString*) &html, QIODevice::ReadOnly);
-    QTextStream oldHtmlDoc((QString*) &(this->html), QIODevice::ReadOnly);
-    QTextStream anchoredHtmlDoc(&anchoredHtml, QIODevice::WriteOnly);
+    index = qMax(index, 0);
 
-    bool differenceFound = false;
-    QString oldLine = oldHtmlDoc.readLine();
-    QString newLine = newHtmlDoc.readLine();
+    const PreviewBlock& block = previewBlocks.at(index);
+    int blockLine =
+        qBound(0, line - blockFirstLines.at(index), block.lineCount - 1);
+    int elementIndex =
+        std::upper_bound(block.sourceLines.begin(), block.sourceLines.end(), blockLine)
+        - block.sourceLines.begin() - 1;
 
-    while (!oldLine.isNull() && !newLine.isNull() && !differenceFound)
+    QWebFrame* frame = htmlBrowser->page()->mainFrame();
+    QString marker = QString("#livepreviewblock%1").arg(block.id);
+    QWebElement element;
+    int firstLine = 0;
+    int lastLine = block.lineCount;
+
+    if (elementIndex >= 0)
     {
-        if (oldLine != newLine)
+        firstLine = block.sourceLines.at(elementIndex);
+
+        if ((elementIndex + 1) < block.sourceLines.size())
         {
-            // Found the difference, so insert an anchor point at the
-            // beginning of the line.
-            //
-            differenceFound = true;
-            anchoredHtmlDoc << "<div id=\"livepreviewmodifypoint\" />";
+            lastLine = block.sourceLines.at(elementIndex + 1);
         }
-        else
+
+        element =
+            frame->findFirstElement
+            (
+                QString("%1 ~ [data-source-line=\"%2\"]")
+                    .arg(marker)
+                    .arg(firstLine + block.renderLineOffset)
+            );
+    }
+
+    if (element.isNull())
+    {
+        element = frame->findFirstElement(marker);
+        firstLine = 0;
+        lastLine = block.lineCount;
+
+        if (!block.sourceLines.isEmpty())
         {
-            anchoredHtmlDoc << newLine << "\n";
-            oldLine = oldHtmlDoc.readLine();
-            newLine = newHtmlDoc.readLine();
+            lastLine = block.sourceLines.first();
         }
     }
 
-    // Put any remaining new HTML data into the
-    // anchored HTML string.
-    //
-    while (!newLine.isNull())
+    if (element.isNull())
     {
-        anchoredHtmlDoc << newLine << "\n";
-        newLine = newHtmlDoc.readLine();
+        return;
     }
 
-    setHtml(anchoredHtml);
-    this->html = html;
-
-    // Traverse the DOM in the browser, and find all the H1-H6 tags.
-    // Set the id attribute of each heading tag to have a unique
-    // sequence number, so that when the navigateToHeading() slot
-    // is triggered, we can scroll to the desired heading.
-    //
-    QWebFrame* frame = htmlBrowser->page()->mainFrame();
-    QWebElement element = frame->documentElement();
-    QStack<QWebElement> elementStack;
-    int headingId = 1;
+    // Place the line a third of the way down the view.
+    QRect geometry = element.geometry();
+    int y =
+        geometry.top()
+        + ((geometry.height() * (blockLine - firstLine)) / qMax(lastLine - firstLine, 1));
 
-    elementStack.push(element);
+    frame->setScrollPosition
+    (
+        QPoint(frame->scrollPosition().x(), y - (frame->geometry().height() / 3))
+    );
+}
 
-    while (!elementStack.isEmpty())
+void HtmlPreview::onHtmlReady()
+{
+    if (renderCanceled)
     {
-        element = elementStack.pop();
+        // The render was superseded, so drop its results, and start the
+        // latest one if there is any.
+        //
+        renderCanceled = false;
+        renderExporter->clearHtmlExportCancellation();
 
-        // If the element is a heading tag (H1-H6), set an anchor id for it.
-        if (headingTagExp.exactMatch(element.tagName()))
+        if (updatePending)
         {
-            element.prependOutside(QString("<span id='livepreviewhnbr%1'></span>").arg(headingId));
-            headingId++;
+            updatePreview();
         }
-        // else if the element is something that would have a heading tag
-        // (not a paragraph, blockquote, code, etc.), then add its children
-        // to traverse and look for headings.
+
+        return;
+    }
+
+    QStringList blockHtml = futureWatcher->result();
+
+    if (blockHtml.size() != renderBlockTexts.size())
+    {
+        // The blocks could not be told apart in the rendered HTML, so
+        // display the whole document as a single block.  The next update
+        // will render the whole document again.
         //
-        else if
-        (
-            (0 != element.tagName().compare("blockquote", Qt::CaseInsensitive))
-            && (0 != element.tagName().compare("code", Qt::CaseInsensitive))
-            && (0 != element.tagName().compare("p", Qt::CaseInsensitive))
-            && (0 != element.tagName().compare("ol", Qt::CaseInsensitive))
-            && (0 != element.tagName().compare("ul", Qt::CaseInsensitive))
-            && (0 != element.tagName().compare("table", Qt::CaseInsensitive))
-        )
+        setHtml(blockHtml.join(""));
+    }
+    else
+    {
+        QList<PreviewBlock> newBlocks;
+        int headingNumber = 1;
+        int renderLineOffset = 0;
+        int separatorLineCount = blockSeparator().count('\n') - 1;
+
+        for (int i = 0; i < blockHtml.size(); i++)
         {
-            QStack<QWebElement> childStack;
-            element = element.firstChild();
+            PreviewBlock block;
+            block.text = renderBlockTexts.at(i);
+            block.html = blockHtml.at(i);
+            block.id = renderFirstBlockId + i;
+
+            // The headings of a full render are numbered throughout the
+            // whole document, whereas those of an incremental render are
+            // numbered within each block.
+            //
+            if (renderIsFull)
+            {
+                block.headingAnchorPrefix = headingAnchorPrefix(-1);
+            }
+            else
+            {
+                block.headingAnchorPrefix = headingAnchorPrefix(block.id);
+                headingNumber = 1;
+            }
+
+            block.firstHeadingNumber = headingNumber;
+            block.headingCount =
+                block.html.count(QString("id=\"") + block.headingAnchorPrefix);
+            headingNumber += block.headingCount;
+
+            // The blocks of a full render were rendered one after the other
+            // with separators between them, whereas those of an incremental
+            // render were each rendered by themselves.
+            //
+            block.lineCount = block.text.count('\n') + 1;
+            block.renderLineOffset = renderLineOffset;
+            block.sourceLines = sourceLines(block.html, renderLineOffset);
 
-            while (!element.isNull())
+            if (renderIsFull)
             {
-                childStack.push(element);
-                element = element.nextSibling();
+                renderLineOffset += block.lineCount + separatorLineCount;
             }
 
-            while (!childStack.isEmpty())
+            newBlocks.append(block);
+        }
+
+        if (renderIsFull)
+        {
+            // Scroll to the first block that changed since last time.
+            int firstChange = 0;
+
+            while
+            (
+                (firstChange < newBlocks.size())
+                && (firstChange < previewBlocks.size())
+                && (newBlocks.at(firstChange).html == previewBlocks.at(firstChange).html)
+            )
             {
-                elementStack.push(childStack.pop());
+                firstChange++;
             }
+
+            setPage(newBlocks, firstChange);
+        }
+        else
+        {
+            patchPage(renderPrefixCount, renderSuffixCount, newBlocks);
         }
+
+        referenceDefinitions = renderReferenceDefinitions;
+        fullRenderNeeded = false;
+        lastRenderedRevision = renderRevision;
+        lastRenderedText = renderText;
+        lastRenderedExporter = renderExporter;
+    }
+
+    emit previewUpdated(updateLatencyTimer.elapsed());
+
+    if (updatePending)
+    {
+        updatePreview();
     }
 }
 
@@ -404,10 +694,48 @@ void HtmlPreview::onPreviewerChanged(int index)
     QVariant exporterVariant = previewerComboBox->itemData(index);
 
     exporter = (Exporter*) exporterVariant.value<void*>();
+    preferredExporterName = exporter->getName();
     setHtml("");
     updatePreview();
 }
 
+void HtmlPreview::onExportersAdded()
+{
+    QList<Exporter*> exporters = ExporterFactory::getInstance()->getHtmlExporters();
+    int preferredIndex = -1;
+
+    for (int i = 0; i < exporters.length(); i++)
+    {
+        Exporter* exporter = exporters.at(i);
+        int index = previewerComboBox->count() - 1;
+
+        while
+        (
+            (index >= 0)
+            && (previewerComboBox->itemData(index).value<void*>() != exporter)
+        )
+        {
+            index--;
+        }
+
+        if (index < 0)
+        {
+            previewerComboBox->addItem(exporter->getName(), qVariantFromValue((void *) exporter));
+            index = previewerComboBox->count() - 1;
+        }
+
+        if (exporter->getName() == preferredExporterName)
+        {
+            preferredIndex = index;
+        }
+    }
+
+    if ((preferredIndex >= 0) && (preferredIndex != previewerComboBox->currentIndex()))
+    {
+        previewerComboBox->setCurrentIndex(preferredIndex);
+    }
+}
+
 void HtmlPreview::changeStyleSheet(int index)
 {
     // Prevent recursion, since calls to the combo box's setCurrentIndex
@@ -555,12 +883,41 @@ void HtmlPreview::onExport()
 {
     ExportDialog exportDialog(document);
 
-    connect(&exportDialog, SIGNAL(exportStarted(QString)), this, SIGNAL(operationStarted(QString)));
-    connect(&exportDialog, SIGNAL(exportComplete()), this, SIGNAL(operationFinished()));
+    connect(&exportDialog, SIGNAL(exportStarted(ExportJob*)), this, SLOT(onExportStarted(ExportJob*)));
 
     exportDialog.exec();
 }
 
+void HtmlPreview::onExportStarted(ExportJob* job)
+{
+    connect(job, SIGNAL(progress(QString)), this, SIGNAL(operationStarted(QString)));
+    connect(job, SIGNAL(finished(QString)), this, SLOT(onExportFinished(QString)));
+
+    ExportBatchJob* batch = qobject_cast<ExportBatchJob*>(job);
+
+    if (NULL != batch)
+    {
+        connect(batch, SIGNAL(summaryReady(QString)), this, SLOT(onExportSummaryReady(QString)));
+    }
+
+    emit operationStarted(job->getDescription());
+}
+
+void HtmlPreview::onExportFinished(const QString& err)
+{
+    emit operationFinished();
+
+    if (!err.isNull())
+    {
+        MessageBoxHelper::critical(this, tr("Export failed."), err);
+    }
+}
+
+void HtmlPreview::onExportSummaryReady(const QString& summary)
+{
+    MessageBoxHelper::information(this, tr("Export complete."), summary);
+}
+
 void HtmlPreview::copyHtml()
 {
     QClipboard *clipboard = QApplication::clipboard();
@@ -589,6 +946,8 @@ void HtmlPreview::updateBaseDir()
         this->baseUrl = QUrl();
     }
 
+    // Relative links and images in the page need to be resolved again.
+    fullRenderNeeded = true;
     this->updatePreview();
 }
 
@@ -605,33 +964,510 @@ void HtmlPreview::closeEvent(QCloseEvent* event)
     html = "";
 }
 
+bool HtmlPreview::eventFilter(QObject* watched, QEvent* event)
+{
+    if ((watched == htmlBrowser) && (QEvent::MouseButtonDblClick == event->type()))
+    {
+        QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(event);
+        int line = sourceLineAt(mouseEvent->pos());
+
+        if (line >= 0)
+        {
+            QTextBlock textBlock = document->findBlockByNumber(line);
+
+            if (textBlock.isValid())
+            {
+                navigatedLine = line;
+                emit documentPositionNavigated(textBlock.position());
+            }
+        }
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
 void HtmlPreview::setHtml(const QString& html)
 {
     this->html = html;
+    previewBlocks.clear();
+    updateBlockIndex();
+    fullRenderNeeded = true;
+
+    // The blocks being rendered no longer belong to the page, so render
+    // them again once the render in progress has stopped.
+    //
+    if (futureWatcher->isRunning())
+    {
+        cancelRender();
+        updatePending = true;
+    }
 
     htmlBrowser->setContent(html.toUtf8(), "text/html", baseUrl);
-    htmlBrowser->page()->mainFrame()->scrollToAnchor("livepreviewmodifypoint");
 }
 
-QString HtmlPreview::exportToHtml
+void HtmlPreview::updateBlockIndex()
+{
+    int line = 0;
+
+    blockFirstLines.resize(previewBlocks.size());
+    blockIndexes.clear();
+
+    for (int i = 0; i < previewBlocks.size(); i++)
+    {
+        blockFirstLines[i] = line;
+        blockIndexes.insert(previewBlocks.at(i).id, i);
+        line += previewBlocks.at(i).lineCount;
+    }
+}
+
+QVector<int> HtmlPreview::sourceLines(const QString& html, int lineOffset) const
+{
+    static const QString attribute("data-source-line=\"");
+    QVector<int> lines;
+    int index = html.indexOf(attribute);
+
+    while (index >= 0)
+    {
+        int start = index + attribute.length();
+        int end = html.indexOf('"', start);
+        bool ok = false;
+        int line = html.mid(start, end - start).toInt(&ok) - lineOffset;
+
+        // Skip anything that merely looks like the attribute, such as in raw
+        // HTML, which would be out of order.
+        //
+        if (ok && (end > start) && (lines.isEmpty() || (line > lines.last())))
+        {
+            lines.append(line);
+        }
+
+        index = html.indexOf(attribute, start);
+    }
+
+    return lines;
+}
+
+int HtmlPreview::sourceLineAt(const QPoint& pos) const
+{
+    QWebFrame* frame = htmlBrowser->page()->mainFrame();
+    QWebElement element = frame->hitTestContent(pos).enclosingBlockElement();
+
+    // Go up to the top-level element holding the clicked one.
+    while
+    (
+        !element.isNull()
+        && !element.parent().isNull()
+        && (element.parent().tagName() != "BODY")
+    )
+    {
+        element = element.parent();
+    }
+
+    if (element.isNull() || element.parent().isNull())
+    {
+        return -1;
+    }
+
+    // Go back to the marker of the block holding the element, taking the
+    // line of the nearest element marked with its source line on the way.
+    //
+    int renderLine = -1;
+
+    while (!element.isNull() && !element.hasClass("livepreviewblock"))
+    {
+        if ((renderLine < 0) && element.hasAttribute("data-source-line"))
+        {
+            renderLine = element.attribute("data-source-line").toInt();
+        }
+
+        element = element.previousSibling();
+    }
+
+    if (element.isNull())
+    {
+        return -1;
+    }
+
+    int index =
+        blockIndexes.value
+        (
+            element.attribute("id").mid(QString("livepreviewblock").length()).toInt(),
+            -1
+        );
+
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    const PreviewBlock& block = previewBlocks.at(index);
+    int blockLine = 0;
+
+    if (renderLine >= 0)
+    {
+        blockLine =
+            qBound(0, renderLine - block.renderLineOffset, block.lineCount - 1);
+    }
+
+    return blockFirstLines.at(index) + blockLine;
+}
+
+void HtmlPreview::cancelRender()
+{
+    renderCanceled = true;
+    renderExporter->cancelHtmlExport();
+}
+
+void HtmlPreview::setPage(const QList<PreviewBlock>& blocks, int scrollToIndex)
+{
+    QString pageHtml;
+
+    html = "";
+
+    for (int i = 0; i < blocks.size(); i++)
+    {
+        pageHtml += blockMarker(blocks.at(i).id);
+        pageHtml += blocks.at(i).html;
+        html += blocks.at(i).html;
+    }
+
+    previewBlocks = blocks;
+    updateBlockIndex();
+    htmlBrowser->setContent(pageHtml.toUtf8(), "text/html", baseUrl);
+
+    if (scrollToIndex < blocks.size())
+    {
+        htmlBrowser->page()->mainFrame()->scrollToAnchor
+        (
+            QString("livepreviewblock%1").arg(blocks.at(scrollToIndex).id)
+        );
+    }
+}
+
+void HtmlPreview::patchPage
+(
+    int prefixCount,
+    int suffixCount,
+    const QList<PreviewBlock>& newBlocks
+)
+{
+    QWebFrame* frame = htmlBrowser->page()->mainFrame();
+    QWebElement body = frame->findFirstElement("body");
+
+    // Remove the old blocks, each of which is made up of its marker and
+    // every element following the marker up to the next block's marker.
+    //
+    for (int i = prefixCount; i < (previewBlocks.size() - suffixCount); i++)
+    {
+        QWebElement element =
+            frame->findFirstElement
+            (
+                QString("#livepreviewblock%1").arg(previewBlocks.at(i).id)
+            );
+
+        while (!element.isNull())
+        {
+            QWebElement next = element.nextSibling();
+            element.removeFromDocument();
+            element = next;
+
+            if (element.hasClass("livepreviewblock"))
+            {
+                break;
+            }
+        }
+    }
+
+    // Insert the new blocks before the first unchanged block following
+    // them, or at the end of the page if there is none.
+    //
+    QString newHtml;
+
+    for (int i = 0; i < newBlocks.size(); i++)
+    {
+        newHtml += blockMarker(newBlocks.at(i).id);
+        newHtml += newBlocks.at(i).html;
+    }
+
+    if (suffixCount > 0)
+    {
+        QWebElement suffixMarker =
+            frame->findFirstElement
+            (
+                QString("#livepreviewblock%1")
+                    .arg(previewBlocks.at(previewBlocks.size() - suffixCount).id)
+            );
+
+        suffixMarker.prependOutside(newHtml);
+    }
+    else
+    {
+        body.appendInside(newHtml);
+    }
+
+    QList<PreviewBlock> blocks = previewBlocks.mid(0, prefixCount);
+    blocks += newBlocks;
+    blocks += previewBlocks.mid(previewBlocks.size() - suffixCount);
+    previewBlocks = blocks;
+    updateBlockIndex();
+
+    html = "";
+
+    for (int i = 0; i < previewBlocks.size(); i++)
+    {
+        html += previewBlocks.at(i).html;
+    }
+
+    if (!newBlocks.isEmpty())
+    {
+        frame->scrollToAnchor(QString("livepreviewblock%1").arg(newBlocks.first().id));
+    }
+    else if (prefixCount < previewBlocks.size())
+    {
+        frame->scrollToAnchor
+        (
+            QString("livepreviewblock%1").arg(previewBlocks.at(prefixCount).id)
+        );
+    }
+}
+
+void HtmlPreview::splitIntoBlocks
 (
     const QString& text,
+    QStringList& blocks,
+    QString& definitions
+) const
+{
+    QStringList lines = text.split('\n');
+    QString block;
+    QString fence;
+    int blockFirstLine = 0;
+    bool previousLineBlank = true;
+    bool inComment = false;
+
+    blocks.clear();
+    definitions = "";
+
+    for (int i = 0; i < lines.size(); i++)
+    {
+        const QString& line = lines.at(i);
+        bool blank = line.trimmed().isEmpty();
+
+        // Start a new block at a line following a blank line, unless the
+        // line could continue the block before it, such as a list item,
+        // indented text, a blockquote or the end of an HTML block.
+        //
+        if
+        (
+            previousLineBlank
+            && !blank
+            && fence.isEmpty()
+            && !inComment
+            && !block.isEmpty()
+            && !line[0].isSpace()
+            && (line[0] != '>')
+            && (line[0] != '<')
+            && !listItemExp.exactMatch(line)
+        )
+        {
+            blocks.append(block);
+            block = "";
+            blockFirstLine = i;
+        }
+
+        // Keep every line, including any blank lines at the start of the
+        // document, so that the blocks' lines add up to the document's.
+        //
+        if (i > blockFirstLine)
+        {
+            block += '\n';
+        }
+
+        block += line;
+
+        // Keep track of fenced code blocks and HTML comments, which may have
+        // blank lines within them.
+        //
+        QString trimmedLine = line.trimmed();
+
+        if (inComment)
+        {
+            inComment = !trimmedLine.contains("-->");
+        }
+        else if (fence.isEmpty())
+        {
+            if (trimmedLine.startsWith("```") || trimmedLine.startsWith("~~~"))
+            {
+                fence = trimmedLine.left(3);
+            }
+            else if
+            (
+                trimmedLine.startsWith("<!--")
+                && !trimmedLine.mid(4).contains("-->")
+            )
+            {
+                inComment = true;
+            }
+            else if (referenceDefinitionExp.exactMatch(line))
+            {
+                definitions += line;
+                definitions += '\n';
+            }
+        }
+        else if (trimmedLine.startsWith(fence))
+        {
+            fence = "";
+        }
+
+        previousLineBlank = blank;
+    }
+
+    if (!block.isEmpty() || blocks.isEmpty())
+    {
+        blocks.append(block);
+    }
+}
+
+QStringList HtmlPreview::renderBlocks
+(
+    const QStringList& texts,
+    const QString& definitions,
+    bool fullRender,
+    int firstBlockId,
     Exporter* exporter
 ) const
+{
+    QStringList blockHtml;
+
+    if (fullRender)
+    {
+        // Render the whole document at once, separating the blocks with
+        // marker elements by which to split the resulting HTML.  Only whole
+        // documents are cached, since the heading anchors of blocks rendered
+        // by themselves differ from one render to the next.  This way, the
+        // preview is shown right away when switching back to an exporter,
+        // or when reopening the preview.
+        //
+        QString html =
+            exportToHtml
+            (
+                texts.join(blockSeparator()),
+                headingAnchorPrefix(-1),
+                exporter,
+                true
+            );
+
+        blockHtml = html.split(blockSeparatorExp);
+
+        if (blockHtml.size() != texts.size())
+        {
+            blockHtml.clear();
+            blockHtml.append(html.remove(blockSeparatorExp));
+        }
+    }
+    else
+    {
+        for (int i = 0; i < texts.size(); i++)
+        {
+            if (exporter->isHtmlExportCanceled())
+            {
+                break;
+            }
+
+            blockHtml.append
+            (
+                exportToHtml
+                (
+                    texts.at(i) + "\n\n" + definitions,
+                    headingAnchorPrefix(firstBlockId + i),
+                    exporter
+                )
+            );
+        }
+    }
+
+    return blockHtml;
+}
+
+QString HtmlPreview::blockSeparator() const
+{
+    return QString("\n\n") + blockMarker(-1) + "\n\n";
+}
+
+QString HtmlPreview::blockMarker(int id) const
+{
+    if (id < 0)
+    {
+        return QString("<div class=\"livepreviewblock\"></div>");
+    }
+
+    return QString("<div id=\"livepreviewblock%1\" class=\"livepreviewblock\"></div>")
+        .arg(id);
+}
+
+QString HtmlPreview::headingAnchorPrefix(int blockId) const
+{
+    if (blockId < 0)
+    {
+        return QString("livepreviewhnbr");
+    }
+
+    return QString("livepreviewhnbr%1_").arg(blockId);
+}
+
+QString HtmlPreview::exportToHtml
+(
+    const QString& text,
+    const QString& anchorPrefix,
+    Exporter* exporter,
+    bool cached
+) const
 {
     QString html;
+    ExportOptions options;
 
     // Enable smart typography for preview, if available for the exporter.
-    bool smartTypographyEnabled = exporter->getSmartTypographyEnabled();
-    exporter->setSmartTypographyEnabled(true);
+    // The options are passed along with the text rather than set on the
+    // exporter, which may be exporting a file on another thread meanwhile.
+    //
+    options.smartTypographyEnabled = true;
 
-    // Export to HTML.
-    exporter->exportToHtml(text, html);
+    // Have the exporter give the headings anchors to which
+    // navigateToHeading() can scroll.
+    //
+    options.headingAnchorPrefix = anchorPrefix;
 
-    // Put smart typography setting back to the way it was before
-    // so that the last setting used during document export is remembered.
+    // Have the exporter mark the top-level elements with their source
+    // lines, so that the preview can be scrolled in step with the editor.
     //
-    exporter->setSmartTypographyEnabled(smartTypographyEnabled);
+    options.sourceLinesEnabled = true;
+
+    // Export to HTML, unless the text was rendered the same way before.
+    QByteArray key;
+
+    if (cached)
+    {
+        key =
+            RenderCache::computeKey
+            (
+                exporter,
+                NULL,
+                options,
+                QString(),
+                text.toUtf8()
+            );
+    }
+
+    if (!cached || !RenderCache::getInstance()->findHtml(key, html))
+    {
+        exporter->exportToHtml(text, options, html);
+
+        // Don't keep what was rendered before the render was canceled.
+        if (cached && !exporter->isHtmlExportCanceled())
+        {
+            RenderCache::getInstance()->insertHtml(key, html);
+        }
+    }
 
     return html;
 }
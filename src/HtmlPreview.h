@@ -24,9 +24,12 @@
 #include <QMainWindow>
 #include <QTextDocument>
 #include <QComboBox>
+#include <QElapsedTimer>
 #include <QThread>
 #include <QTimer>
 #include <QList>
+#include <QHash>
+#include <QVector>
 #include <QPrinter>
 #include <QPushButton>
 #include <QRegExp>
@@ -44,6 +47,7 @@
 #include "TextDocument.h"
 
 class QPrintPreviewDialog;
+class ExportJob;
 class QPrinter;
 
 /**
@@ -87,12 +91,38 @@ class HtmlPreview : public QMainWindow
          */
         void operationFinished();
 
+        /**
+         * Emitted when the preview has been updated, with the latency in
+         * milliseconds from the time the update was requested (i.e., when
+         * the user paused typing) until the new HTML was visible.
+         */
+        void previewUpdated(qint64 latency);
+
+        /**
+         * Emitted when the user double-clicks on the preview, with the
+         * position in the document of the Markdown block from which the
+         * clicked HTML element was rendered, so that the editor can move its
+         * cursor there.
+         */
+        void documentPositionNavigated(int position);
+
     public slots:
         /**
-         * Call this method to re-render the HTML for the document.
+         * Call this method to re-render the HTML for the document.  Only the
+         * top-level Markdown blocks that have changed since the last time
+         * the preview was updated are rendered again, and patched into the
+         * page that is already displayed.
          */
         void updatePreview();
 
+        /**
+         * Signalled by the text editor when the user has resumed typing.
+         * Cancels the update of the preview in progress, if any, since it
+         * will be superseded by the update made once the user pauses typing
+         * again.
+         */
+        void onTypingResumed();
+
         /**
          * Call this method to navigate to the HTML heading tag (h1 - h6)
          * having the given sequence number.  For example, to navigate to the
@@ -102,13 +132,32 @@ class HtmlPreview : public QMainWindow
          */
         void navigateToHeading(int headingSequenceNumber);
 
+        /**
+         * Call this method to scroll the preview to the HTML element rendered
+         * from the Markdown text at the given position in the document,
+         * such as when the cursor has moved in the editor.  Within a long
+         * element, the preview is scrolled in proportion to the position's
+         * line among the lines of the element's Markdown block.
+         */
+        void navigateToPosition(int position);
+
     private slots:
         void onHtmlReady();
         void onPreviewerChanged(int index);
+
+        /*
+         * Adds the exporters found once the search for installed Markdown
+         * processors has finished to the previewer combo box, switching to
+         * the previewer last used if it is among them.
+         */
+        void onExportersAdded();
         void changeStyleSheet(int index);
         void printPreview();
         void printHtmlToPrinter(QPrinter* printer);
         void onExport();
+        void onExportStarted(ExportJob* job);
+        void onExportFinished(const QString& err);
+        void onExportSummaryReady(const QString& summary);
         void copyHtml();
         void onLinkClicked(const QUrl& url);
 
@@ -122,12 +171,14 @@ class HtmlPreview : public QMainWindow
     protected:
         QSize sizeHint() const;
         void closeEvent(QCloseEvent* event);
+        bool eventFilter(QObject* watched, QEvent* event);
 
     private:
         QWebView* htmlBrowser;
         QUrl baseUrl;
         TextDocument* document;
         QComboBox* previewerComboBox;
+        QString preferredExporterName;
         QComboBox* styleSheetComboBox;
         Exporter* exporter;
         QTimer* htmlPreviewUpdateTimer;
@@ -135,7 +186,9 @@ class HtmlPreview : public QMainWindow
         bool documentChanged;
         bool typingPaused;
         QString html;
-        QRegExp headingTagExp;
+        QRegExp referenceDefinitionExp;
+        QRegExp listItemExp;
+        QRegExp blockSeparatorExp;
         int lastStyleSheetIndex;
         QStringList customCssFiles;
 
@@ -150,17 +203,201 @@ class HtmlPreview : public QMainWindow
         // flag used to prevent recursion in changeStyleSheet
         bool handlingStyleSheetChange;
 
-        QFutureWatcher<QString>* futureWatcher;
+        QFutureWatcher<QStringList>* futureWatcher;
         QStringList defaultStyleSheets;
 
         /*
-         * Sets the HTML contents to display, and creates a backup of the old
-         * HTML for diffing to scroll to the first difference whenever
-         * updatePreview() is called.
+         * A top-level Markdown block of the document, as displayed in the
+         * page.  Each block's HTML is preceded in the page by an empty
+         * marker element having the block's unique id, so that the block's
+         * HTML can be found and replaced.
+         */
+        struct PreviewBlock
+        {
+            QString text;
+            QString html;
+            int id;
+
+            // The anchor ids of the block's headings are the prefix
+            // followed by the heading numbers, counting from the first.
+            //
+            QString headingAnchorPrefix;
+            int firstHeadingNumber;
+            int headingCount;
+
+            // The number of lines of the block's text, and the line at
+            // which the text starts in the text that was rendered, which
+            // for a full render holds the blocks before it as well.
+            //
+            int lineCount;
+            int renderLineOffset;
+
+            // The lines of the block's text at which its top-level HTML
+            // elements start, in ascending order, if the exporter marks the
+            // elements with their source lines.  The elements' attributes
+            // hold these lines plus the render line offset.
+            //
+            QVector<int> sourceLines;
+        };
+
+        QList<PreviewBlock> previewBlocks;
+
+        // The line of the document at which each block of the page starts,
+        // and the index of each block in the page by block id, so that the
+        // preview can be scrolled to and from a line of the document without
+        // going through every block.
+        //
+        QVector<int> blockFirstLines;
+        QHash<int, int> blockIndexes;
+
+        // The line last navigated to from the preview, so that the cursor
+        // moving there in the editor doesn't scroll the preview back.
+        //
+        int navigatedLine;
+        QString referenceDefinitions;
+        int nextBlockId;
+        bool fullRenderNeeded;
+        bool updatePending;
+
+        // Only the latest render is displayed.  A render that is superseded
+        // while in progress is canceled, and its results are dropped.  The
+        // document revision, text and exporter of the last displayed render
+        // are kept so that renders of unchanged text are skipped.  The text
+        // itself is compared rather than a hash of it, so that a collision
+        // can't leave the preview stale, which costs little since QString
+        // shares its data between copies.
+        //
+        Exporter* renderExporter;
+        bool renderCanceled;
+        int renderRevision;
+        QString renderText;
+        int lastRenderedRevision;
+        QString lastRenderedText;
+        Exporter* lastRenderedExporter;
+
+        // The blocks being rendered in the background.  For an incremental
+        // render, only the new blocks between the unchanged prefix and
+        // suffix blocks of the page are rendered.
+        //
+        QStringList renderBlockTexts;
+        QString renderReferenceDefinitions;
+        bool renderIsFull;
+        int renderFirstBlockId;
+        int renderPrefixCount;
+        int renderSuffixCount;
+
+        QElapsedTimer updateLatencyTimer;
+
+        /*
+         * Sets the HTML contents to display, discarding the blocks of the
+         * previous page, so that the next update renders the whole document.
          */
         void setHtml(const QString& html);
 
-        QString exportToHtml(const QString& text, Exporter* exporter) const;
+        /*
+         * Rebuilds the index of the lines and ids of the blocks of the page,
+         * after the blocks have changed.
+         */
+        void updateBlockIndex();
+
+        /*
+         * Returns the source lines of the top-level elements of the given
+         * HTML, less the given line offset.  See PreviewBlock::sourceLines.
+         */
+        QVector<int> sourceLines(const QString& html, int lineOffset) const;
+
+        /*
+         * Returns the line of the document from which the HTML element at
+         * the given position in the preview was rendered, or -1 if none.
+         */
+        int sourceLineAt(const QPoint& pos) const;
+
+        /*
+         * Cancels the render in progress.
+         */
+        void cancelRender();
+
+        /*
+         * Displays a new page made up of the given blocks, scrolling to the
+         * given block index.
+         */
+        void setPage(const QList<PreviewBlock>& blocks, int scrollToIndex);
+
+        /*
+         * Replaces the blocks between the given prefix and suffix blocks of
+         * the page with the given new blocks, patching the page's DOM.
+         */
+        void patchPage
+        (
+            int prefixCount,
+            int suffixCount,
+            const QList<PreviewBlock>& newBlocks
+        );
+
+        /*
+         * Splits the given Markdown text into top-level blocks, which can be
+         * rendered independently of each other, and collects its reference
+         * definitions.
+         */
+        void splitIntoBlocks
+        (
+            const QString& text,
+            QStringList& blocks,
+            QString& definitions
+        ) const;
+
+        /*
+         * Renders the given blocks to HTML, returning the HTML for each.
+         * If fullRender is true, the blocks are rendered as a whole document
+         * at once, whereas otherwise each block is rendered separately with
+         * the given reference definitions appended, and with heading anchors
+         * prefixed by the block's id, counting from firstBlockId.  Gives up
+         * early if the render is canceled.  If the blocks of a full render
+         * cannot be told apart in the resulting HTML, a list holding only the
+         * HTML of the whole document is returned instead.  This method is
+         * run on a worker thread.
+         */
+        QStringList renderBlocks
+        (
+            const QStringList& texts,
+            const QString& definitions,
+            bool fullRender,
+            int firstBlockId,
+            Exporter* exporter
+        ) const;
+
+        /*
+         * Returns the text separating the blocks of a full render.
+         */
+        QString blockSeparator() const;
+
+        /*
+         * Returns the empty marker element preceding the block with the given
+         * id in the page.  A negative id returns the marker used to separate
+         * the blocks of a full render.
+         */
+        QString blockMarker(int id) const;
+
+        /*
+         * Returns the prefix of the heading anchor ids of the block with the
+         * given id, or of the whole page for a full render if the id is
+         * negative.
+         */
+        QString headingAnchorPrefix(int blockId) const;
+
+        /*
+         * Renders the given text to HTML with the given exporter, giving its
+         * headings anchors having the given id prefix, and its top-level
+         * elements their source lines.  If cached is true, the HTML is
+         * looked up in (and added to) the RenderCache.
+         */
+        QString exportToHtml
+        (
+            const QString& text,
+            const QString& anchorPrefix,
+            Exporter* exporter,
+            bool cached = false
+        ) const;
 };
 
 #endif
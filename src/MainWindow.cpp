@@ -69,6 +69,7 @@
 #include "DocumentStatisticsWidget.h"
 #include "SessionStatistics.h"
 #include "SessionStatisticsWidget.h"
+#include "ExportJob.h"
 
 #define GW_MAIN_WINDOW_GEOMETRY_KEY "Window/mainWindowGeometry"
 #define GW_MAIN_WINDOW_STATE_KEY "Window/mainWindowState"
@@ -174,6 +175,7 @@ MainWindow::MainWindow(const QString& filePath, QWidget* parent)
     highlighter = new MarkdownHighlighter(document);
     highlighter->setSpellCheckEnabled(appSettings->getLiveSpellCheckEnabled());
     highlighter->setBlockquoteStyle(appSettings->getBlockquoteStyle());
+    highlighter->setLargeDocumentThreshold(appSettings->getLargeDocumentThreshold());
     connect(highlighter, SIGNAL(headingFound(int,int,QString)), outlineWidget, SLOT(insertHeadingIntoOutline(int,int,QString)));
     connect(highlighter, SIGNAL(headingRemoved(int)), outlineWidget, SLOT(removeHeadingFromOutline(int)));
 
@@ -383,7 +385,10 @@ MainWindow::MainWindow(const QString& filePath, QWidget* parent)
     htmlPreview = new HtmlPreview(documentManager->getDocument(), NULL);
 
     connect(editor, SIGNAL(typingPaused()), htmlPreview, SLOT(updatePreview()));
+    connect(editor, SIGNAL(typingResumed()), htmlPreview, SLOT(onTypingResumed()));
     connect(outlineWidget, SIGNAL(headingNumberNavigated(int)), htmlPreview, SLOT(navigateToHeading(int)));
+    connect(editor, SIGNAL(cursorPositionChanged(int)), htmlPreview, SLOT(navigateToPosition(int)));
+    connect(htmlPreview, SIGNAL(documentPositionNavigated(int)), editor, SLOT(navigateDocument(int)));
     connect(htmlPreview, SIGNAL(operationStarted(QString)), this, SLOT(onOperationStarted(QString)));
     connect(htmlPreview, SIGNAL(operationFinished()), this, SLOT(onOperationFinished()));
 
@@ -609,6 +614,9 @@ void MainWindow::quitApplication()
 {
     if (documentManager->close())
     {
+        // Don't leave export commands running after the application quits.
+        ExportJob::cancelAll();
+
         appSettings->setAutoSaveEnabled(documentManager->getAutoSaveEnabled());
         appSettings->setBackupFileEnabled(documentManager->getFileBackupEnabled());
         appSettings->store();
@@ -635,6 +643,11 @@ void MainWindow::quitApplication()
     }
 }
 
+void MainWindow::cancelExports()
+{
+    ExportJob::cancelAll();
+}
+
 void MainWindow::changeTheme()
 {
     ThemeSelectionDialog* themeDialog = new ThemeSelectionDialog(theme.getName(), this);
@@ -1446,6 +1459,7 @@ void MainWindow::buildMenuBar()
     fileMenu->addAction(tr("&Print"), documentManager, SLOT(print()), QKeySequence::Print);
     fileMenu->addSeparator();
     fileMenu->addAction(tr("&Export"), documentManager, SLOT(exportFile()), QKeySequence("CTRL+E"));
+    fileMenu->addAction(tr("&Cancel Export"), this, SLOT(cancelExports()));
     fileMenu->addSeparator();
     fileMenu->addAction(tr("&Quit"), this, SLOT(quitApplication()), QKeySequence::Quit);
 
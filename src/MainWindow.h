@@ -77,6 +77,7 @@ class MainWindow : public QMainWindow
 
     private slots:
         void quitApplication();
+        void cancelExports();
         void changeTheme();
         void showFindReplaceDialog();
         void toggleHemingwayMode(bool checked);
@@ -118,6 +118,8 @@ MarkdownEditor::MarkdownEditor
     connect(this, SIGNAL(selectionChanged()), this, SLOT(onSelectionChanged()));
     connect(this, SIGNAL(typingResumed()), highlighter, SLOT(onTypingResumed()));
     connect(this, SIGNAL(typingPaused()), highlighter, SLOT(onTypingPaused()));
+    connect(this->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(updateVisibleBlockRange()));
+    connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(updateVisibleBlockRange()));
 
     addWordToDictionaryAction = new QAction(tr("Add word to dictionary"), this);
     checkSpellingAction = new QAction(tr("Check spelling..."), this);
@@ -456,6 +458,10 @@ bool MarkdownEditor::eventFilter(QObject* watched, QEvent* event)
     {
         mouseButtonDown = true;
     }
+    else if ((event->type() == QEvent::Resize) && (watched == viewport()))
+    {
+        updateVisibleBlockRange();
+    }
     else if (event->type() == QEvent::MouseButtonRelease)
     {
         mouseButtonDown = false;
@@ -1109,7 +1115,7 @@ void MarkdownEditor::suggestSpelling(QAction* action)
     {
         this->setTextCursor(cursorForWord);
         dictionary.addToPersonal(wordUnderMouse);
-        this->highlighter->rehighlight();
+        this->highlighter->rehighlightInBackground();
     }
     else if (action == checkSpellingAction)
     {
@@ -1283,7 +1289,7 @@ void MarkdownEditor::spellCheckFinished(int result)
 {
     Q_UNUSED(result)
 
-    highlighter->rehighlight();
+    highlighter->rehighlightInBackground();
 }
 
 void MarkdownEditor::onCursorPositionChanged()
@@ -1308,6 +1314,31 @@ void MarkdownEditor::onCursorPositionChanged()
     emit cursorPositionChanged(this->textCursor().position());
 }
 
+void MarkdownEditor::updateVisibleBlockRange()
+{
+    QTextBlock firstBlock = this->firstVisibleBlock();
+    QTextBlock lastBlock = firstBlock;
+    QTextBlock block = firstBlock;
+    QPointF offset = this->contentOffset();
+    int viewportBottom = this->viewport()->rect().bottom();
+
+    while
+    (
+        block.isValid()
+        && (blockBoundingGeometry(block).translated(offset).top() <= viewportBottom)
+    )
+    {
+        lastBlock = block;
+        block = block.next();
+    }
+
+    highlighter->setVisibleBlockRange
+    (
+        firstBlock.blockNumber(),
+        lastBlock.blockNumber()
+    );
+}
+
 void MarkdownEditor::handleCarriageReturn()
 {
     QString autoInsertText = "";
@@ -327,6 +327,12 @@ class MarkdownEditor : public QPlainTextEdit
         void spellCheckFinished(int result);
         void onCursorPositionChanged();
 
+        /*
+         * Informs the highlighter which blocks are currently visible in the
+         * viewport, so that they can be highlighted first.
+         */
+        void updateVisibleBlockRange();
+
     private:
         TextDocument* textDocument;
         MarkdownHighlighter* highlighter;
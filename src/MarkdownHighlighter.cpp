@@ -19,7 +19,9 @@
 
 #include <QBrush>
 #include <QColor>
+#include <QElapsedTimer>
 #include <QFont>
+#include <QHash>
 #include <QObject>
 #include <QRegExp>
 #include <QString>
@@ -28,22 +30,64 @@
 #include <QTextDocument>
 #include <QTextCursor>
 #include <QTextBlockFormat>
+#include <QTimer>
 #include <QStyle>
 #include <QApplication>
 #include <Qt>
 
+#include "BackgroundTokenizer.h"
 #include "MarkdownHighlighter.h"
 #include "MarkdownTokenizer.h"
 #include "MarkdownTokenTypes.h"
 #include "MarkdownStates.h"
 #include "ColorHelper.h"
+#include "TextBlockData.h"
 #include "spelling/dictionary_ref.h"
 #include "spelling/dictionary_manager.h"
 
 #define GW_FADE_ALPHA 200
 
+// Default time budget (in milliseconds) and maximum number of blocks for each
+// time slice of a background rehighlight.
+//
+#define GW_REHIGHLIGHT_SLICE_BUDGET 8
+#define GW_REHIGHLIGHT_SLICE_BLOCK_COUNT 500
+
+// Number of characters that must be inserted into the document between two
+// iterations of the event loop (i.e., by pasting or loading a file) before
+// the document is tokenized on worker threads rather than in highlightBlock().
+//
+#define GW_BACKGROUND_TOKENIZATION_CHAR_COUNT (64 * 1024)
+
+// Default document size (in characters) above which the highlighter switches
+// to large document mode.  See setLargeDocumentThreshold().
+//
+#define GW_LARGE_DOCUMENT_CHAR_COUNT (1024 * 1024)
+
+// Bit layout of the keys used to intern character formats.  The lowest bits
+// hold the color role, which is either a token type (for the token's color),
+// or one of the special roles below.
+//
+enum FormatKeyBits
+{
+    FormatKeyColorMask = 0x3F,
+    FormatKeyFaded = 0x40,
+    FormatKeyBold = 0x80,
+    FormatKeyItalic = 0x100,
+    FormatKeyUnderline = 0x200,
+    FormatKeyStrikeOut = 0x400,
+    FormatKeyBackground = 0x800,
+    FormatKeySpellingError = 0x1000,
+    FormatKeyFontSizeShift = 13,
+    FormatKeyFontSizeMask = 0xF << FormatKeyFontSizeShift
+};
+
+static const quint32 FORMAT_KEY_MARKUP_COLOR = TokenLast;
+static const quint32 FORMAT_KEY_DEFAULT_COLOR = TokenLast + 1;
+static const int FORMAT_KEY_MAX_FONT_SIZE_INCREASE = 0xF;
+
 MarkdownHighlighter::MarkdownHighlighter(QTextDocument* document)
-    : QSyntaxHighlighter(document), tokenizer(NULL),
+    : QSyntaxHighlighter((QObject*) document), tokenizer(NULL),
         dictionary(DictionaryManager::instance().requestDictionary()),
         cursorPosition(0),
         spellCheckEnabled(false),
@@ -54,10 +98,55 @@ MarkdownHighlighter::MarkdownHighlighter(QTextDocument* document)
         backgroundColor(Qt::white),
         markupColor(Qt::black),
         linkColor(Qt::blue),
-        spellingErrorColor(Qt::red)
+        spellingErrorColor(Qt::red),
+        rehighlightSliceBudget(GW_REHIGHLIGHT_SLICE_BUDGET),
+        rehighlightSliceBlockCount(GW_REHIGHLIGHT_SLICE_BLOCK_COUNT),
+        lastRehighlightSliceBlockCount(0),
+        firstVisibleBlockNumber(-1),
+        lastVisibleBlockNumber(-1),
+        nextRehighlightBlockNumber(0),
+        rehighlightBlocksRemaining(0),
+        lastBlockCount(0),
+        backtrackCount(0),
+        charsAddedSinceIdle(0),
+        tokenizationDeferred(false),
+        largeDocumentThreshold(GW_LARGE_DOCUMENT_CHAR_COUNT),
+        largeDocumentMode(false),
+        highlightingInSlice(false),
+        pendingBlockNumber(-1)
 {
     this->tokenizer = new MarkdownTokenizer();
 
+    rehighlightTimer = new QTimer(this);
+    rehighlightTimer->setInterval(0);
+    connect(rehighlightTimer, SIGNAL(timeout()), this, SLOT(rehighlightNextSlice()));
+
+    backgroundTokenizer = new BackgroundTokenizer(document, this);
+    connect(backgroundTokenizer, SIGNAL(finished()), this, SLOT(onBackgroundTokenizationFinished()));
+
+    idleTimer = new QTimer(this);
+    idleTimer->setInterval(0);
+    idleTimer->setSingleShot(true);
+    connect(idleTimer, SIGNAL(timeout()), this, SLOT(onIdle()));
+
+    pendingHighlightTimer = new QTimer(this);
+    pendingHighlightTimer->setInterval(0);
+    connect(pendingHighlightTimer, SIGNAL(timeout()), this, SLOT(highlightPendingBlocks()));
+
+    // Connect to the document's contentsChange() signal before the document
+    // is set, so that large insertions are detected before
+    // QSyntaxHighlighter begins highlighting the inserted blocks.
+    //
+    connect
+    (
+        document,
+        SIGNAL(contentsChange(int,int,int)),
+        this,
+        SLOT(onContentsChange(int,int,int))
+    );
+
+    setDocument(document);
+
     connect
     (
         this,
@@ -78,6 +167,11 @@ MarkdownHighlighter::MarkdownHighlighter(QTextDocument* document)
 
     setupTokenColors();
 
+    // Reserving the capacity ensures that the buffer is not shrunk when it is
+    // resized for shorter blocks.
+    //
+    formatKeys.reserve(256);
+
     for (int i = 0; i < TokenLast; i++)
     {
         applyStyleToMarkup[i] = false;
@@ -154,23 +248,59 @@ void MarkdownHighlighter::highlightBlock(const QString& text)
 
     setFormat(0, text.length(), defaultFormat);
 
+    // Leave blocks that are away from the viewport unformatted while a
+    // large insertion is being tokenized on worker threads, or while in
+    // large document mode.  They will be highlighted later on (see
+    // isHighlightingDeferred()).  Keeping the block's state as is prevents
+    // QSyntaxHighlighter from moving on to the next block.
+    //
+    if (isHighlightingDeferred(currentBlock()))
+    {
+        TextBlockData* blockData = (TextBlockData*) currentBlockUserData();
+
+        if (NULL == blockData)
+        {
+            blockData = new TextBlockData();
+            setCurrentBlockUserData(blockData);
+        }
+
+        blockData->highlightPending = true;
+        setCurrentBlockState(lastState);
+
+        // Blocks deferred during a background tokenization are highlighted
+        // once it is finished.  Otherwise, highlight them when idle.
+        //
+        if (!tokenizationDeferred)
+        {
+            schedulePendingHighlight(currentBlock().blockNumber());
+        }
+
+        return;
+    }
+
+    formatKeys.fill(FORMAT_KEY_DEFAULT_COLOR, text.length());
+
     if (NULL != tokenizer)
     {
-        tokenizer->clear();
-        
         QTextBlock block = this->currentBlock();
         int nextState = MarkdownStateUnknown;
         int previousState = this->previousBlockState();
 
+        // Look ahead at the next block's text rather than using its
+        // userState(), which may not have been updated yet.
+        //
         if (block.next().isValid())
         {
-            nextState = block.next().userState();
+            nextState = tokenizer->lookAhead(block.next().text());
         }
 
-        tokenizer->tokenize(text, lastState, previousState, nextState);
-        setCurrentBlockState(tokenizer->getState());
+        TextBlockData* blockData =
+            tokenizeCurrentBlock(text, lastState, previousState, nextState);
 
-        if (MarkdownStateBlockquote == tokenizer->getState())
+        blockData->highlightPending = false;
+        setCurrentBlockState(blockData->tokenizedState);
+
+        if (MarkdownStateBlockquote == blockData->tokenizedState)
         {
             inBlockquote = true;
         }
@@ -179,10 +309,12 @@ void MarkdownHighlighter::highlightBlock(const QString& text)
             inBlockquote = false;
         }
 
-        QList<Token> tokens = tokenizer->getTokens();
+        const QVector<Token>& tokens = blockData->tokens;
 
-        foreach (Token token, tokens)
+        for (int i = 0; i < tokens.size(); i++)
         {
+            const Token& token = tokens.at(i);
+
             switch (token.getType())
             {
                 case TokenAtxHeading1:
@@ -191,42 +323,41 @@ void MarkdownHighlighter::highlightBlock(const QString& text)
                 case TokenAtxHeading4:
                 case TokenAtxHeading5:
                 case TokenAtxHeading6:
-                    applyFormattingForToken(token);
-                    emit headingFound
-                    (
-                        block.position(),
-                        token.getType() - TokenAtxHeading1 + 1,
-                        text.mid
-                            (
-                                token.getPosition()
-                                    + token.getOpeningMarkupLength(),
-                                token.getLength()
-                                    - token.getOpeningMarkupLength()
-                                    - token.getClosingMarkupLength()
-                            ).trimmed()
-                    );
-                    break;
                 case TokenSetextHeading1Line1:
-                    applyFormattingForToken(token);
-                    emit headingFound(block.position(), 1, text);
-                    break;
                 case TokenSetextHeading2Line1:
-                    applyFormattingForToken(token);
-                    emit headingFound(block.position(), 2, text);
+                    applyFormattingForToken(token, text);
+                    emitHeadingFound(block.position(), token, text);
                     break;
                 case TokenUnknown:
                     qWarning("Highlighter found unknown token type in text block.");
                     break;
                 default:
-                    applyFormattingForToken(token);
+                    applyFormattingForToken(token, text);
                     break;
             }
         }
 
-        if (tokenizer->backtrackRequested())
+        // If the previous block was tokenized while this block had different
+        // text that changed its meaning (i.e., when the user has just typed
+        // or removed a setext heading underline), it must be highlighted
+        // again.  Otherwise, the document is highlighted in a single forward
+        // pass.
+        //
+        QTextBlock previous = block.previous();
+
+        if (previous.isValid())
         {
-            QTextBlock previous = currentBlock().previous();
-            emit highlightBlockAtPosition(previous.position());
+            TextBlockData* previousData = (TextBlockData*) previous.userData();
+
+            if
+            (
+                (NULL != previousData)
+                && previousData->tokensValid
+                && (previousData->nextState != tokenizer->lookAhead(text))
+            )
+            {
+                emit highlightBlockAtPosition(previous.position());
+            }
         }
     }
 
@@ -255,20 +386,22 @@ void MarkdownHighlighter::setDictionary(const DictionaryRef& dictionary)
 
     if (spellCheckEnabled)
     {
-        rehighlight();
+        rehighlightInBackground();
     }
 }
 
 void MarkdownHighlighter::increaseFontSize()
 {
     defaultFormat.setFontPointSize(defaultFormat.fontPointSize() + 1.0);
-    rehighlight();
+    formatCache.clear();
+    rehighlightInBackground();
 }
 
 void MarkdownHighlighter::decreaseFontSize()
 {
     defaultFormat.setFontPointSize(defaultFormat.fontPointSize() - 1.0);
-    rehighlight();
+    formatCache.clear();
+    rehighlightInBackground();
 }
 
 void MarkdownHighlighter::setColorScheme
@@ -287,19 +420,20 @@ void MarkdownHighlighter::setColorScheme
     this->spellingErrorColor = spellingErrorColor;
     defaultFormat.setForeground(QBrush(defaultTextColor));
     setupTokenColors();
-    rehighlight();
+    formatCache.clear();
+    rehighlightInBackground();
 }
 
 void MarkdownHighlighter::setEnableLargeHeadingSizes(const bool enable)
 {
     setupHeadingFontSize(enable);
-    rehighlight();
+    rehighlightInBackground();
 }
 
 void MarkdownHighlighter::setUseUnderlineForEmphasis(const bool enable)
 {
     useUndlerlineForEmphasis = enable;
-    rehighlight();
+    rehighlightInBackground();
 }
 
 void MarkdownHighlighter::setFont(const QString& fontFamily, const double fontSize)
@@ -310,13 +444,14 @@ void MarkdownHighlighter::setFont(const QString& fontFamily, const double fontSi
     font.setItalic(false);
     font.setPointSizeF(fontSize);
     defaultFormat.setFont(font);
-    rehighlight();
+    formatCache.clear();
+    rehighlightInBackground();
 }
 
 void MarkdownHighlighter::setSpellCheckEnabled(const bool enabled)
 {
     spellCheckEnabled = enabled;
-    rehighlight();
+    rehighlightInBackground();
 }
 
 void MarkdownHighlighter::setBlockquoteStyle(const BlockquoteStyle style)
@@ -333,7 +468,117 @@ void MarkdownHighlighter::setBlockquoteStyle(const BlockquoteStyle style)
             break;
     }
 
-    rehighlight();
+    rehighlightInBackground();
+}
+
+void MarkdownHighlighter::setRehighlightSliceBudget(int milliseconds)
+{
+    rehighlightSliceBudget = qMax(1, milliseconds);
+}
+
+int MarkdownHighlighter::getRehighlightSliceBudget() const
+{
+    return rehighlightSliceBudget;
+}
+
+void MarkdownHighlighter::setRehighlightSliceBlockCount(int count)
+{
+    rehighlightSliceBlockCount = qMax(1, count);
+}
+
+int MarkdownHighlighter::getRehighlightSliceBlockCount() const
+{
+    return rehighlightSliceBlockCount;
+}
+
+int MarkdownHighlighter::getLastRehighlightSliceBlockCount() const
+{
+    return lastRehighlightSliceBlockCount;
+}
+
+int MarkdownHighlighter::getBacktrackCount() const
+{
+    return backtrackCount;
+}
+
+void MarkdownHighlighter::setLargeDocumentThreshold(int characters)
+{
+    largeDocumentThreshold = qMax(0, characters);
+    largeDocumentMode = (document()->characterCount() >= largeDocumentThreshold);
+}
+
+int MarkdownHighlighter::getLargeDocumentThreshold() const
+{
+    return largeDocumentThreshold;
+}
+
+bool MarkdownHighlighter::isLargeDocumentModeEnabled() const
+{
+    return largeDocumentMode;
+}
+
+void MarkdownHighlighter::rehighlightInBackground()
+{
+    if
+    (
+        (firstVisibleBlockNumber < 0)
+        || (document()->blockCount() <= rehighlightSliceBlockCount)
+    )
+    {
+        rehighlightTimer->stop();
+        rehighlight();
+        return;
+    }
+
+    // Highlight the visible blocks right away.
+    int lastVisible = qMin(lastVisibleBlockNumber, document()->blockCount() - 1);
+    QTextBlock block = document()->findBlockByNumber(firstVisibleBlockNumber);
+    int visibleCount = 0;
+
+    while (block.isValid() && (block.blockNumber() <= lastVisible))
+    {
+        rehighlightBlock(block);
+        block = block.next();
+        visibleCount++;
+    }
+
+    // Highlight the remaining blocks in the background, starting after the
+    // visible ones and wrapping around to the beginning of the document.
+    //
+    nextRehighlightBlockNumber = block.isValid() ? block.blockNumber() : 0;
+    rehighlightBlocksRemaining = document()->blockCount() - visibleCount;
+    lastBlockCount = document()->blockCount();
+    rehighlightTimer->start();
+}
+
+void MarkdownHighlighter::setVisibleBlockRange
+(
+    int firstBlockNumber,
+    int lastBlockNumber
+)
+{
+    firstVisibleBlockNumber = firstBlockNumber;
+    lastVisibleBlockNumber = qMax(firstBlockNumber, lastBlockNumber);
+
+    // Highlight any blocks that were left unformatted as they scroll into
+    // view, unless they are waiting on a background tokenization.
+    //
+    if (!tokenizationDeferred)
+    {
+        QTextBlock block = document()->findBlockByNumber(firstVisibleBlockNumber);
+
+        while (block.isValid() && (block.blockNumber() <= lastVisibleBlockNumber))
+        {
+            TextBlockData* blockData = (TextBlockData*) block.userData();
+
+            if ((NULL != blockData) && blockData->highlightPending)
+            {
+                rehighlightBlock(block);
+            }
+
+            block = block.next();
+        }
+    }
 }
 
 void MarkdownHighlighter::onCursorPositionChanged(int position)
@@ -369,10 +614,328 @@ void MarkdownHighlighter::onTypingPaused()
 
 void MarkdownHighlighter::onHighlightBlockAtPosition(int position)
 {
+    backtrackCount++;
     QTextBlock block = document()->findBlock(position);
     rehighlightBlock(block);
 }
 
+void MarkdownHighlighter::rehighlightNextSlice()
+{
+    sliceTimer.start();
+    highlightingInSlice = true;
+
+    QTextBlock block = document()->findBlockByNumber(nextRehighlightBlockNumber);
+    int count = 0;
+
+    while
+    (
+        (rehighlightBlocksRemaining > 0)
+        && (count < rehighlightSliceBlockCount)
+        && (sliceTimer.elapsed() < rehighlightSliceBudget)
+    )
+    {
+        if (!block.isValid())
+        {
+            block = document()->begin();
+        }
+
+        rehighlightBlock(block);
+        block = block.next();
+        rehighlightBlocksRemaining--;
+        count++;
+    }
+
+    highlightingInSlice = false;
+    lastRehighlightSliceBlockCount = count;
+    nextRehighlightBlockNumber = block.isValid() ? block.blockNumber() : 0;
+
+    if (rehighlightBlocksRemaining <= 0)
+    {
+        rehighlightTimer->stop();
+    }
+}
+
+void MarkdownHighlighter::onContentsChange
+(
+    int position,
+    int charsRemoved,
+    int charsAdded
+)
+{
+    Q_UNUSED(charsRemoved)
+
+    backtrackCount = 0;
+
+    // Tally up the characters inserted until control returns to the event
+    // loop.  Typing never adds up to many, but pasting or loading a large
+    // document does, in which case the document is tokenized on worker
+    // threads once the insertion is done.
+    //
+    charsAddedSinceIdle += charsAdded;
+    idleTimer->start();
+    largeDocumentMode = (document()->characterCount() >= largeDocumentThreshold);
+
+    if
+    (
+        !tokenizationDeferred
+        && (charsAddedSinceIdle >= GW_BACKGROUND_TOKENIZATION_CHAR_COUNT)
+        && (firstVisibleBlockNumber >= 0)
+    )
+    {
+        tokenizationDeferred = true;
+    }
+
+    int editedBlockNumber = document()->findBlock(position).blockNumber();
+
+    // Blocks may have been added or removed before the next pending block,
+    // in which case the search for pending blocks must start over from the
+    // edit.
+    //
+    if ((pendingBlockNumber >= 0) && (editedBlockNumber < pendingBlockNumber))
+    {
+        pendingBlockNumber = editedBlockNumber;
+    }
+
+    if (!rehighlightTimer->isActive())
+    {
+        return;
+    }
+
+    // The edited blocks are highlighted right away by QSyntaxHighlighter, so
+    // only the block numbers of the blocks left to highlight need to be
+    // shifted to account for any lines that were added or removed.
+    //
+    int blockCountChange = document()->blockCount() - lastBlockCount;
+    lastBlockCount = document()->blockCount();
+
+    if (editedBlockNumber < nextRehighlightBlockNumber)
+    {
+        nextRehighlightBlockNumber =
+            qMax(editedBlockNumber, nextRehighlightBlockNumber + blockCountChange);
+    }
+
+    rehighlightBlocksRemaining =
+        qMax(0, rehighlightBlocksRemaining + blockCountChange);
+}
+
+void MarkdownHighlighter::onIdle()
+{
+    charsAddedSinceIdle = 0;
+
+    if (tokenizationDeferred)
+    {
+        backgroundTokenizer->tokenize();
+    }
+}
+
+void MarkdownHighlighter::onBackgroundTokenizationFinished()
+{
+    const QVector<TokenizedBlock>& results = backgroundTokenizer->getResults();
+    QTextBlock block = document()->begin();
+
+    // Install the tokens into the cache of each block that hasn't been
+    // edited since the snapshot was taken.  Since a block's revision alone
+    // doesn't tell whether an edit renumbered the blocks, the block's text
+    // must also still match the text that was tokenized.  (The cached
+    // tokens are only used by highlightBlock() if the neighboring states
+    // still match as well.)
+    //
+    // In large document mode, most blocks won't be highlighted for a while,
+    // so the headings are also reported to the outline right away from the
+    // tokens.
+    //
+    for (int i = 0; (i < results.size()) && block.isValid(); i++)
+    {
+        const TokenizedBlock& result = results.at(i);
+
+        // The length of a block counts its separator, unlike that of its
+        // text.
+        //
+        if
+        (
+            (block.revision() == result.revision)
+            && ((block.length() - 1) == result.textLength)
+            && (qHash(block.text()) == result.textHash)
+        )
+        {
+            TextBlockData* blockData = (TextBlockData*) block.userData();
+
+            if (NULL == blockData)
+            {
+                blockData = new TextBlockData();
+                block.setUserData(blockData);
+            }
+
+            blockData->tokens = result.tokens;
+            blockData->tokensValid = true;
+            blockData->textHash = result.textHash;
+            blockData->textLength = result.textLength;
+            blockData->previousState = result.previousState;
+            blockData->nextState = result.nextState;
+            blockData->tokenizedState = result.state;
+
+            if (largeDocumentMode && isHeadingBlockState(result.state))
+            {
+                QString text = block.text();
+
+                for (int j = 0; j < result.tokens.size(); j++)
+                {
+                    emitHeadingFound(block.position(), result.tokens.at(j), text);
+                }
+            }
+        }
+
+        block = block.next();
+    }
+
+    tokenizationDeferred = false;
+    rehighlightInBackground();
+}
+
+void MarkdownHighlighter::highlightPendingBlocks()
+{
+    if ((pendingBlockNumber < 0) || tokenizationDeferred)
+    {
+        pendingHighlightTimer->stop();
+        return;
+    }
+
+    sliceTimer.start();
+    highlightingInSlice = true;
+
+    QTextBlock block = document()->findBlockByNumber(pendingBlockNumber);
+
+    // Any block deferred again while this slice is highlighting will set
+    // the pending block number anew.
+    //
+    pendingBlockNumber = -1;
+
+    while (block.isValid() && (sliceTimer.elapsed() < rehighlightSliceBudget))
+    {
+        TextBlockData* blockData = (TextBlockData*) block.userData();
+
+        if ((NULL != blockData) && blockData->highlightPending)
+        {
+            // Highlighting the block may carry on through the blocks after
+            // it if its state changes, until the slice's time runs out.
+            //
+            rehighlightBlock(block);
+
+            if (pendingBlockNumber >= 0)
+            {
+                break;
+            }
+        }
+
+        block = block.next();
+    }
+
+    highlightingInSlice = false;
+
+    if ((pendingBlockNumber < 0) && block.isValid())
+    {
+        pendingBlockNumber = block.blockNumber();
+    }
+
+    if (pendingBlockNumber < 0)
+    {
+        pendingHighlightTimer->stop();
+    }
+}
+
+void MarkdownHighlighter::schedulePendingHighlight(int blockNumber)
+{
+    if ((pendingBlockNumber < 0) || (blockNumber < pendingBlockNumber))
+    {
+        pendingBlockNumber = blockNumber;
+    }
+
+    if (!pendingHighlightTimer->isActive())
+    {
+        pendingHighlightTimer->start();
+    }
+}
+
+bool MarkdownHighlighter::isHighlightingDeferred(const QTextBlock& block) const
+{
+    if ((firstVisibleBlockNumber < 0) || isBlockNearViewport(block))
+    {
+        return false;
+    }
+
+    if (tokenizationDeferred)
+    {
+        return true;
+    }
+
+    if (largeDocumentMode)
+    {
+        // Highlighting done in the background goes on until the slice's
+        // time runs out.
+        //
+        if (highlightingInSlice)
+        {
+            return sliceTimer.elapsed() >= rehighlightSliceBudget;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool MarkdownHighlighter::isBlockNearViewport(const QTextBlock& block) const
+{
+    // Include a page's worth of blocks above and below the visible blocks,
+    // so that they are ready to be scrolled into view.
+    //
+    int margin = lastVisibleBlockNumber - firstVisibleBlockNumber + 1;
+    int blockNumber = block.blockNumber();
+
+    return (blockNumber >= (firstVisibleBlockNumber - margin))
+        && (blockNumber <= (lastVisibleBlockNumber + margin));
+}
+
+void MarkdownHighlighter::emitHeadingFound
+(
+    int position,
+    const Token& token,
+    const QString& text
+)
+{
+    switch (token.getType())
+    {
+        case TokenAtxHeading1:
+        case TokenAtxHeading2:
+        case TokenAtxHeading3:
+        case TokenAtxHeading4:
+        case TokenAtxHeading5:
+        case TokenAtxHeading6:
+            emit headingFound
+            (
+                position,
+                token.getType() - TokenAtxHeading1 + 1,
+                text.mid
+                    (
+                        token.getPosition()
+                            + token.getOpeningMarkupLength(),
+                        token.getLength()
+                            - token.getOpeningMarkupLength()
+                            - token.getClosingMarkupLength()
+                    ).trimmed()
+            );
+            break;
+        case TokenSetextHeading1Line1:
+            emit headingFound(position, 1, text);
+            break;
+        case TokenSetextHeading2Line1:
+            emit headingFound(position, 2, text);
+            break;
+        default:
+            break;
+    }
+}
+
 bool MarkdownHighlighter::isHeadingBlockState(int state) const
 {
     switch (state)
@@ -391,6 +954,60 @@ bool MarkdownHighlighter::isHeadingBlockState(int state) const
     }
 }
 
+TextBlockData* MarkdownHighlighter::tokenizeCurrentBlock
+(
+    const QString& text,
+    int currentState,
+    int previousState,
+    int nextState
+)
+{
+    TextBlockData* blockData = (TextBlockData*) currentBlockUserData();
+
+    if (NULL == blockData)
+    {
+        blockData = new TextBlockData();
+        setCurrentBlockUserData(blockData);
+    }
+
+    uint textHash = qHash(text);
+
+    if
+    (
+        blockData->tokensValid
+        && (blockData->textHash == textHash)
+        && (blockData->textLength == text.length())
+        && (blockData->previousState == previousState)
+        && (blockData->nextState == nextState)
+    )
+    {
+        return blockData;
+    }
+
+    tokenizer->clear();
+    tokenizer->tokenize(text, currentState, previousState, nextState);
+
+    // Copy the tokens into the block's own buffer rather than sharing the
+    // tokenizer's, so that the tokenizer can keep reusing its buffer.
+    //
+    const QVector<Token>& tokens = tokenizer->getTokens();
+    blockData->tokens.resize(tokens.size());
+
+    for (int i = 0; i < tokens.size(); i++)
+    {
+        blockData->tokens[i] = tokens.at(i);
+    }
+
+    blockData->tokensValid = true;
+    blockData->textHash = textHash;
+    blockData->textLength = text.length();
+    blockData->previousState = previousState;
+    blockData->nextState = nextState;
+    blockData->tokenizedState = tokenizer->getState();
+
+    return blockData;
+}
+
 void MarkdownHighlighter::spellCheck(const QString& text)
 {
     QTextBlock cursorPosBlock = this->document()->findBlock(cursorPosition);
@@ -410,18 +1027,12 @@ void MarkdownHighlighter::spellCheck(const QString& text)
 
         if (typingPaused || (cursorPosInBlock != (startIndex + length)))
         {
-            QTextCharFormat spellingErrorFormat = format(startIndex);
-            spellingErrorFormat.setUnderlineColor(spellingErrorColor);
-            spellingErrorFormat.setUnderlineStyle
+            setFormatKey
             (
-                (QTextCharFormat::UnderlineStyle)
-                QApplication::style()->styleHint
-                (
-                    QStyle::SH_SpellCheckUnderlineStyle
-                )
+                startIndex,
+                length,
+                formatKeyAt(startIndex) | FormatKeySpellingError
             );
-
-            setFormat(startIndex, length, spellingErrorFormat);
         }
 
         startIndex += length;
@@ -496,54 +1107,64 @@ void MarkdownHighlighter::setupHeadingFontSize(bool useLargeHeadings)
     }
 }
 
-void MarkdownHighlighter::applyFormattingForToken(const Token& token)
+void MarkdownHighlighter::applyFormattingForToken
+(
+    const Token& token,
+    const QString& text
+)
 {
     if (TokenUnknown != token.getType())
     {
         int tokenType = token.getType();
-        QTextCharFormat format = this->format(token.getPosition());
 
-        QColor tokenColor = colorForToken[tokenType];
+        // Build upon the format of the enclosing token, if any.
+        quint32 baseKey = formatKeyAt(token.getPosition());
+        quint32 fadedKey = 0;
 
         if (inBlockquote && token.getType() != TokenBlockquote)
         {
-            tokenColor =
-                ColorHelper::applyAlpha
-                (
-                    tokenColor,
-                    backgroundColor,
-                    GW_FADE_ALPHA
-                );
+            fadedKey = FormatKeyFaded;
         }
 
-        format.setForeground(QBrush(tokenColor));
+        quint32 key =
+            (baseKey & ~(FormatKeyColorMask | FormatKeyFaded))
+            | tokenType
+            | fadedKey;
 
         if (strongToken[tokenType])
         {
-            format.setFontWeight(QFont::Bold);
+            key |= FormatKeyBold;
         }
 
         if (emphasizeToken[tokenType])
         {
             if (useUndlerlineForEmphasis && (tokenType != TokenBlockquote))
             {
-                format.setFontUnderline(true);
+                key |= FormatKeyUnderline;
             }
             else
             {
-                format.setFontItalic(true);
+                key |= FormatKeyItalic;
             }
         }
 
         if (strikethroughToken[tokenType])
         {
-            format.setFontStrikeOut(true);
+            key |= FormatKeyStrikeOut;
         }
 
-        format.setFontPointSize(format.fontPointSize()
-            + (qreal) fontSizeIncrease[tokenType]);
+        int sizeIncrease =
+            qMin
+            (
+                (int) ((key & FormatKeyFontSizeMask) >> FormatKeyFontSizeShift)
+                    + fontSizeIncrease[tokenType],
+                FORMAT_KEY_MAX_FONT_SIZE_INCREASE
+            );
 
-        QTextCharFormat markupFormat;
+        key = (key & ~FormatKeyFontSizeMask)
+            | (sizeIncrease << FormatKeyFontSizeShift);
+
+        quint32 markupKey;
 
         if
         (
@@ -551,31 +1172,21 @@ void MarkdownHighlighter::applyFormattingForToken(const Token& token)
             (!emphasizeToken[tokenType] || !useUndlerlineForEmphasis)
         )
         {
-            markupFormat = format;
+            markupKey = key;
         }
         else
         {
-            markupFormat = this->format(token.getPosition());
-        }
-
-        QColor adjustedMarkupColor = this->markupColor;
-
-        if (inBlockquote && token.getType() != TokenBlockquote)
-        {
-            adjustedMarkupColor =
-                ColorHelper::applyAlpha
-                (
-                    adjustedMarkupColor,
-                    backgroundColor,
-                    GW_FADE_ALPHA
-                );
+            markupKey = baseKey;
         }
 
-        markupFormat.setForeground(QBrush(adjustedMarkupColor));
+        markupKey =
+            (markupKey & ~(FormatKeyColorMask | FormatKeyFaded))
+            | FORMAT_KEY_MARKUP_COLOR
+            | fadedKey;
 
         if (strongMarkup[tokenType])
         {
-            markupFormat.setFontWeight(QFont::Bold);
+            markupKey |= FormatKeyBold;
         }
 
         if (token.getOpeningMarkupLength() > 0)
@@ -586,50 +1197,47 @@ void MarkdownHighlighter::applyFormattingForToken(const Token& token)
                 && (BlockquoteStyleFancy == blockquoteStyle)
             )
             {
-                markupFormat.setBackground(QBrush(adjustedMarkupColor));
-                QString text = currentBlock().text();
-
                 for (int i = token.getPosition(); i < token.getOpeningMarkupLength(); i++)
                 {
                     if (!text[i].isSpace())
                     {
-                        setFormat
+                        setFormatKey
                         (
                             i,
                             1,
-                            markupFormat
+                            markupKey | FormatKeyBackground
                         );
                     }
                 }
             }
             else
             {
-                setFormat
+                setFormatKey
                 (
                     token.getPosition(),
                     token.getOpeningMarkupLength(),
-                    markupFormat
+                    markupKey
                 );
             }
         }
 
-        setFormat
+        setFormatKey
         (
             token.getPosition() + token.getOpeningMarkupLength(),
             token.getLength()
                 - token.getOpeningMarkupLength()
                 - token.getClosingMarkupLength(),
-            format
+            key
         );
 
         if (token.getClosingMarkupLength() > 0)
         {
-            setFormat
+            setFormatKey
             (
                 token.getPosition() + token.getLength()
                     - token.getClosingMarkupLength(),
                 token.getClosingMarkupLength(),
-                markupFormat
+                markupKey
             );
         }
     }
@@ -639,3 +1247,108 @@ void MarkdownHighlighter::applyFormattingForToken(const Token& token)
             "token of unknown type.");
     }
 }
+
+QTextCharFormat MarkdownHighlighter::formatForKey(quint32 key)
+{
+    QHash<quint32, QTextCharFormat>::const_iterator cached =
+        formatCache.constFind(key);
+
+    if (cached != formatCache.constEnd())
+    {
+        return cached.value();
+    }
+
+    QTextCharFormat format = defaultFormat;
+    quint32 colorRole = key & FormatKeyColorMask;
+    QColor color = defaultTextColor;
+
+    if (FORMAT_KEY_MARKUP_COLOR == colorRole)
+    {
+        color = markupColor;
+    }
+    else if (colorRole < (quint32) TokenLast)
+    {
+        color = colorForToken[colorRole];
+    }
+
+    if (key & FormatKeyFaded)
+    {
+        color = ColorHelper::applyAlpha(color, backgroundColor, GW_FADE_ALPHA);
+    }
+
+    format.setForeground(QBrush(color));
+
+    if (key & FormatKeyBackground)
+    {
+        format.setBackground(QBrush(color));
+    }
+
+    if (key & FormatKeyBold)
+    {
+        format.setFontWeight(QFont::Bold);
+    }
+
+    if (key & FormatKeyItalic)
+    {
+        format.setFontItalic(true);
+    }
+
+    if (key & FormatKeyUnderline)
+    {
+        format.setFontUnderline(true);
+    }
+
+    if (key & FormatKeyStrikeOut)
+    {
+        format.setFontStrikeOut(true);
+    }
+
+    format.setFontPointSize
+    (
+        defaultFormat.fontPointSize()
+            + (qreal) ((key & FormatKeyFontSizeMask) >> FormatKeyFontSizeShift)
+    );
+
+    if (key & FormatKeySpellingError)
+    {
+        format.setUnderlineColor(spellingErrorColor);
+        format.setUnderlineStyle
+        (
+            (QTextCharFormat::UnderlineStyle)
+            QApplication::style()->styleHint
+            (
+                QStyle::SH_SpellCheckUnderlineStyle
+            )
+        );
+    }
+
+    formatCache.insert(key, format);
+    return format;
+}
+
+quint32 MarkdownHighlighter::formatKeyAt(int position) const
+{
+    if ((position >= 0) && (position < formatKeys.size()))
+    {
+        return formatKeys.at(position);
+    }
+
+    return FORMAT_KEY_DEFAULT_COLOR;
+}
+
+void MarkdownHighlighter::setFormatKey(int start, int count, quint32 key)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    setFormat(start, count, formatForKey(key));
+
+    int end = qMin(start + count, formatKeys.size());
+
+    for (int i = qMax(start, 0); i < end; i++)
+    {
+        formatKeys[i] = key;
+    }
+}
@@ -20,7 +20,12 @@
 #ifndef MARKDOWN_HIGHLIGHTER_H
 #define MARKDOWN_HIGHLIGHTER_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QSyntaxHighlighter>
+#include <QTextCharFormat>
+#include <QTimer>
+#include <QVector>
 
 #include "spelling/dictionary_ref.h"
 #include "MarkdownTokenizer.h"
@@ -30,9 +35,12 @@
 class QColor;
 class QRegExp;
 class QString;
+class QTextBlock;
 class QTextCharFormat;
 class QTextDocument;
+class BackgroundTokenizer;
 class HighlightTokenizer;
+class TextBlockData;
 
 /**
  * Highlighter for the Markdown text format.
@@ -111,6 +119,67 @@ class MarkdownHighlighter : public QSyntaxHighlighter
          */
         void setBlockquoteStyle(const BlockquoteStyle style);
 
+        /**
+         * Sets the maximum time in milliseconds spent highlighting blocks
+         * during each time slice of a background rehighlight.  See
+         * rehighlightInBackground() for details.
+         */
+        void setRehighlightSliceBudget(int milliseconds);
+
+        /**
+         * Returns the maximum time in milliseconds spent highlighting blocks
+         * during each time slice of a background rehighlight.
+         */
+        int getRehighlightSliceBudget() const;
+
+        /**
+         * Sets the maximum number of blocks highlighted during each time
+         * slice of a background rehighlight.
+         */
+        void setRehighlightSliceBlockCount(int count);
+
+        /**
+         * Returns the maximum number of blocks highlighted during each time
+         * slice of a background rehighlight.
+         */
+        int getRehighlightSliceBlockCount() const;
+
+        /**
+         * Returns the number of blocks that were actually highlighted during
+         * the most recent time slice of a background rehighlight, for use in
+         * tuning the slice budget and block count.
+         */
+        int getLastRehighlightSliceBlockCount() const;
+
+        /**
+         * Returns the number of times since the document was last edited
+         * that a block had to be highlighted again after the block following
+         * it was highlighted.  This should be at most one per edit.
+         */
+        int getBacktrackCount() const;
+
+        /**
+         * Sets the size of the document (in characters) above which the
+         * highlighter switches to large document mode.  In this mode, only
+         * the blocks near the visible blocks in the text editor (see
+         * setVisibleBlockRange()) are highlighted as the document is edited.
+         * The remaining blocks are highlighted as they are scrolled into
+         * view, or in small time slices in the event loop.
+         */
+        void setLargeDocumentThreshold(int characters);
+
+        /**
+         * Returns the size of the document (in characters) above which the
+         * highlighter switches to large document mode.
+         */
+        int getLargeDocumentThreshold() const;
+
+        /**
+         * Returns true if the document is large enough for the highlighter
+         * to be in large document mode.
+         */
+        bool isLargeDocumentModeEnabled() const;
+
     signals:
         /**
          * Notifies listeners that a heading was found in the document at the
@@ -128,17 +197,39 @@ class MarkdownHighlighter : public QSyntaxHighlighter
          * FOR INTERNAL USE ONLY
          *
          * This signal is used internally to restart highlighting on the
-         * previous line, which is needed for setext headings.  Unfortunately,
-         * QSyntaxHighlighter only goes forward in its highlighting, not
-         * backwards.  Neither can rehighlightBlock() be called internally,
-         * since recursive calls to the class will wipe its state data and will
-         * cause the application to crash. This is a workaround to queue a
-         * highlighting action for the prior text block in the event system,
-         * so that recursion isn't used.
+         * previous line, which is needed when an edit to a line changes the
+         * meaning of the line before it (i.e., typing a setext heading
+         * underline).  Unfortunately, QSyntaxHighlighter only goes forward in
+         * its highlighting, not backwards.  Neither can rehighlightBlock() be
+         * called internally, since recursive calls to the class will wipe its
+         * state data and will cause the application to crash. This is a
+         * workaround to queue a highlighting action for the prior text block
+         * in the event system, so that recursion isn't used.
          */
         void highlightBlockAtPosition(int position);
 
     public slots:
+        /**
+         * Reapplies highlighting to the whole document without blocking the
+         * user interface.  The blocks visible in the text editor (see
+         * setVisibleBlockRange()) are highlighted immediately, after which
+         * the rest of the document is highlighted in small time slices in
+         * the event loop.  If no visible block range has been set, the whole
+         * document is highlighted immediately with rehighlight().
+         *
+         * Note that this is intended for changes that affect only the
+         * styling of the text, such as theme, font, or spell checking
+         * changes, rather than the line states of the blocks.
+         */
+        void rehighlightInBackground();
+
+        /**
+         * Sets the range of block numbers that are currently visible in the
+         * text editor, which are highlighted first by
+         * rehighlightInBackground().
+         */
+        void setVisibleBlockRange(int firstBlockNumber, int lastBlockNumber);
+
         /**
          * Connect to this slot to signal when the the cursor position
          * in the text editor changes.  The cursor position is used
@@ -170,6 +261,37 @@ class MarkdownHighlighter : public QSyntaxHighlighter
          */
         void onHighlightBlockAtPosition(int position);
 
+        /*
+         * Highlights the next time slice of blocks during a background
+         * rehighlight.
+         */
+        void rehighlightNextSlice();
+
+        /*
+         * Keeps the position of a background rehighlight in sync with edits
+         * made to the document while it is in progress.
+         */
+        void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+        /*
+         * Called once control returns to the event loop after the document
+         * was changed, to start tokenizing the document on worker threads
+         * if a large insertion was made.
+         */
+        void onIdle();
+
+        /*
+         * Installs the tokens produced on the worker threads into the blocks'
+         * token caches, and highlights the document from them.
+         */
+        void onBackgroundTokenizationFinished();
+
+        /*
+         * Highlights the next time slice of blocks that were left
+         * unformatted away from the viewport.
+         */
+        void highlightPendingBlocks();
+
     private:
         HighlightTokenizer* tokenizer;
         DictionaryRef dictionary;
@@ -186,6 +308,17 @@ class MarkdownHighlighter : public QSyntaxHighlighter
         QColor spellingErrorColor;
 
 		QTextCharFormat defaultFormat;
+
+        // Character formats are interned by a key that encodes the color role,
+        // font styles and heading size applied to the text (see
+        // formatForKey()), so that the same few formats are shared by every
+        // token in the document rather than being built anew for each token.
+        // The keys of the formats applied to each character of the block
+        // currently being highlighted are tracked in formatKeys so that
+        // nested tokens can build upon the formats of their enclosing tokens.
+        //
+        QHash<quint32, QTextCharFormat> formatCache;
+        QVector<quint32> formatKeys;
         bool applyStyleToMarkup[TokenLast];
         QColor colorForToken[TokenLast];
         bool emphasizeToken[TokenLast];
@@ -194,17 +327,104 @@ class MarkdownHighlighter : public QSyntaxHighlighter
         bool strikethroughToken[TokenLast];
         int fontSizeIncrease[TokenLast];
 
+        QTimer* rehighlightTimer;
+        int rehighlightSliceBudget;
+        int rehighlightSliceBlockCount;
+        int lastRehighlightSliceBlockCount;
+        int firstVisibleBlockNumber;
+        int lastVisibleBlockNumber;
+        int nextRehighlightBlockNumber;
+        int rehighlightBlocksRemaining;
+        int lastBlockCount;
+        int backtrackCount;
+
+        // Large insertions into the document are tokenized on worker threads
+        // by the background tokenizer, during which time highlightBlock()
+        // only highlights the blocks near the viewport.
+        //
+        BackgroundTokenizer* backgroundTokenizer;
+        QTimer* idleTimer;
+        int charsAddedSinceIdle;
+        bool tokenizationDeferred;
+
+        // In large document mode, blocks away from the viewport are marked
+        // as pending rather than highlighted.  The pending block number is
+        // where the search for pending blocks to highlight in the next time
+        // slice starts.
+        //
+        int largeDocumentThreshold;
+        bool largeDocumentMode;
+        bool highlightingInSlice;
+        QElapsedTimer sliceTimer;
+        QTimer* pendingHighlightTimer;
+        int pendingBlockNumber;
+
+        /*
+         * Returns true if highlighting of the given block is to be deferred
+         * until later.
+         */
+        bool isHighlightingDeferred(const QTextBlock& block) const;
+
+        /*
+         * Returns true if the given block is within a page's worth of the
+         * blocks visible in the text editor.
+         */
+        bool isBlockNearViewport(const QTextBlock& block) const;
+
+        /*
+         * Schedules the pending blocks starting from the given block number
+         * to be highlighted in time slices in the event loop.
+         */
+        void schedulePendingHighlight(int blockNumber);
+
+        /*
+         * Emits the headingFound() signal if the given token is a heading.
+         */
+        void emitHeadingFound(int position, const Token& token, const QString& text);
+
         /*
          * Returns true if the given QTextBlock userState indicates that the
          * text block contains a heading.
          */
         bool isHeadingBlockState(int state) const;
 
+        /*
+         * Returns the block data of the current block, holding the tokens and
+         * resulting line state for the given text.  The text is only
+         * tokenized if the tokens cached from the last time the block was
+         * highlighted are out of date.
+         */
+        TextBlockData* tokenizeCurrentBlock
+        (
+            const QString& text,
+            int currentState,
+            int previousState,
+            int nextState
+        );
+
         void spellCheck(const QString& text);
         void setupTokenColors();
         void setupHeadingFontSize(bool useLargeHeadings);
 
-        void applyFormattingForToken(const Token& token);
+        void applyFormattingForToken(const Token& token, const QString& text);
+
+        /*
+         * Returns the interned character format for the given format key,
+         * creating it if it does not already exist.
+         */
+        QTextCharFormat formatForKey(quint32 key);
+
+        /*
+         * Returns the key of the format applied to the character at the given
+         * position in the current block.
+         */
+        quint32 formatKeyAt(int position) const;
+
+        /*
+         * Applies the format with the given key to the given range of
+         * characters in the current block.
+         */
+        void setFormatKey(int start, int count, quint32 key);
 
 };
 
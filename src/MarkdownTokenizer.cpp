@@ -24,18 +24,143 @@
 #include "MarkdownTokenizer.h"
 #include "MarkdownStates.h"
 
-// This character is used to replace escape characters and other characters
-// with special meaning in a dummy copy of the current line being parsed,
-// for ease of parsing.
+static const int MAX_MARKDOWN_HEADING_LEVEL = 6;
+
+/*
+ * Returns true if the given character would be matched by \w in a regular
+ * expression.
+ */
+static inline bool isWordChar(const QChar& c)
+{
+    return c.isLetterOrNumber() || c.isMark() || (QChar('_') == c);
+}
+
+/*
+ * Returns true if the given character is an ASCII letter.
+ */
+static inline bool isAsciiLetter(const QChar& c)
+{
+    return ((c >= QChar('a')) && (c <= QChar('z')))
+        || ((c >= QChar('A')) && (c <= QChar('Z')));
+}
+
+/*
+ * Returns true if the given character is an ASCII digit.
+ */
+static inline bool isAsciiDigit(const QChar& c)
+{
+    return (c >= QChar('0')) && (c <= QChar('9'));
+}
+
+/*
+ * Flags for the block-level rules that a line could match, as determined by
+ * classifyLine().  Each block rule is only tried if its flag is set for the
+ * line.
+ */
+enum BlockRule
+{
+    BlockRuleBlank = 0x01,
+    BlockRuleIndented = 0x02,
+    BlockRuleAtxHeading = 0x04,
+    BlockRuleSetextHeadingLine2 = 0x08,
+    BlockRuleCodeFence = 0x10,
+    BlockRuleHorizontalRule = 0x20,
+    BlockRuleTableDivider = 0x40,
+    BlockRuleBlockquote = 0x80,
+    BlockRuleNumberedList = 0x100,
+    BlockRuleBulletPointList = 0x200
+};
+
+// Rules which can only match if the line has no leading whitespace.
+static const unsigned int BLOCK_RULES_AT_LINE_START =
+    BlockRuleAtxHeading | BlockRuleSetextHeadingLine2 | BlockRuleCodeFence;
+
+// The block rules that a line could match given its first non-whitespace
+// ASCII character.  Lines starting with any other character (i.e., letters)
+// can only be paragraph text or the first line of a setext heading.
 //
-static const QChar DUMMY_CHAR('$');
+#define BLOCK_RULES_FOR_CHAR(c) \
+    (((c) == '#') ? BlockRuleAtxHeading : \
+    ((c) == '=') ? BlockRuleSetextHeadingLine2 : \
+    ((c) == '-') ? (BlockRuleSetextHeadingLine2 | BlockRuleHorizontalRule \
+        | BlockRuleTableDivider | BlockRuleBulletPointList) : \
+    (((c) == '`') || ((c) == '~')) ? BlockRuleCodeFence : \
+    ((c) == '*') ? (BlockRuleHorizontalRule | BlockRuleBulletPointList) : \
+    ((c) == '_') ? BlockRuleHorizontalRule : \
+    ((c) == '+') ? BlockRuleBulletPointList : \
+    ((c) == '|') ? BlockRuleTableDivider : \
+    ((c) == '>') ? BlockRuleBlockquote : \
+    (((c) >= '0') && ((c) <= '9')) ? BlockRuleNumberedList : \
+    0)
+
+#define BLOCK_RULES_4(c) \
+    BLOCK_RULES_FOR_CHAR(c), BLOCK_RULES_FOR_CHAR((c) + 1), \
+    BLOCK_RULES_FOR_CHAR((c) + 2), BLOCK_RULES_FOR_CHAR((c) + 3)
+
+#define BLOCK_RULES_16(c) \
+    BLOCK_RULES_4(c), BLOCK_RULES_4((c) + 4), \
+    BLOCK_RULES_4((c) + 8), BLOCK_RULES_4((c) + 12)
+
+static const unsigned short BLOCK_RULE_TABLE[128] =
+{
+    BLOCK_RULES_16(0), BLOCK_RULES_16(16), BLOCK_RULES_16(32),
+    BLOCK_RULES_16(48), BLOCK_RULES_16(64), BLOCK_RULES_16(80),
+    BLOCK_RULES_16(96), BLOCK_RULES_16(112)
+};
+
+/*
+ * Returns whether the given line is indented by a tab or four spaces, as
+ * code block lines are.
+ */
+static bool isIndented(const QString& text)
+{
+    return text.startsWith(QChar('\t'))
+        || text.startsWith(QLatin1String("    "));
+}
 
-static const int MAX_MARKDOWN_HEADING_LEVEL = 6;
+/*
+ * Returns the BlockRule flags for the block-level rules that the given line
+ * could possibly match, judging by its leading whitespace and first
+ * non-whitespace character.
+ */
+static unsigned int classifyLine(const QString& text)
+{
+    int i = 0;
+
+    while ((i < text.length()) && text[i].isSpace())
+    {
+        i++;
+    }
+
+    if (i >= text.length())
+    {
+        return BlockRuleBlank;
+    }
+
+    unsigned int rules = 0;
+    ushort c = text[i].unicode();
+
+    if (c < 128)
+    {
+        rules = BLOCK_RULE_TABLE[c];
+    }
+
+    if (i > 0)
+    {
+        rules &= ~BLOCK_RULES_AT_LINE_START;
+    }
+
+    if (isIndented(text))
+    {
+        rules |= BlockRuleIndented;
+    }
+
+    return rules;
+}
 
 
 MarkdownTokenizer::MarkdownTokenizer()
 {
-    paragraphBreakRegex.setPattern("^\\s*$");
     heading1SetextRegex.setPattern("^===+\\s*$");
     heading2SetextRegex.setPattern("^---+\\s*$");
     blockquoteRegex.setPattern("^ {0,3}>.*$");
@@ -46,28 +171,6 @@ MarkdownTokenizer::MarkdownTokenizer()
     numberedListRegex.setPattern("^ {0,3}[0-9]+[.)]\\s+.*$");
     numberedNestedListRegex.setPattern("^\\s*[0-9]+[.)]\\s+.*$");
     hruleRegex.setPattern("\\s*(\\*\\s*){3,}|(\\s*(_\\s*){3,})|((\\s*(-\\s*){3,}))");
-    emphasisRegex.setPattern("(\\*(?![\\s*]).*[^\\s*]\\*)|_(?![\\s_]).*[^\\s_]_");
-    emphasisRegex.setMinimal(true);
-    strongRegex.setPattern("\\*\\*(?=\\S).*\\S\\*\\*(?!\\*)|__(?=\\S).*\\S__(?!_)");
-    strongRegex.setMinimal(true);
-    strikethroughRegex.setPattern("~~[^\\s]+.*[^\\s]+~~");
-    strikethroughRegex.setMinimal(true);
-    verbatimRegex.setPattern("`+");
-    htmlTagRegex.setPattern("<[^<>]+>");
-    htmlTagRegex.setMinimal(true);
-    htmlEntityRegex.setPattern("&[a-zA-Z]+;|&#x?[0-9]+;");
-    automaticLinkRegex.setPattern("(<[a-zA-Z]+\\:.+>)|(<.+@.+>)");
-    automaticLinkRegex.setMinimal(true);
-    inlineLinkRegex.setPattern("\\[.+\\]\\(.+\\)");
-    inlineLinkRegex.setMinimal(true);
-    referenceLinkRegex.setPattern("\\[(.+)\\]");
-    referenceLinkRegex.setMinimal(true);
-    referenceDefinitionRegex.setPattern("^\\s*\\[.+\\]:");
-    imageRegex.setPattern("!\\[.*\\]\\(.+\\)");
-    imageRegex.setMinimal(true);
-    htmlInlineCommentRegex.setPattern("<!--.*-->");
-    htmlInlineCommentRegex.setMinimal(true);
-    mentionRegex.setPattern("\\B@\\w+(\\-\\w+)*(/\\w+(\\-\\w+)*)?");
     pipeTableDividerRegex.setPattern("^ {0,3}(\\|[ :]?)?-{3,}([ :]?\\|[ :]?-{3,}([ :]?\\|)?)+\\s*$");
 }
         
@@ -87,11 +190,12 @@ void MarkdownTokenizer::tokenize
     this->currentState = currentState;
     this->previousState = previousState;
     this->nextState = nextState;
+    this->lineRules = classifyLine(text);
 
     if
     (
         (MarkdownStateComment != previousState)
-        && paragraphBreakRegex.exactMatch(text)
+        && (lineRules & BlockRuleBlank)
     )
     {
         if
@@ -108,8 +212,8 @@ void MarkdownTokenizer::tokenize
             (MarkdownStateCodeBlock != previousState)
             ||
             (
-                !text.startsWith("\t")
-                && !text.endsWith("    ")
+                !text.startsWith(QChar('\t'))
+                && !text.endsWith(QLatin1String("    "))
             )
         )
         {
@@ -130,7 +234,6 @@ void MarkdownTokenizer::tokenize
     else if 
     (
         tokenizeAtxHeading(text)
-        || tokenizeSetextHeadingLine1(text)
         || tokenizeBlockquote(text)
         || tokenizeNumberedList(text)
         || tokenizeBulletPointList(text)
@@ -151,7 +254,7 @@ void MarkdownTokenizer::tokenize
             (
                 !tokenizeNumberedList(text)
                 && !tokenizeBulletPointList(text)
-                && (text.startsWith("\t") || text.startsWith("    "))
+                && isIndented(text)
             )
             {
                 setState(previousState);
@@ -166,29 +269,59 @@ void MarkdownTokenizer::tokenize
             setState(MarkdownStateParagraph);
         }
 
+        // A paragraph line followed by a setext heading underline is the
+        // first line of the heading.
+        //
+        if (MarkdownStateParagraph == getState())
+        {
+            tokenizeSetextHeadingLine1(text);
+        }
+
         // tokenize inline
         tokenizeInline(text);
     }
+}
 
-    // Make sure that if the second line of a setext heading is removed the
-    // first line is reprocessed.  Otherwise, it will still show up in the
-    // document as a heading.
+int MarkdownTokenizer::lookAhead(const QString& text) const
+{
+    // Quickly rule out lines that cannot possibly be a setext heading
+    // underline or a table divider before trying the regular expressions.
     //
+    int i = 0;
+
+    while ((i < text.length()) && (i < 4) && (QChar(' ') == text[i]))
+    {
+        i++;
+    }
+
     if
     (
-        (
-            (previousState == MarkdownStateSetextHeading1Line1)
-            && (this->getState() != MarkdownStateSetextHeading1Line2)
-        )
+        (i >= text.length())
         ||
         (
-            (previousState == MarkdownStateSetextHeading2Line1)
-            && (this->getState() != MarkdownStateSetextHeading2Line2)
+            (QChar('=') != text[i])
+            && (QChar('-') != text[i])
+            && (QChar('|') != text[i])
         )
     )
     {
-        this->requestBacktrack();
+        return MarkdownStateUnknown;
+    }
+
+    if (heading1SetextRegex.exactMatch(text))
+    {
+        return MarkdownStateSetextHeading1Line2;
+    }
+    else if (heading2SetextRegex.exactMatch(text))
+    {
+        return MarkdownStateSetextHeading2Line2;
     }
+    else if (pipeTableDividerRegex.exactMatch(text))
+    {
+        return MarkdownStatePipeTableDivider;
+    }
+
+    return MarkdownStateUnknown;
 }
 
 bool MarkdownTokenizer::tokenizeSetextHeadingLine1
@@ -234,6 +367,11 @@ bool MarkdownTokenizer::tokenizeSetextHeadingLine2
     bool setextMatch = false;
     Token token;
 
+    if (!(lineRules & BlockRuleSetextHeadingLine2))
+    {
+        return false;
+    }
+
     if (MarkdownStateSetextHeading1Line1 == previousState)
     {
         level = 1;
@@ -255,8 +393,6 @@ bool MarkdownTokenizer::tokenizeSetextHeadingLine2
 
         if (h1Line2 || h2Line2)
         {
-            // Restart tokenizing on the previous line.
-            this->requestBacktrack();
             token.setLength(text.length());
             token.setPosition(0);
 
@@ -287,8 +423,6 @@ bool MarkdownTokenizer::tokenizeSetextHeadingLine2
         }
         else
         {
-            // Restart tokenizing on the previous line.
-            this->requestBacktrack();
             return false;
         }
     }
@@ -298,22 +432,26 @@ bool MarkdownTokenizer::tokenizeSetextHeadingLine2
 
 bool MarkdownTokenizer::tokenizeAtxHeading(const QString& text)
 {
-    QString escapedText = dummyOutEscapeCharacters(text);
     int trailingPoundCount = 0;
 
     int level = 0;
 
+    if (!(lineRules & BlockRuleAtxHeading))
+    {
+        return false;
+    }
+
     // Count the number of pound signs at the front of the string,
     // up to the maximum allowed, to determine the heading level.
     //
     for
     (
         int i = 0;
-        ((i < escapedText.length()) && (i < MAX_MARKDOWN_HEADING_LEVEL));
+        ((i < text.length()) && (i < MAX_MARKDOWN_HEADING_LEVEL));
         i++
     )
     {
-        if (QChar('#') == escapedText[i])
+        if (QChar('#') == text[i])
         {
             level++;
         }
@@ -326,10 +464,10 @@ bool MarkdownTokenizer::tokenizeAtxHeading(const QString& text)
 
     if ((level > 0) && (level < text.length()))
     {
-        // Count how many pound signs are at the end of the text.
-        for (int i = escapedText.length() - 1; i > level; i--)
+        // Count how many unescaped pound signs are at the end of the text.
+        for (int i = text.length() - 1; i > level; i--)
         {
-            if (QChar('#') == escapedText[i])
+            if ((QChar('#') == text[i]) && !isEscaped(text, i))
             {
                 trailingPoundCount++;
             }
@@ -359,6 +497,11 @@ bool MarkdownTokenizer::tokenizeNumberedList
     const QString& text
 )
 {
+    if (!(lineRules & BlockRuleNumberedList))
+    {
+        return false;
+    }
+
     if
     (
         (
@@ -432,13 +575,17 @@ bool MarkdownTokenizer::tokenizeBulletPointList
 
     if 
     (
-        (MarkdownStateUnknown != previousState)
+        !(lineRules & BlockRuleBulletPointList)
+        || 
+        (
+            (MarkdownStateUnknown != previousState)
         && (MarkdownStateParagraphBreak != previousState)
         && (MarkdownStateListLineBreak != previousState)
         && (MarkdownStateNumberedList != previousState)
         && (MarkdownStateBulletPointList != previousState)
-        && (MarkdownStateCodeBlock != previousState)
-        && (MarkdownStateCodeFenceEnd != previousState)
+            && (MarkdownStateCodeBlock != previousState)
+            && (MarkdownStateCodeFenceEnd != previousState)
+        )
     )
     {
         return false;
@@ -545,7 +692,7 @@ bool MarkdownTokenizer::tokenizeBulletPointList
 
 bool MarkdownTokenizer::tokenizeHorizontalRule(const QString& text)
 {
-    if (hruleRegex.exactMatch(text))
+    if ((lineRules & BlockRuleHorizontalRule) && hruleRegex.exactMatch(text))
     {
         Token token;
         token.setType(TokenHorizontalRule);
@@ -567,7 +714,11 @@ bool MarkdownTokenizer::tokenizeBlockquote
     if 
     (
         (MarkdownStateBlockquote == previousState)
-        || blockquoteRegex.exactMatch(text)
+        ||
+        (
+            (lineRules & BlockRuleBlockquote)
+            && blockquoteRegex.exactMatch(text)
+        )
     )
     {
         // Find any '>' characters at the front of the line.
@@ -657,7 +808,7 @@ bool MarkdownTokenizer::tokenizeCodeBlock
             || (MarkdownStateParagraphBreak == previousState)
             || (MarkdownStateUnknown == previousState)
         )
-        && (text.startsWith("\t") || text.startsWith("    "))
+        && isIndented(text)
     )
     {
         Token token;
@@ -670,9 +821,13 @@ bool MarkdownTokenizer::tokenizeCodeBlock
     }
     else if
     (
-        (MarkdownStateParagraphBreak == previousState)
-        || (MarkdownStateParagraph == previousState)
-        || (MarkdownStateUnknown == previousState)           
+        (lineRules & BlockRuleCodeFence)
+        &&
+        (
+            (MarkdownStateParagraphBreak == previousState)
+            || (MarkdownStateParagraph == previousState)
+            || (MarkdownStateUnknown == previousState)
+        )
     )
     {
         bool foundCodeFenceStart = false;
@@ -711,7 +866,7 @@ bool MarkdownTokenizer::tokenizeMultilineComment
     if (MarkdownStateComment == previousState)
     {
         // Find the end of the comment, if any.
-        int index = text.indexOf("-->");
+        int index = text.indexOf(QLatin1String("-->"));
         Token token;
         token.setType(TokenHtmlComment);
         token.setPosition(0);
@@ -739,172 +894,190 @@ bool MarkdownTokenizer::tokenizeMultilineComment
     return false;
 }
 
-bool MarkdownTokenizer::tokenizeInline
-(
-    const QString& text
-)
+bool MarkdownTokenizer::tokenizeTableDivider(const QString& text)
 {
-    QString escapedText = dummyOutEscapeCharacters(text);
-
-    // Check if the line is a reference definition.
-    if (referenceDefinitionRegex.exactMatch(escapedText))
+    if (!(lineRules & BlockRuleTableDivider))
     {
-        int colonIndex = escapedText.indexOf(':');
-        Token token;
-        token.setType(TokenReferenceDefinition);
-        token.setPosition(0);
-        token.setLength(colonIndex + 1);
-        addToken(token);
-
-        // Replace the first bracket so that the '[...]:' reference definition
-        // start doesn't get highlighted as a reference link.
-        //
-        int firstBracketIndex = escapedText.indexOf(QChar('['));
-
-        if (firstBracketIndex >= 0)
-        {
-            escapedText[firstBracketIndex] = DUMMY_CHAR;
-        }
+        return false;
     }
 
-    tokenizeVerbatim(escapedText);
-    tokenizeHtmlComments(escapedText);
-    tokenizeTableHeaderRow(escapedText);
-    tokenizeTableRow(escapedText);
-    tokenizeMatches(TokenImage, escapedText, imageRegex, 0, 0, false, true);
-    tokenizeMatches(TokenInlineLink, escapedText, inlineLinkRegex, 0, 0, false, true);
-    tokenizeMatches(TokenReferenceLink, escapedText, referenceLinkRegex, 0, 0, false, true);
-    tokenizeMatches(TokenHtmlEntity, escapedText, htmlEntityRegex);
-    tokenizeMatches(TokenAutomaticLink, escapedText, automaticLinkRegex, 0, 0, false, true);
-    tokenizeMatches(TokenStrikethrough, escapedText, strikethroughRegex, 2, 2);
-    tokenizeMatches(TokenStrong, escapedText, strongRegex, 2, 2, true);
-    tokenizeMatches(TokenEmphasis, escapedText, emphasisRegex, 1, 1, true);
-    tokenizeMatches(TokenHtmlTag, escapedText, htmlTagRegex);
-    tokenizeMatches(TokenMention, escapedText, mentionRegex, 0, 0, false, true);
-
-    return true;
-}
-
-void MarkdownTokenizer::tokenizeVerbatim(QString& text)
-{
-    int index = verbatimRegex.indexIn(text);
-
-    while (index >= 0)
+    if (MarkdownStatePipeTableHeader == previousState)
     {
-        QString end = "";
-        int count = verbatimRegex.matchedLength();
-
-        // Search for the matching end, which should have the same number
-        // of back ticks as the start.
-        //
-        for (int i = 0; i < count; i++)
+        if (pipeTableDividerRegex.exactMatch(text))
         {
-            end += '`';
-        }
-
-        int endIndex = text.indexOf(end, index + count);
+            setState(MarkdownStatePipeTableDivider);
 
-        // If the end was found, add the verbatim token.
-        if (endIndex >= 0)
-        {
             Token token;
-
-            token.setType(TokenVerbatim);
-            token.setPosition(index);
-            token.setLength(endIndex + count - index);
-            token.setOpeningMarkupLength(count);
-            token.setClosingMarkupLength(count);
+            token.setType(TokenTableDivider);
+            token.setLength(text.length());
+            token.setPosition(0);
             this->addToken(token);
 
-            // Fill out the token match in the string with the dummy
-            // character so that searches for other Markdown elements
-            // don't find anything within this token's range in the string.
-            //
-            for (int i = index; i < (index + token.getLength()); i++)
-            {
-                text[i] = DUMMY_CHAR;
-            }
-
-            index += token.getLength();
+            return true;
         }
-        // Else start searching again at the very next character.
-        else
+    }
+    else if (MarkdownStateParagraph == previousState)
+    {
+        if (pipeTableDividerRegex.exactMatch(text))
         {
-            index++;
-        }
+            setState(MarkdownStatePipeTableDivider);
 
-        index = verbatimRegex.indexIn(text, index);
+            Token token;
+            token.setLength(text.length());
+            token.setPosition(0);
+            token.setType(TokenTableDivider);
+            this->addToken(token);
+            return true;
+        }
     }
+    return false;
 }
 
-void MarkdownTokenizer::tokenizeHtmlComments(QString& text)
+bool MarkdownTokenizer::tokenizeInline
+(
+    const QString& text
+)
 {
-    // Check for the end of a multiline comment so that it doesn't get further
-    // tokenized. Don't bother formatting the comment itself, however, because
-    // it should have already been tokenized in tokenizeMultilineComment().
+    int length = text.length();
+    int index = 0;
+
+    // If a multiline comment ends on this line, skip past the end of it.
+    // Don't bother formatting the comment itself, however, because it should
+    // have already been tokenized in tokenizeMultilineComment().
     //
     if (MarkdownStateComment == previousState)
     {
-        int commentEnd = text.indexOf("-->");
+        int commentEnd = text.indexOf(QLatin1String("-->"));
 
-        for (int i = 0; i < commentEnd + 3; i++)
+        if (commentEnd >= 0)
         {
-            text[i] = DUMMY_CHAR;
+            index = commentEnd + 3;
         }
     }
 
-    // Now check for inline comments (non-multiline).
-    int commentStart = text.indexOf(htmlInlineCommentRegex);
+    // Check if the line is a reference definition.
+    int firstNonSpace = 0;
 
-    while (commentStart >= 0)
+    while ((firstNonSpace < length) && text[firstNonSpace].isSpace())
     {
-        int commentLength = htmlInlineCommentRegex.matchedLength();
-        Token token;
+        firstNonSpace++;
+    }
 
-        token.setType(TokenHtmlComment);
-        token.setPosition(commentStart);
-        token.setLength(commentLength);
-        addToken(token);
+    if
+    (
+        (firstNonSpace < (length - 3))
+        && (QChar('[') == text[firstNonSpace])
+        && (QChar(']') == text[length - 2])
+        && (QChar(':') == text[length - 1])
+        && !isEscaped(text, length - 2)
+    )
+    {
+        addInlineToken
+        (
+            TokenReferenceDefinition,
+            0,
+            indexOfUnescaped(text, ":", 0) + 1
+        );
 
-        // Replace comment segment with dummy characters so that it doesn't
-        // get tokenized again.
+        // Skip the first bracket so that the '[...]:' reference definition
+        // start doesn't get highlighted as a reference link.
         //
-        for (int i = commentStart; i < (commentStart + commentLength); i++)
-        {
-            text[i] = DUMMY_CHAR;
-        }
-
-        commentStart = text.indexOf
-            (
-                htmlInlineCommentRegex,
-                commentStart + commentLength
-            );
+        index = qMax(index, firstNonSpace + 1);
     }
 
-    // Find multiline comment start, if any.
-    commentStart = text.indexOf("<!--");
+    TableRowType tableRow = tableRowType();
+    int cellStart = index;
 
-    if (commentStart >= 0)
+    QVarLengthArray<DelimiterRun, 32> delimiters;
+
+    while (index < length)
     {
-        Token token;
+        int end = -1;
 
-        token.setType(TokenHtmlComment);
-        token.setPosition(commentStart);
-        token.setLength(text.length() - commentStart);
-        addToken(token);
-        setState(MarkdownStateComment);
+        switch (text[index].unicode())
+        {
+            case '\\':
+                // Skip over the escaped character.
+                end = index + 2;
+                break;
+            case '`':
+                end = tokenizeVerbatim(text, index);
+                break;
+            case '<':
+                end = tokenizeHtmlComment(text, index);
 
-        // Replace comment segment with dummy characters so that it doesn't
-        // get tokenized again.
-        //
-        for (int i = commentStart; i < text.length(); i++)
+                if (end < 0)
+                {
+                    end = tokenizeAutomaticLink(text, index);
+                }
+
+                if (end < 0)
+                {
+                    end = tokenizeHtmlTag(text, index);
+                }
+                break;
+            case '!':
+                end = tokenizeImage(text, index);
+                break;
+            case '[':
+                end = tokenizeInlineLink(text, index);
+
+                if (end < 0)
+                {
+                    end = tokenizeReferenceLink(text, index);
+                }
+                break;
+            case '&':
+                end = tokenizeHtmlEntity(text, index);
+                break;
+            case '@':
+                end = tokenizeMention(text, index);
+                break;
+            case '*':
+            case '_':
+            case '~':
+                end = index + 1;
+
+                while ((end < length) && (text[end] == text[index]))
+                {
+                    end++;
+                }
+
+                tokenizeDelimiterRun(text, index, end, tableRow, delimiters);
+                break;
+            case '|':
+                if (TableRowNone != tableRow)
+                {
+                    if ((TableRowHeader == tableRow) && (index > cellStart))
+                    {
+                        addInlineToken(TokenTableHeader, cellStart, index);
+                    }
+
+                    addInlineToken(TokenTablePipe, index, index + 1);
+                    cellStart = index + 1;
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (end < 0)
         {
-            text[i] = DUMMY_CHAR;
+            end = index + 1;
         }
+
+        index = end;
     }
+
+    if ((TableRowHeader == tableRow) && (cellStart < length))
+    {
+        addInlineToken(TokenTableHeader, cellStart, length);
+    }
+
+    return true;
 }
 
-void MarkdownTokenizer::tokenizeTableHeaderRow(QString& text)
+MarkdownTokenizer::TableRowType MarkdownTokenizer::tableRowType()
 {
     if
     (
@@ -932,198 +1105,466 @@ void MarkdownTokenizer::tokenizeTableHeaderRow(QString& text)
     )
     {
         setState(MarkdownStatePipeTableHeader);
+        return TableRowHeader;
+    }
+    else if
+    (
+        (MarkdownStatePipeTableDivider == previousState) ||
+        (MarkdownStatePipeTableRow == previousState)
+    )
+    {
+        setState(MarkdownStatePipeTableRow);
+        return TableRowBody;
+    }
 
-        int headerStart = 0;
+    return TableRowNone;
+}
 
-        for (int i = 0; i < text.length(); i++)
+void MarkdownTokenizer::tokenizeDelimiterRun
+(
+    const QString& text,
+    int start,
+    int end,
+    TableRowType tableRow,
+    QVarLengthArray<DelimiterRun, 32>& delimiters
+)
+{
+    QChar marker = text[start];
+    int count = end - start;
+    int minimumCount = (QChar('~') == marker) ? 2 : 1;
+
+    // Table pipes are treated as whitespace so that, for example, emphasis
+    // cannot start at the end of one table cell.
+    //
+    bool canOpen =
+        (end < text.length())
+        && !text[end].isSpace()
+        && !((TableRowNone != tableRow) && (QChar('|') == text[end]));
+    bool canClose =
+        (start > 0)
+        && !text[start - 1].isSpace()
+        && !((TableRowNone != tableRow) && (QChar('|') == text[start - 1]));
+
+    if (canClose)
+    {
+        // Find the nearest opening run with the same marker.
+        int opener = -1;
+
+        for (int i = delimiters.size() - 1; i >= 0; i--)
         {
-            if (QChar('|') == text[i])
+            if (marker == delimiters[i].marker)
             {
-                // Replace pipe with space so that it doesn't get formatted
-                // again with, for example, strong or emphasis formatting.
-                // Note that we use a space rather than DUMMY_CHAR for this,
-                // to prevent formatting such as strong and emphasis from
-                // picking it up.
-                //
-                text[i] = ' ';
+                opener = i;
+                break;
+            }
+        }
+
+        if (opener >= 0)
+        {
+            // Discard any runs opened in between, since they can no longer
+            // be closed without overlapping this one.
+            //
+            delimiters.resize(opener + 1);
+            DelimiterRun& run = delimiters[opener];
 
-                Token token;
+            while ((count >= minimumCount) && (run.count >= minimumCount))
+            {
+                MarkdownTokenType type = TokenEmphasis;
+                int markupLength = 1;
 
-                if (i > 0)
+                if (QChar('~') == marker)
+                {
+                    type = TokenStrikethrough;
+                    markupLength = 2;
+                }
+                else if ((count >= 2) && (run.count >= 2))
                 {
-                    token.setType(TokenTableHeader);
-                    token.setPosition(headerStart);
-                    token.setLength(i - headerStart);
-                    addToken(token);
+                    type = TokenStrong;
+                    markupLength = 2;
                 }
 
-                token.setType(TokenTablePipe);
-                token.setPosition(i);
-                token.setLength(1);
-                addToken(token);
-                headerStart = i + 1;
+                // Pair the innermost markup characters first.
+                run.count -= markupLength;
+
+                addInlineToken
+                (
+                    type,
+                    run.position + run.count,
+                    start + markupLength,
+                    markupLength,
+                    markupLength
+                );
+
+                start += markupLength;
+                count -= markupLength;
             }
-        }
 
-        if (headerStart < text.length())
-        {
-            Token token;
-            token.setType(TokenTableHeader);
-            token.setPosition(headerStart);
-            token.setLength(text.length() - headerStart);
-            addToken(token);
+            if (run.count < minimumCount)
+            {
+                delimiters.resize(opener);
+            }
         }
     }
+
+    if (canOpen && (count >= minimumCount))
+    {
+        DelimiterRun run;
+        run.marker = marker;
+        run.position = start;
+        run.count = count;
+        delimiters.append(run);
+    }
 }
 
-bool MarkdownTokenizer::tokenizeTableDivider(const QString& text)
+int MarkdownTokenizer::tokenizeVerbatim(const QString& text, int index)
 {
-    if (MarkdownStatePipeTableHeader == previousState)
+    int count = 0;
+
+    while
+    (
+        ((index + count) < text.length())
+        && (QChar('`') == text[index + count])
+    )
     {
-        if (pipeTableDividerRegex.exactMatch(text))
-        {
-            setState(MarkdownStatePipeTableDivider);
+        count++;
+    }
 
-            Token token;
-            token.setType(TokenTableDivider);
-            token.setLength(text.length());
-            token.setPosition(0);
-            this->addToken(token);
+    // Search for the matching end, which should have the same number
+    // of back ticks as the start.
+    //
+    int matched = 0;
 
-            return true;
+    for (int i = index + count; i < text.length(); i++)
+    {
+        if (QChar('`') == text[i])
+        {
+            matched++;
+
+            if (count == matched)
+            {
+                addInlineToken(TokenVerbatim, index, i + 1, count, count);
+                return i + 1;
+            }
         }
         else
         {
-            // Restart tokenizing on the previous line.
-            this->requestBacktrack();
+            matched = 0;
+
+            if (QChar('\\') == text[i])
+            {
+                // Skip over the escaped character.
+                i++;
+            }
         }
     }
-    else if (MarkdownStateParagraph == previousState)
+
+    return -1;
+}
+
+int MarkdownTokenizer::tokenizeHtmlComment(const QString& text, int index)
+{
+    if (!text.midRef(index, 4).startsWith(QLatin1String("<!--")))
     {
-        if (pipeTableDividerRegex.exactMatch(text))
-        {
-            // Restart tokenizing on the previous line.
-            this->requestBacktrack();
+        return -1;
+    }
 
-            setState(MarkdownStatePipeTableDivider);
+    int commentEnd = indexOfUnescaped(text, "-->", index + 4);
 
-            Token token;
-            token.setLength(text.length());
-            token.setPosition(0);
-            token.setType(TokenTableDivider);
-            this->addToken(token);
-            return true;
-        }
+    if (commentEnd >= 0)
+    {
+        addInlineToken(TokenHtmlComment, index, commentEnd + 3);
+        return commentEnd + 3;
     }
-    return false;
+
+    // The comment spans multiple lines.
+    addInlineToken(TokenHtmlComment, index, text.length());
+    setState(MarkdownStateComment);
+    return text.length();
 }
 
-void MarkdownTokenizer::tokenizeTableRow(QString& text)
+int MarkdownTokenizer::tokenizeAutomaticLink(const QString& text, int index)
 {
-    if
-    (
-        (MarkdownStatePipeTableDivider == previousState) ||
-        (MarkdownStatePipeTableRow == previousState)
-    )
+    int schemeEnd = index + 1;
+
+    while ((schemeEnd < text.length()) && isAsciiLetter(text[schemeEnd]))
     {
-        setState(MarkdownStatePipeTableRow);
+        schemeEnd++;
+    }
 
-        for (int i = 0; i < text.length(); i++)
+    bool hasScheme =
+        (schemeEnd > (index + 1))
+        && (schemeEnd < text.length())
+        && (QChar(':') == text[schemeEnd]);
+    int at = -1;
+
+    // Find the closing bracket, and check whether the link is either a URL
+    // (as in <scheme:address>) or an email address (as in <user@address>).
+    //
+    for (int i = index + 1; i < text.length(); i++)
+    {
+        if (QChar('>') == text[i])
         {
-            if (QChar('|') == text[i])
+            if
+            (
+                (hasScheme && (i > (schemeEnd + 1)))
+                || ((at > (index + 1)) && (i > (at + 1)))
+            )
             {
-                // Replace pipe with space so that it doesn't get formatted
-                // again with, for example, strong or emphasis formatting.
-                // Note that we use a space rather than DUMMY_CHAR for this,
-                // to prevent formatting such as strong and emphasis from
-                // picking it up.
-                //
-                text[i] = ' ';
+                addInlineToken(TokenAutomaticLink, index, i + 1);
+                return i + 1;
+            }
 
-                Token token;
-                token.setType(TokenTablePipe);
-                token.setPosition(i);
-                token.setLength(1);
-                addToken(token);
+            return -1;
+        }
+        else if (QChar('<') == text[i])
+        {
+            return -1;
+        }
+        else if ((QChar('@') == text[i]) && (at < 0))
+        {
+            at = i;
+        }
+        else if (QChar('\\') == text[i])
+        {
+            // Skip over the escaped character.
+            i++;
+        }
+    }
+
+    return -1;
+}
+
+int MarkdownTokenizer::tokenizeHtmlTag(const QString& text, int index)
+{
+    for (int i = index + 1; i < text.length(); i++)
+    {
+        if (QChar('>') == text[i])
+        {
+            if (i > (index + 1))
+            {
+                addInlineToken(TokenHtmlTag, index, i + 1);
+                return i + 1;
             }
+
+            return -1;
+        }
+        else if (QChar('<') == text[i])
+        {
+            return -1;
+        }
+        else if (QChar('\\') == text[i])
+        {
+            // Skip over the escaped character.
+            i++;
         }
     }
+
+    return -1;
 }
 
-void MarkdownTokenizer::tokenizeMatches
-(
-    MarkdownTokenType tokenType,
-    QString& text,
-    QRegExp& regex,
-    const int markupStartCount,
-    const int markupEndCount,
-    const bool replaceMarkupChars,
-    const bool replaceAllChars
-)
+int MarkdownTokenizer::tokenizeImage(const QString& text, int index)
 {
-    int index = text.indexOf(regex);
+    if (((index + 1) >= text.length()) || (QChar('[') != text[index + 1]))
+    {
+        return -1;
+    }
+
+    int textEnd = indexOfUnescaped(text, "](", index + 2);
 
-    while (index >= 0)
+    if (textEnd < 0)
     {
-        int length = regex.matchedLength();
-        Token token;
+        return -1;
+    }
 
-        token.setType(tokenType);
-        token.setPosition(index);
-        token.setLength(length);
+    int urlEnd = indexOfUnescaped(text, ")", textEnd + 3);
 
-        if (markupStartCount > 0)
-        {
-            token.setOpeningMarkupLength(markupStartCount);
-        }
+    if (urlEnd < 0)
+    {
+        return -1;
+    }
+
+    addInlineToken(TokenImage, index, urlEnd + 1);
+    return urlEnd + 1;
+}
+
+int MarkdownTokenizer::tokenizeInlineLink(const QString& text, int index)
+{
+    int textEnd = indexOfUnescaped(text, "](", index + 2);
 
-        if (markupEndCount > 0)
+    if (textEnd < 0)
+    {
+        return -1;
+    }
+
+    int urlEnd = indexOfUnescaped(text, ")", textEnd + 3);
+
+    if (urlEnd < 0)
+    {
+        return -1;
+    }
+
+    addInlineToken(TokenInlineLink, index, urlEnd + 1);
+    return urlEnd + 1;
+}
+
+int MarkdownTokenizer::tokenizeReferenceLink(const QString& text, int index)
+{
+    int end = indexOfUnescaped(text, "]", index + 2);
+
+    if (end < 0)
+    {
+        return -1;
+    }
+
+    addInlineToken(TokenReferenceLink, index, end + 1);
+    return end + 1;
+}
+
+int MarkdownTokenizer::tokenizeHtmlEntity(const QString& text, int index)
+{
+    int i = index + 1;
+    int nameStart = i;
+
+    if ((i < text.length()) && (QChar('#') == text[i]))
+    {
+        // Numeric character reference, as in &#123; or &#x123;
+        i++;
+
+        if ((i < text.length()) && (QChar('x') == text[i]))
         {
-            token.setClosingMarkupLength(markupEndCount);
+            i++;
         }
 
-        if (replaceAllChars)
+        nameStart = i;
+
+        while ((i < text.length()) && isAsciiDigit(text[i]))
         {
-            for (int i = index; i < (index + length); i++)
-            {
-                text[i] = DUMMY_CHAR;
-            }
+            i++;
         }
-        else if (replaceMarkupChars)
+    }
+    else
+    {
+        // Named entity, as in &amp;
+        while ((i < text.length()) && isAsciiLetter(text[i]))
         {
-            for (int i = index; i < (index + markupStartCount); i++)
-            {
-                text[i] = DUMMY_CHAR;
-            }
-
-            for (int i = (index + length - markupEndCount); i < (index + length); i++)
-            {
-                text[i] = DUMMY_CHAR;
-            }
+            i++;
         }
+    }
 
-        addToken(token);
-        index = text.indexOf(regex, index + length);
+    if ((i > nameStart) && (i < text.length()) && (QChar(';') == text[i]))
+    {
+        addInlineToken(TokenHtmlEntity, index, i + 1);
+        return i + 1;
     }
+
+    return -1;
 }
 
-QString MarkdownTokenizer::dummyOutEscapeCharacters(const QString& text) const
+int MarkdownTokenizer::tokenizeMention(const QString& text, int index)
 {
-    bool escape = false;
-    QString escapedText = text;
+    // Mentions cannot start in the middle of a word.
+    if ((index > 0) && isWordChar(text[index - 1]))
+    {
+        return -1;
+    }
 
-    for (int i = 0; i < text.length(); i++)
+    int end = scanHyphenatedWord(text, index + 1);
+
+    if (end < 0)
+    {
+        return -1;
+    }
+
+    // Check for a team or repository name, as in @user/name.
+    if ((end < text.length()) && (QChar('/') == text[end]))
     {
-        if (escape)
+        int nameEnd = scanHyphenatedWord(text, end + 1);
+
+        if (nameEnd >= 0)
         {
-            escapedText[i] = DUMMY_CHAR; // Use a dummy character.
-            escape = false;
+            end = nameEnd;
         }
-        else if (QChar('\\') == text[i])
+    }
+
+    addInlineToken(TokenMention, index, end);
+    return end;
+}
+
+int MarkdownTokenizer::scanHyphenatedWord(const QString& text, int index) const
+{
+    int end = index;
+
+    while ((end < text.length()) && isWordChar(text[end]))
+    {
+        end++;
+    }
+
+    if (end == index)
+    {
+        return -1;
+    }
+
+    while
+    (
+        ((end + 1) < text.length())
+        && (QChar('-') == text[end])
+        && isWordChar(text[end + 1])
+    )
+    {
+        end += 2;
+
+        while ((end < text.length()) && isWordChar(text[end]))
         {
-            escape = true;
+            end++;
         }
     }
 
-    return escapedText;
+    return end;
+}
+
+void MarkdownTokenizer::addInlineToken
+(
+    MarkdownTokenType type,
+    int start,
+    int end,
+    int openingMarkupLength,
+    int closingMarkupLength
+)
+{
+    Token token;
+    token.setType(type);
+    token.setPosition(start);
+    token.setLength(end - start);
+    token.setOpeningMarkupLength(openingMarkupLength);
+    token.setClosingMarkupLength(closingMarkupLength);
+    addToken(token);
+}
+
+int MarkdownTokenizer::indexOfUnescaped
+(
+    const QString& text,
+    const char* str,
+    int from
+) const
+{
+    int index = text.indexOf(QLatin1String(str), from);
+
+    while ((index >= 0) && isEscaped(text, index))
+    {
+        index = text.indexOf(QLatin1String(str), index + 1);
+    }
+
+    return index;
+}
+
+bool MarkdownTokenizer::isEscaped(const QString& text, int index) const
+{
+    int backslashCount = 0;
+
+    for (int i = index - 1; (i >= 0) && (QChar('\\') == text[i]); i--)
+    {
+        backslashCount++;
+    }
+
+    return (backslashCount % 2) != 0;
 }
@@ -21,6 +21,9 @@
 #ifndef MARKDOWNTOKENIZER_H
 #define MARKDOWNTOKENIZER_H
 
+#include <QChar>
+#include <QVarLengthArray>
+
 #include "HighlightTokenizer.h"
 
 class QRegExp;
@@ -84,12 +87,25 @@ class MarkdownTokenizer : public HighlightTokenizer
             int nextState
         );
 
+        /**
+         * Returns MarkdownStateSetextHeading1Line2,
+         * MarkdownStateSetextHeading2Line2, or MarkdownStatePipeTableDivider
+         * if the given line could be the second line of a setext heading or a
+         * pipe table divider, respectively, which would change how the line
+         * preceding it is tokenized.  Returns MarkdownStateUnknown otherwise.
+         */
+        int lookAhead(const QString& text) const;
+
     private:
         int currentState;
         int previousState;
         int nextState;
 
-        QRegExp paragraphBreakRegex;
+        // Flags for the block-level rules that the line being tokenized
+        // could possibly match, so that the rest need not be tried.
+        //
+        unsigned int lineRules;
+
         QRegExp heading1SetextRegex;
         QRegExp heading2SetextRegex;
         QRegExp blockquoteRegex;
@@ -100,21 +116,29 @@ class MarkdownTokenizer : public HighlightTokenizer
         QRegExp numberedListRegex;
         QRegExp numberedNestedListRegex;
         QRegExp hruleRegex;
-        QRegExp emphasisRegex;
-        QRegExp strongRegex;
-        QRegExp strikethroughRegex;
-        QRegExp verbatimRegex;
-        QRegExp htmlTagRegex;
-        QRegExp htmlEntityRegex;
-        QRegExp automaticLinkRegex;
-        QRegExp inlineLinkRegex;
-        QRegExp referenceLinkRegex;
-        QRegExp referenceDefinitionRegex;
-        QRegExp imageRegex;
-        QRegExp htmlInlineCommentRegex;
-        QRegExp mentionRegex;
         QRegExp pipeTableDividerRegex;
 
+        /*
+         * Whether and how pipe characters are being tokenized for the line
+         * currently being passed through tokenizeInline().
+         */
+        enum TableRowType
+        {
+            TableRowNone,
+            TableRowHeader,
+            TableRowBody
+        };
+
+        /*
+         * An unmatched run of emphasis, strong, or strikethrough markup
+         * characters that may still be closed later in the line.
+         */
+        struct DelimiterRun
+        {
+            QChar marker;
+            int position;
+            int count;
+        };
 
         bool tokenizeSetextHeadingLine1(const QString& text);
         bool tokenizeSetextHeadingLine2(const QString& text);
@@ -126,52 +150,93 @@ class MarkdownTokenizer : public HighlightTokenizer
         bool tokenizeBlockquote(const QString& text);
         bool tokenizeCodeBlock(const QString& text);
         bool tokenizeMultilineComment(const QString& text);
-        
-        bool tokenizeInline(const QString& text);
-        void tokenizeVerbatim(QString& text);
-        void tokenizeHtmlComments(QString& text);
-        void tokenizeTableHeaderRow(QString& text);
         bool tokenizeTableDivider(const QString& text);
-        void tokenizeTableRow(QString& text);
 
         /*
-         * Tokenizes a block of text, searching for all occurrances of regex.
-         * Occurrances are set to the given token type and added to the list of
-         * tokens.  The markupStartCount and markupEndCount values are used to
-         * indicate how many markup special characters preceed and follow the
-         * main text, respectively.
-         *
-         * For example, if the matched string is "**bold**", and 
-         * markupStartCount = 2 and markupEndCount = 2, then the asterisks
-         * preceeding and following the word "bold" will be set as opening and
-         * closing markup in the token.
-         *
-         * If replaceMarkupChars is true, then the markupStartCount and
-         * markupEndCount characters will be replaced with a dummy character in
-         * the text QString so that subsequent parsings of the same line do not
-         * pick up the original characters.
-         *
-         * If replaceAllChars is true instead, then the entire matched text will
-         * be replaced with dummy characters--again, for ease in parsing the
-         * same line for other regular expression matches.
+         * Tokenizes the inline elements of the line in a single left-to-right
+         * pass.  Code spans, HTML comments, links, images, automatic links,
+         * HTML tags, entities and mentions are matched as soon as their
+         * opening character is encountered, and their text is skipped over
+         * entirely, so that no other inline element can be found within them.
+         * Emphasis, strong and strikethrough markup runs are paired up using a
+         * delimiter stack, allowing them to nest within each other.
+         */
+        bool tokenizeInline(const QString& text);
+
+        /*
+         * Determines whether the current line is a pipe table header or
+         * body row, updating the line state accordingly.
+         */
+        TableRowType tableRowType();
+
+        /*
+         * Pairs the run of emphasis, strong or strikethrough markup characters
+         * in the range [start, end) with any matching opening run on the
+         * delimiter stack, adding a token for each pair found.  Any leftover
+         * characters in the run that could open a new span are pushed onto
+         * the stack.
          */
-        void tokenizeMatches
+        void tokenizeDelimiterRun
         (
-            MarkdownTokenType tokenType,
-            QString& text,
-            QRegExp& regex,
-            const int markupStartCount = 0,
-            const int markupEndCount = 0,
-            const bool replaceMarkupChars = false,
-            const bool replaceAllChars = false
+            const QString& text,
+            int start,
+            int end,
+            TableRowType tableRow,
+            QVarLengthArray<DelimiterRun, 32>& delimiters
         );
 
         /*
-         * Replaces escaped characters in text so they aren't picked up
-         * during parsing.  Returns a copy of the input text string
-         * with the escaped characters replaced with a dummy character.
+         * The following methods attempt to match an inline element starting
+         * at the given index in the text, adding a token for it if found.
+         * Each returns the index just past the end of the match, or -1 if the
+         * element could not be matched.
+         */
+        int tokenizeVerbatim(const QString& text, int index);
+        int tokenizeHtmlComment(const QString& text, int index);
+        int tokenizeAutomaticLink(const QString& text, int index);
+        int tokenizeHtmlTag(const QString& text, int index);
+        int tokenizeImage(const QString& text, int index);
+        int tokenizeInlineLink(const QString& text, int index);
+        int tokenizeReferenceLink(const QString& text, int index);
+        int tokenizeHtmlEntity(const QString& text, int index);
+        int tokenizeMention(const QString& text, int index);
+
+        /*
+         * Scans a word that may contain hyphens (i.e., "word-word-word")
+         * starting at the given index.  Returns the index just past the end
+         * of the word, or -1 if there is no word at the index.
+         */
+        int scanHyphenatedWord(const QString& text, int index) const;
+
+        /*
+         * Adds a token of the given type spanning the range [start, end).
+         */
+        void addInlineToken
+        (
+            MarkdownTokenType type,
+            int start,
+            int end,
+            int openingMarkupLength = 0,
+            int closingMarkupLength = 0
+        );
+
+        /*
+         * Searches for the given string within the text, starting at the
+         * from index, and skipping over backslash-escaped characters.
+         * Returns the index of the match, or -1 if no match is found.
+         */
+        int indexOfUnescaped
+        (
+            const QString& text,
+            const char* str,
+            int from
+        ) const;
+
+        /*
+         * Returns true if the character at the given index in the text is
+         * escaped with a backslash.
          */
-        QString dummyOutEscapeCharacters(const QString& text) const;
+        bool isEscaped(const QString& text, int index) const;
 
 };
 
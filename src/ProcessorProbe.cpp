@@ -0,0 +1,172 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QProcess>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStringList>
+
+#include "ProcessorProbe.h"
+
+const int ProcessorProbe::TIMEOUT;
+
+ProcessorProbe::ProcessorProbe()
+    : available(false), cached(false), finished(false)
+{
+    ;
+}
+
+ProcessorProbe::ProcessorProbe(const QString& name, const QString& command)
+    : name(name), command(command), available(false), cached(false),
+        finished(false)
+{
+    ;
+}
+
+ProcessorProbe::~ProcessorProbe()
+{
+    ;
+}
+
+ProcessorProbe ProcessorProbe::run(const ProcessorProbe& probe)
+{
+    ProcessorProbe result = probe;
+    QString signature = executableSignature(probe.name);
+
+    if (!probe.signature.isEmpty() && (signature == probe.signature))
+    {
+        result.cached = true;
+        return result;
+    }
+
+    // Note that the processor may still be found by the system even if it
+    // isn't found in the PATH, so it is run either way.
+    //
+    QProcess process;
+
+    result.signature = signature;
+    result.available = false;
+    result.output = QString();
+    result.cached = false;
+    result.finished = false;
+
+    process.start(probe.command);
+
+    if (!process.waitForStarted(TIMEOUT))
+    {
+        // A processor that couldn't be started is missing, whereas one
+        // that was merely slow to start may be found next time.
+        //
+        result.finished = (QProcess::FailedToStart == process.error());
+        return result;
+    }
+
+    result.available = true;
+
+    if (process.waitForFinished(TIMEOUT))
+    {
+        result.finished = true;
+    }
+    else
+    {
+        process.kill();
+        process.waitForFinished();
+    }
+
+    result.output = QString::fromUtf8(process.readAllStandardOutput().data());
+    return result;
+}
+
+void ProcessorProbe::load(QSettings& settings)
+{
+    signature = settings.value(name + "/signature").toString();
+    available = settings.value(name + "/available", false).toBool();
+    output = settings.value(name + "/output").toString();
+    cached = false;
+    finished = false;
+}
+
+bool ProcessorProbe::save(QSettings& settings) const
+{
+    if (cached || !finished)
+    {
+        return false;
+    }
+
+    settings.setValue(name + "/signature", signature);
+    settings.setValue(name + "/available", available);
+    settings.setValue(name + "/output", output);
+    return true;
+}
+
+QString ProcessorProbe::findExecutable(const QString& name)
+{
+#ifdef Q_OS_WIN
+    QStringList suffixes = QStringList() << ".exe" << ".bat" << ".cmd" << "";
+    QChar separator(';');
+#else
+    QStringList suffixes = QStringList() << "";
+    QChar separator(':');
+#endif
+
+    QStringList directories =
+        QString::fromLocal8Bit(qgetenv("PATH").constData()).split(separator);
+
+    foreach (const QString& directory, directories)
+    {
+        // Empty entries are skipped here rather than by split(), whose
+        // flag for doing so changed type in Qt 5.14.
+        //
+        if (directory.isEmpty())
+        {
+            continue;
+        }
+
+        foreach (const QString& suffix, suffixes)
+        {
+            QFileInfo info(QDir(directory), name + suffix);
+
+            if (info.isFile() && info.isExecutable())
+            {
+                return info.absoluteFilePath();
+            }
+        }
+    }
+
+    return QString();
+}
+
+QString ProcessorProbe::executableSignature(const QString& name)
+{
+    QString path = findExecutable(name);
+    QString signature =
+        QString::fromLocal8Bit(qgetenv("PATH").constData()) + '\n' + path;
+
+    if (!path.isNull())
+    {
+        QFileInfo info(path);
+
+        signature += QString("\n%1\n%2")
+            .arg(info.lastModified().toMSecsSinceEpoch())
+            .arg(info.size());
+    }
+
+    return signature;
+}
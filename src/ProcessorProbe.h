@@ -0,0 +1,113 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef PROCESSORPROBE_H
+#define PROCESSORPROBE_H
+
+#include <QString>
+#include <QSettings>
+
+/**
+ * The check for whether a Markdown processor is installed, made by running
+ * the processor with a command that prints its version.  The result is
+ * cached between runs of the application, and is used for as long as the
+ * signature of the processor's executable (see executableSignature()) stays
+ * the same.
+ */
+class ProcessorProbe
+{
+    public:
+        /**
+         * Maximum time in milliseconds to wait for a processor to start,
+         * and then to answer its probe.  Since the processors are probed in
+         * the background, this can be generous.
+         */
+        static const int TIMEOUT = 5000;
+
+        /**
+         * Constructor.
+         */
+        ProcessorProbe();
+
+        /**
+         * Constructor that initializes this probe with the name of the
+         * processor's executable and the command that prints its version.
+         */
+        ProcessorProbe(const QString& name, const QString& command);
+
+        /**
+         * Destructor.
+         */
+        ~ProcessorProbe();
+
+        /**
+         * Returns a copy of the given probe, which is run if its cached
+         * result is out of date.  This method may be called from any thread.
+         */
+        static ProcessorProbe run(const ProcessorProbe& probe);
+
+        /**
+         * Reads the cached result of this probe from the given settings, in
+         * the current group.
+         */
+        void load(QSettings& settings);
+
+        /**
+         * Writes the result of this probe to the given settings, in the
+         * current group, if it is worth remembering.  Only the results of
+         * probes that were run to the end are remembered, so that a
+         * processor that was slow to answer, such as while the system was
+         * busy at login, is probed again next time rather than being taken
+         * for missing, or having its version output cut short, until it
+         * changes.  A processor that couldn't be started at all is
+         * remembered as missing.  Returns true if the result was written.
+         */
+        bool save(QSettings& settings) const;
+
+        /**
+         * Returns the path of the given executable found in the PATH
+         * environment variable, or a null QString if it isn't found.
+         */
+        static QString findExecutable(const QString& name);
+
+        /**
+         * Returns a string identifying the given executable's location in
+         * the PATH environment variable and its version on disk, made up of
+         * the PATH, and the executable's path, modification time and size.
+         */
+        static QString executableSignature(const QString& name);
+
+        QString name;
+        QString command;
+        QString signature;
+        bool available;
+        QString output;
+
+        // Whether the cached result was used, rather than running the
+        // processor.
+        //
+        bool cached;
+
+        // Whether the probe ran to the end, rather than timing out,
+        // so that its result can be remembered.
+        //
+        bool finished;
+};
+
+#endif // PROCESSORPROBE_H
@@ -0,0 +1,424 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileInfoList>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QStringList>
+#include <QUrl>
+
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+#include "RenderCache.h"
+#include "Exporter.h"
+#include "ExportFormat.h"
+
+// Maximum size in bytes of the HTML kept in memory.
+#define GW_RENDER_CACHE_HTML_SIZE (32 * 1024 * 1024)
+
+// Maximum size in bytes of the exported files stored on disk.
+#define GW_RENDER_CACHE_STORE_SIZE (256 * 1024 * 1024)
+
+// Age in seconds after which a temporary copy of a file being stored is
+// taken to have been left behind.
+//
+#define GW_RENDER_CACHE_STALE_TEMP_FILE_AGE (24 * 60 * 60)
+
+RenderCache* RenderCache::instance = NULL;
+
+// Guards the creation of the instance, which may first be needed on a
+// worker thread.
+//
+static QMutex instanceMutex;
+
+RenderCache* RenderCache::getInstance()
+{
+    QMutexLocker locker(&instanceMutex);
+
+    if (NULL == instance)
+    {
+        instance = new RenderCache();
+    }
+
+    return instance;
+}
+
+RenderCache::~RenderCache()
+{
+    ;
+}
+
+QByteArray RenderCache::computeKey
+(
+    Exporter* exporter,
+    const ExportFormat* format,
+    const ExportOptions& options,
+    const QString& variant,
+    const QByteArray& text
+)
+{
+#if QT_VERSION >= 0x050000
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+#else
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+#endif
+
+    QString formatName("preview");
+
+    if (NULL != format)
+    {
+        formatName = format->getName();
+    }
+
+    // Headings without anchors are told apart from anchors without a
+    // prefix.
+    //
+    QString anchors("noanchors");
+
+    if (!options.headingAnchorPrefix.isNull())
+    {
+        anchors = QString("anchors ") + options.headingAnchorPrefix;
+    }
+
+    // Separate the fields with null characters, which none of them has,
+    // so that different fields can't run together into the same key.
+    //
+    QStringList fields;
+    fields << exporter->getName()
+        << exporter->getCommand(format, options)
+        << (options.smartTypographyEnabled ? "smart" : "plain")
+        << anchors
+        << (options.sourceLinesEnabled ? "lines" : "nolines")
+        << formatName
+        << variant;
+
+    hash.addData(fields.join(QString(QChar(0))).toUtf8());
+    hash.addData(QByteArray(1, '\0'));
+    hash.addData(text);
+
+    return hash.result().toHex();
+}
+
+QString RenderCache::describeReferencedFiles
+(
+    const QByteArray& text,
+    const QString& inputFilePath
+)
+{
+    QDir baseDir = QDir::current();
+
+    if (!inputFilePath.isEmpty())
+    {
+        baseDir = QFileInfo(inputFilePath).dir();
+    }
+
+    QStringList lines = QString::fromUtf8(text.constData(), text.size()).split('\n');
+    QStringList paths;
+    QRegExp inlineLinkExp("\\]\\(\\s*<?([^)\\s>]+)");
+    QRegExp referenceExp("^\\s{0,3}\\[[^\\]]+\\]:\\s*<?([^\\s>]+)");
+    QRegExp attributeExp("(src|href|data)\\s*=\\s*[\"']([^\"']+)[\"']", Qt::CaseInsensitive);
+    QRegExp metadataExp("^\\s*(-|[\\w-]+\\s*:)\\s*(\\S.*)$");
+    bool inMetadata = false;
+
+    for (int i = 0; i < lines.size(); i++)
+    {
+        const QString& line = lines.at(i);
+        int pos = 0;
+
+        // Take every value of a YAML metadata block as a path, since
+        // processors may read any of them, such as a bibliography.
+        //
+        if (line.trimmed() == "---")
+        {
+            inMetadata = !inMetadata;
+            continue;
+        }
+        else if (inMetadata && (line.trimmed() == "..."))
+        {
+            inMetadata = false;
+            continue;
+        }
+
+        if (inMetadata && (metadataExp.indexIn(line) >= 0))
+        {
+            // Values may be quoted, or be lists such as [refs.bib, more.bib].
+            QString value = metadataExp.cap(2);
+
+            value.remove('[').remove(']').remove('"').remove('\'');
+
+            foreach (QString item, value.split(','))
+            {
+                paths << item.trimmed();
+            }
+        }
+
+        while ((pos = inlineLinkExp.indexIn(line, pos)) >= 0)
+        {
+            paths << inlineLinkExp.cap(1);
+            pos += inlineLinkExp.matchedLength();
+        }
+
+        if (referenceExp.indexIn(line) >= 0)
+        {
+            paths << referenceExp.cap(1);
+        }
+
+        pos = 0;
+
+        while ((pos = attributeExp.indexIn(line, pos)) >= 0)
+        {
+            paths << attributeExp.cap(2);
+            pos += attributeExp.matchedLength();
+        }
+    }
+
+    QRegExp schemeExp("^[a-zA-Z][a-zA-Z0-9+.-]+:");
+    QStringList files;
+
+    foreach (QString path, paths)
+    {
+        // Leave out URLs, though not Windows paths having a drive letter.
+        if (schemeExp.indexIn(path) >= 0)
+        {
+            continue;
+        }
+
+        path = path.section('#', 0, 0).section('?', 0, 0);
+        path = QUrl::fromPercentEncoding(path.toUtf8());
+
+        if (path.isEmpty())
+        {
+            continue;
+        }
+
+        QFileInfo fileInfo(baseDir, path);
+
+        if (fileInfo.isFile())
+        {
+            files << QString("%1 %2 %3")
+                .arg(fileInfo.absoluteFilePath())
+                .arg(fileInfo.lastModified().toMSecsSinceEpoch())
+                .arg(fileInfo.size());
+        }
+    }
+
+    files.removeDuplicates();
+    files.sort();
+
+    return files.join("\n");
+}
+
+bool RenderCache::findHtml(const QByteArray& key, QString& html)
+{
+    QMutexLocker locker(&mutex);
+    QString* cachedHtml = htmlCache.object(key);
+
+    if (NULL == cachedHtml)
+    {
+        return false;
+    }
+
+    html = *cachedHtml;
+    return true;
+}
+
+void RenderCache::insertHtml(const QByteArray& key, const QString& html)
+{
+    QMutexLocker locker(&mutex);
+
+    // HTML larger than the whole cache is dropped by QCache.
+    htmlCache.insert(key, new QString(html), html.size() * sizeof(QChar));
+}
+
+bool RenderCache::containsFile(const QByteArray& key) const
+{
+    return !storeDirPath.isEmpty() && QFile::exists(storeFilePath(key));
+}
+
+bool RenderCache::copyFile(const QByteArray& key, const QString& outputFilePath)
+{
+    QString filePath = storeFilePath(key);
+
+    if (storeDirPath.isEmpty())
+    {
+        return false;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+
+        if (!QFile::exists(filePath))
+        {
+            return false;
+        }
+
+        // Mark the file as recently used before copying it, so that it's
+        // evicted last, rather than while it's being copied.
+        //
+        QFile storedFile(filePath);
+
+        if (storedFile.open(QIODevice::ReadWrite))
+        {
+#if QT_VERSION >= 0x050A00
+            storedFile.setFileTime
+            (
+                QDateTime::currentDateTime(),
+                QFileDevice::FileModificationTime
+            );
+#else
+            // Older versions of Qt can't set the modification time, so
+            // write the file's first byte back in place, which updates it
+            // on every platform.
+            //
+            char firstByte;
+
+            if (storedFile.getChar(&firstByte) && storedFile.seek(0))
+            {
+                storedFile.putChar(firstByte);
+            }
+#endif
+        }
+    }
+
+    if (QFile::exists(outputFilePath) && !QFile::remove(outputFilePath))
+    {
+        return false;
+    }
+
+    return QFile::copy(filePath, outputFilePath);
+}
+
+void RenderCache::storeFile(const QByteArray& key, const QString& filePath)
+{
+    if (storeDirPath.isEmpty())
+    {
+        return;
+    }
+
+    QString storedFilePath = storeFilePath(key);
+
+    if (QFile::exists(storedFilePath))
+    {
+        return;
+    }
+
+    // Copy the file under a temporary name of its own, then rename it, so
+    // that neither another instance of the application nor another copy of
+    // the same file being stored at the same time ever finds a partial copy.
+    //
+    QString tempFilePath = QString("%1.%2.%3.tmp")
+        .arg(storedFilePath)
+        .arg(QCoreApplication::applicationPid())
+        .arg(tempFileCount.fetchAndAddOrdered(1));
+
+    if (!QFile::copy(filePath, tempFilePath))
+    {
+        QFile::remove(tempFilePath);
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+
+    if (!QFile::rename(tempFilePath, storedFilePath))
+    {
+        QFile::remove(tempFilePath);
+        return;
+    }
+
+    evictFiles();
+}
+
+RenderCache::RenderCache()
+    : tempFileCount(0)
+{
+    htmlCache.setMaxCost(GW_RENDER_CACHE_HTML_SIZE);
+
+#if QT_VERSION >= 0x050000
+    QString cacheDirPath =
+        QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString cacheDirPath =
+        QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+
+    // Without a cache directory, exported files simply aren't stored.
+    if (!cacheDirPath.isEmpty())
+    {
+        QDir cacheDir(cacheDirPath);
+
+        if (cacheDir.mkpath("renders"))
+        {
+            storeDirPath = cacheDir.filePath("renders");
+        }
+    }
+}
+
+QString RenderCache::storeFilePath(const QByteArray& key) const
+{
+    return storeDirPath + "/" + QString::fromLatin1(key.constData(), key.size());
+}
+
+void RenderCache::evictFiles()
+{
+    QDir storeDir(storeDirPath);
+    QFileInfoList files =
+        storeDir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot, QDir::Time);
+    qint64 totalSize = 0;
+
+    // The files are sorted from the most recently used to the least.
+    for (int i = 0; i < files.size(); i++)
+    {
+        const QFileInfo& fileInfo = files.at(i);
+
+        // Leave out the temporary copies of files being stored, which
+        // another thread or instance of the application is still writing,
+        // unless they were left behind long ago by one that quit.
+        //
+        if (fileInfo.fileName().endsWith(".tmp"))
+        {
+            if
+            (
+                fileInfo.lastModified().secsTo(QDateTime::currentDateTime())
+                > GW_RENDER_CACHE_STALE_TEMP_FILE_AGE
+            )
+            {
+                QFile::remove(fileInfo.filePath());
+            }
+
+            continue;
+        }
+
+        totalSize += fileInfo.size();
+
+        if (totalSize > GW_RENDER_CACHE_STORE_SIZE)
+        {
+            QFile::remove(fileInfo.filePath());
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+#include <QAtomicInt>
+
+class Exporter;
+class ExportFormat;
+struct ExportOptions;
+
+/**
+ * Caches the output of exporters, so that output for text that has already
+ * been rendered the same way, such as when switching the Live HTML Preview
+ * back to a previous exporter or exporting the same document twice, need
+ * not be rendered again.  Output is looked up by a key computed from the
+ * text and from everything about the exporter that affects its output.
+ * HTML for the Live HTML Preview is kept in memory, whereas exported files
+ * are kept on disk, in the application's cache directory.  In both cases,
+ * the output used least recently is evicted once the cache is full.  The
+ * methods of this class can be called from any thread.
+ */
+class RenderCache
+{
+    public:
+        /**
+         * Gets the singleton instance of this class.
+         */
+        static RenderCache* getInstance();
+
+        /**
+         * Destructor.
+         */
+        ~RenderCache();
+
+        /**
+         * Computes the key for the output of the given exporter for the
+         * given UTF-8 encoded text in the given format with the given
+         * options, or in HTML for the Live HTML Preview if format is NULL.
+         * The key is made up of the exporter's name, its command line (see
+         * Exporter::getCommand()), the options, the format, a strong hash of
+         * the text, and the given variant, which is for anything else that
+         * affects the output, such as the directory against which relative
+         * paths in the text are resolved.
+         */
+        static QByteArray computeKey
+        (
+            Exporter* exporter,
+            const ExportFormat* format,
+            const ExportOptions& options,
+            const QString& variant,
+            const QByteArray& text
+        );
+
+        /**
+         * Describes the local files to which the given UTF-8 encoded text
+         * refers, such as images, bibliographies and style sheets named in
+         * links, HTML attributes or a YAML metadata block, along with their
+         * modification times and sizes, resolving relative paths against the
+         * directory of the given input file path (or the current directory
+         * if it is empty).  Processors may embed these files in their
+         * output, so the description is added to the variant of the keys of
+         * exported files, so that exports are redone once one of the files
+         * has changed.
+         */
+        static QString describeReferencedFiles
+        (
+            const QByteArray& text,
+            const QString& inputFilePath
+        );
+
+        /**
+         * Looks up the HTML having the given key.  Returns true and sets
+         * the html parameter if it was found.
+         */
+        bool findHtml(const QByteArray& key, QString& html);
+
+        /**
+         * Adds the given HTML under the given key.
+         */
+        void insertHtml(const QByteArray& key, const QString& html);
+
+        /**
+         * Returns true if a file having the given key is stored on disk.
+         */
+        bool containsFile(const QByteArray& key) const;
+
+        /**
+         * Copies the file stored under the given key to the given output
+         * file path, replacing any file already there.  Returns false if
+         * there is no such file, or if it could not be copied.  Since large
+         * files take a while to copy, call this method on a worker thread.
+         */
+        bool copyFile(const QByteArray& key, const QString& outputFilePath);
+
+        /**
+         * Stores a copy of the file at the given path under the given key,
+         * evicting the files used least recently if the store is full.
+         * Since large files take a while to copy, call this method on a
+         * worker thread.
+         */
+        void storeFile(const QByteArray& key, const QString& filePath);
+
+    private:
+        static RenderCache* instance;
+
+        // Guards the HTML cache and the bookkeeping of the store, though
+        // not the copying of files in and out of the store.
+        //
+        QMutex mutex;
+        QAtomicInt tempFileCount;
+        QCache<QByteArray, QString> htmlCache;
+        QString storeDirPath;
+
+        RenderCache();
+
+        /*
+         * Gets the path of the file stored under the given key.
+         */
+        QString storeFilePath(const QByteArray& key) const;
+
+        /*
+         * Deletes the files used least recently until the store is within
+         * its size limit, along with temporary copies of stored files that
+         * were left behind long ago.
+         */
+        void evictFiles();
+};
+
+#endif // RENDERCACHE_H
@@ -24,7 +24,13 @@
 #include <QObject>
 #include <QFile>
 #include <QFileInfo>
+#include <QTextCodec>
+#include <QTextDecoder>
 #include <QTextStream>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVector>
+#include <QtConcurrentMap>
 
 #include "SundownExporter.h"
 
@@ -32,26 +38,165 @@
 #include "sundown/html.h"
 #include "sundown/buffer.h"
 
+// Size of each page of the chunked buffer into which HTML is rendered.
+#define GW_SUNDOWN_OUTPUT_PAGE_SIZE (64 * 1024)
 
-SundownExporter::SundownExporter() : Exporter("Sundown")
+// Maximum number of output pages kept between renders for reuse.
+#define GW_SUNDOWN_RETAINED_OUTPUT_PAGES 256
+
+// Size of a document (in bytes of UTF-8) from which it is split into parts
+// that are rendered concurrently.
+#define GW_SUNDOWN_PARALLEL_THRESHOLD (256 * 1024)
+
+// Minimum size of each part of a document rendered concurrently.
+#define GW_SUNDOWN_MIN_PART_SIZE (32 * 1024)
+
+// Number of parts per core into which a document rendered concurrently is
+// split, so that the cores are kept busy even if some parts are slower to
+// render than others.
+#define GW_SUNDOWN_PARTS_PER_THREAD 4
+
+// Byte written in place of each heading number in the anchor ids of a part
+// of a document rendered concurrently, which never occurs in UTF-8.
+#define GW_SUNDOWN_ANCHOR_NUMBER_PLACEHOLDER '\xff'
+
+/*
+ * Sundown HTML render options extended with the state needed to give
+ * headings anchor ids.  The
+ * default HTML render callbacks are passed a pointer to this structure in
+ * place of the html_renderopt structure, which is therefore its first
+ * member.
+ */
+struct exporter_renderopt
 {
-    supportedFormats.append(ExportFormat::HTML);
-}
+    struct html_renderopt html;
+    const char* anchor_prefix;
+    int header_count;
+    bool anchor_number_placeholders;
+};
 
-SundownExporter::~SundownExporter()
+/*
+ * Sundown header render callback that gives each heading an anchor id made
+ * up of the anchor prefix and the heading's sequence number, if there is
+ * an anchor prefix, along with its source line if source lines are enabled.
+ */
+static void rndr_anchored_header
+(
+    struct buf* ob,
+    const struct buf* text,
+    int level,
+    void* opaque
+)
 {
+    struct exporter_renderopt* options =
+        (struct exporter_renderopt*) opaque;
+
+    if (ob->size)
+    {
+        bufputc(ob, '\n');
+    }
+
+    bufprintf(ob, "<h%d", level);
+    sdhtml_source_line(ob, &options->html);
+
+    if (NULL != options->anchor_prefix)
+    {
+        ++options->header_count;
+
+        // When the document is being rendered in parts, leave the heading
+        // number for later, since the headings in the parts before this
+        // one have yet to be counted.  (The heading may be nested in a
+        // list or blockquote, so its position in the output isn't known
+        // yet either.)
+        //
+        if (options->anchor_number_placeholders)
+        {
+            bufprintf
+            (
+                ob,
+                " id=\"%s%c\">",
+                options->anchor_prefix,
+                GW_SUNDOWN_ANCHOR_NUMBER_PLACEHOLDER
+            );
+        }
+        else
+        {
+            bufprintf
+            (
+                ob,
+                " id=\"%s%d\">",
+                options->anchor_prefix,
+                options->header_count
+            );
+        }
+    }
+    else
+    {
+        bufputc(ob, '>');
+    }
+
+    if (NULL != text && (options->html.flags & HTML_SMARTYPANTS))
+    {
+        sdhtml_smartypants_text
+        (
+            ob,
+            &options->html.smartypants,
+            text->data,
+            text->size
+        );
+    }
+    else if (NULL != text)
+    {
+        bufput(ob, text->data, text->size);
+    }
 
+    bufprintf(ob, "</h%d>\n", level);
 }
 
-void SundownExporter::exportToHtml(const QString& text, QString& html)
+
+/*
+ * The Sundown parser, render options and buffers used to render HTML on a
+ * given thread.  These are kept between renders, along with the pools of
+ * work buffers held by the parser, so that re-rendering a document (as the
+ * Live HTML Preview does after every pause in typing) needn't allocate them
+ * all over again.
+ */
+class SundownRenderContext
 {
-    QByteArray latin1Text = text.toUtf8().data();
-    struct buf* htmlOutputBuffer = bufnew(1024);
-    struct sd_callbacks callbacks;
-    struct html_renderopt options;
-    struct sd_markdown* markdown;
+    public:
+        SundownRenderContext();
+        ~SundownRenderContext();
+
+        /*
+         * Resets the render options for a new render with the given heading
+         * anchor prefix (which may be NULL for no anchors), smart
+         * typography setting and source lines setting.
+         */
+        void reset
+        (
+            const char* anchorPrefix,
+            bool smartTypography,
+            bool sourceLines
+        );
+
+        struct sd_callbacks callbacks;
+        struct exporter_renderopt options;
+        struct sd_markdown* markdown;
+        struct bufrope* output;
+};
+
+SundownRenderContext::SundownRenderContext()
+{
+    // The source lines callback is only installed if the flag is given,
+    // after which the flag can be toggled for each render.
+    //
+    sdhtml_renderer(&callbacks, &options.html, HTML_SOURCE_LINES);
+    options.html.flags &= ~HTML_SOURCE_LINES;
+    callbacks.header = rndr_anchored_header;
+    options.anchor_prefix = NULL;
+    options.header_count = 0;
+    options.anchor_number_placeholders = false;
 
-    sdhtml_renderer(&callbacks, &options, 0);
     markdown = sd_markdown_new
     (
         MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_SPACE_HEADERS
@@ -61,52 +206,347 @@ void SundownExporter::exportToHtml(const QString& text, QString& html)
         &options
     );
 
-    sd_markdown_render
+    output = ropenew(GW_SUNDOWN_OUTPUT_PAGE_SIZE);
+}
+
+SundownRenderContext::~SundownRenderContext()
+{
+    sd_markdown_free(markdown);
+    roperelease(output);
+}
+
+void SundownRenderContext::reset
+(
+    const char* anchorPrefix,
+    bool smartTypography,
+    bool sourceLines
+)
+{
+    options.anchor_prefix = anchorPrefix;
+    options.header_count = 0;
+    options.anchor_number_placeholders = false;
+    options.html.flags &= ~(HTML_SMARTYPANTS | HTML_SOURCE_LINES);
+    options.html.smartypants.in_squote = 0;
+    options.html.smartypants.in_dquote = 0;
+    options.html.smartypants.skip_tag = NULL;
+    options.html.source_ob = NULL;
+
+    // Smarty pants is applied to the text of each block as it is rendered,
+    // rather than to the whole of the HTML output afterwards.
+    //
+    if (smartTypography)
+    {
+        options.html.flags |= HTML_SMARTYPANTS;
+    }
+
+    if (sourceLines)
+    {
+        options.html.flags |= HTML_SOURCE_LINES;
+    }
+}
+
+// Each thread rendering HTML gets its own context, which is deleted when
+// the thread exits.
+//
+static QThreadStorage<SundownRenderContext*> renderContexts;
+
+static SundownRenderContext* localRenderContext()
+{
+    if (!renderContexts.hasLocalData())
+    {
+        renderContexts.setLocalData(new SundownRenderContext());
+    }
+
+    return renderContexts.localData();
+}
+
+/*
+ * A part [begin, end) of the text prepared by the source context's parser,
+ * to be rendered by a single worker thread.  Since the parts are rendered
+ * at the same time, each part is rendered as though it follows some output
+ * and starts outside of any quotation, which is checked once the parts
+ * before it have been rendered.
+ */
+struct SundownRenderPart
+{
+    size_t begin;
+    size_t end;
+    SundownRenderContext* source;
+    const char* anchorPrefix;
+    bool smartTypography;
+    bool sourceLines;
+
+    // What the part is rendered as following.
+    bool followsOutput;
+    struct smartypants_data smartypants;
+
+    // The output, with placeholders for its heading numbers, along with
+    // the quotation state in which it ends.
+    //
+    struct buf* html;
+    struct smartypants_data endSmartypants;
+};
+
+static void renderPart(SundownRenderPart& part)
+{
+    SundownRenderContext* context = localRenderContext();
+
+    context->reset(part.anchorPrefix, part.smartTypography, part.sourceLines);
+    context->options.html.smartypants = part.smartypants;
+    context->options.anchor_number_placeholders = true;
+
+    part.html->size = 0;
+
+    // The parser starts each block with a line break if there is output
+    // before it, which it can only tell from its output buffer, so give
+    // it a placeholder to find there.  The placeholder is left out when
+    // the parts are put together.
+    //
+    if (part.followsOutput)
+    {
+        bufputc(part.html, '\n');
+    }
+
+    sd_markdown_render_part
+    (
+        part.html,
+        context->markdown,
+        part.source->markdown,
+        part.begin,
+        part.end
+    );
+
+    part.endSmartypants = context->options.html.smartypants;
+    context->reset(NULL, false, false);
+}
+
+/*
+ * Renders the given UTF-8 text by splitting it into parts between top-level
+ * blocks and rendering the parts concurrently, each on a worker thread
+ * with its own parser.  The output is the same as that of rendering the
+ * text all at once.
+ */
+static void renderInParts
+(
+    SundownRenderContext* context,
+    const QByteArray& utf8Text,
+    const char* anchorPrefix,
+    bool smartTypography,
+    bool sourceLines,
+    QString& html
+)
+{
+    // The first pass, which collects the link references that the parts
+    // all share, is made once for the whole document.
+    //
+    size_t textSize = sd_markdown_prepare
+    (
+        context->markdown,
+        (const uint8_t*) utf8Text.constData(),
+        utf8Text.length()
+    );
+
+    int maxPartCount = QThread::idealThreadCount() * GW_SUNDOWN_PARTS_PER_THREAD;
+    QVector<size_t> bounds(maxPartCount + 1);
+    int partCount = sd_markdown_split
     (
-        htmlOutputBuffer,
-        (const uint8_t*) latin1Text.data(),
-        latin1Text.length(),
-        markdown
+        context->markdown,
+        bounds.data(),
+        maxPartCount,
+        GW_SUNDOWN_MIN_PART_SIZE
     );
 
-    sd_markdown_free(markdown);
+    QVector<SundownRenderPart> parts(partCount);
+
+    for (int i = 0; i < partCount; i++)
+    {
+        parts[i].begin = bounds[i];
+        parts[i].end = bounds[i + 1];
+        parts[i].source = context;
+        parts[i].anchorPrefix = anchorPrefix;
+        parts[i].smartTypography = smartTypography;
+        parts[i].sourceLines = sourceLines;
+        parts[i].followsOutput = (i > 0);
+        parts[i].smartypants.in_squote = 0;
+        parts[i].smartypants.in_dquote = 0;
+        parts[i].smartypants.skip_tag = NULL;
+        parts[i].html = bufnew(GW_SUNDOWN_OUTPUT_PAGE_SIZE);
+    }
+
+    QtConcurrent::blockingMap(parts, renderPart);
+
+    // Put the parts together in order, rendering again any part that was
+    // rendered as following output or quotation state other than what
+    // actually precedes it, and numbering the headings as they come.
+    //
+    bool hasOutput = false;
+    struct smartypants_data smartypants = { 0, 0, NULL };
+    int headerCount = 0;
 
-    if (this->getSmartTypographyEnabled())
+    html = "";
+    html.reserve(textSize + (textSize >> 1));
+
+    for (int i = 0; i < partCount; i++)
     {
-        // Run HTML through smarty pants to get fancy quotation marks, etc.
-        struct buf* smartyPantsBuffer = bufnew(1024);
+        SundownRenderPart& part = parts[i];
 
-        sdhtml_smartypants
+        if
         (
-            smartyPantsBuffer,
-            htmlOutputBuffer->data,
-            htmlOutputBuffer->size
+            (part.followsOutput != hasOutput)
+            || (part.smartypants.in_squote != smartypants.in_squote)
+            || (part.smartypants.in_dquote != smartypants.in_dquote)
+            || (part.smartypants.skip_tag != smartypants.skip_tag)
+        )
+        {
+            part.followsOutput = hasOutput;
+            part.smartypants = smartypants;
+            renderPart(part);
+        }
+
+        const char* data = (const char*) part.html->data;
+        const char* dataEnd = data + part.html->size;
+
+        if (part.followsOutput)
+        {
+            data++;
+        }
+
+        hasOutput = hasOutput || (data < dataEnd);
+
+        while (data < dataEnd)
+        {
+            const char* placeholder = NULL;
+
+            if (NULL != anchorPrefix)
+            {
+                placeholder = (const char*) memchr
+                (
+                    data,
+                    GW_SUNDOWN_ANCHOR_NUMBER_PLACEHOLDER,
+                    dataEnd - data
+                );
+            }
+
+            if (NULL == placeholder)
+            {
+                html += QString::fromUtf8(data, dataEnd - data);
+                break;
+            }
+
+            html += QString::fromUtf8(data, placeholder - data);
+            html += QString::number(++headerCount);
+            data = placeholder + 1;
+        }
+
+        smartypants = part.endSmartypants;
+        bufrelease(part.html);
+    }
+
+    sd_markdown_release(context->markdown);
+}
+
+SundownExporter::SundownExporter() : Exporter("Sundown")
+{
+    supportedFormats.append(ExportFormat::HTML);
+}
+
+SundownExporter::~SundownExporter()
+{
+
+}
+
+void SundownExporter::exportToHtml
+(
+    const QString& text,
+    const ExportOptions& options,
+    QString& html
+)
+{
+    SundownRenderContext* context = localRenderContext();
+    QByteArray utf8Text = text.toUtf8();
+    QByteArray anchorPrefix = options.headingAnchorPrefix.toUtf8();
+    const char* prefix = NULL;
+
+    if (!options.headingAnchorPrefix.isNull())
+    {
+        prefix = anchorPrefix.constData();
+    }
+
+    // Large documents are rendered in parts on several threads.
+    //
+    if
+    (
+        (utf8Text.length() >= GW_SUNDOWN_PARALLEL_THRESHOLD)
+        && (QThread::idealThreadCount() > 1)
+    )
+    {
+        renderInParts
+        (
+            context,
+            utf8Text,
+            prefix,
+            options.smartTypographyEnabled,
+            options.sourceLinesEnabled,
+            html
         );
+        return;
+    }
 
-        // Use QString::fromUtf8 to ensure proper encoding in case there are
-        // unicode characters in the output HTML.
-        //
-        html = QString::fromUtf8
-            (
-                (char*) smartyPantsBuffer->data,
-                smartyPantsBuffer->size
-            );
+    context->reset
+    (
+        prefix,
+        options.smartTypographyEnabled,
+        options.sourceLinesEnabled
+    );
+
+    // Render into a chunked buffer, so that the output can grow to any size
+    // without being copied as it grows.
+    //
+    int error = sd_markdown_render_rope
+    (
+        context->output,
+        (const uint8_t*) utf8Text.constData(),
+        utf8Text.length(),
+        context->markdown,
+        NULL
+    );
+
+    context->reset(NULL, false, false);
 
-        bufrelease(smartyPantsBuffer);
+    // Rather than show part of the document, say that it couldn't be
+    // rendered if the output ran out of memory.
+    //
+    if (BUF_OK != error)
+    {
+        ropereset(context->output, GW_SUNDOWN_RETAINED_OUTPUT_PAGES);
+        html = QString("<center><b style='color: red'>") +
+            QObject::tr("Export failed: ") +
+            QObject::tr("out of memory") +
+            QString("</b></center>");
+        return;
     }
-    else
+
+    // Decode the pages of the output straight into the HTML string.  Use a
+    // UTF-8 decoder to ensure proper encoding in case there are unicode
+    // characters in the output HTML, since a character may be split
+    // across pages.
+    //
+    QTextDecoder decoder(QTextCodec::codecForName("UTF-8"));
+
+    html = "";
+    html.reserve(context->output->size);
+
+    for
+    (
+        struct bufpage* page = context->output->head;
+        NULL != page;
+        page = page->next
+    )
     {
-        // Use QString::fromUtf8 to ensure proper encoding in case there are
-        // unicode characters in the output HTML.
-        //
-        html = QString::fromUtf8
-            (
-                (char*) htmlOutputBuffer->data,
-                htmlOutputBuffer->size
-            );
+        html += decoder.toUnicode((const char*) page->data, page->size);
     }
 
-    bufrelease(htmlOutputBuffer);
+    ropereset(context->output, GW_SUNDOWN_RETAINED_OUTPUT_PAGES);
 }
 
 void SundownExporter::exportToFile
@@ -114,6 +554,7 @@ void SundownExporter::exportToFile
     const ExportFormat* format,
     const QString& inputFilePath,
     const QString& text,
+    const ExportOptions& options,
     const QString& outputFilePath,
     QString& err
 )
@@ -121,6 +562,7 @@ void SundownExporter::exportToFile
     Q_UNUSED(inputFilePath);
 
     QString html;
+    ExportOptions htmlOptions;
 
     if (ExportFormat::HTML != format)
     {
@@ -129,7 +571,9 @@ void SundownExporter::exportToFile
         return;
     }
 
-    exportToHtml(text, html);
+    // Exported files have neither heading anchors nor source lines.
+    htmlOptions.smartTypographyEnabled = options.smartTypographyEnabled;
+    exportToHtml(text, htmlOptions, html);
 
     if (html.isNull())
     {
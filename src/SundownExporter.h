@@ -39,10 +39,15 @@ class SundownExporter : public Exporter
         ~SundownExporter();
 
         /**
-         * Exports the given Markdown text to HTML, setting the html parameter
-         * to have the HTML output.
+         * Exports the given Markdown text to HTML with the given options,
+         * setting the html parameter to have the HTML output.
          */
-        void exportToHtml(const QString& text, QString& html);
+        void exportToHtml
+        (
+            const QString& text,
+            const ExportOptions& options,
+            QString& html
+        );
 
         /**
          * Exports the given Markdown text to the given export format and
@@ -55,6 +60,7 @@ class SundownExporter : public Exporter
             const ExportFormat* format,
             const QString& inputFilePath,
             const QString& text,
+            const ExportOptions& options,
             const QString& outputFilePath,
             QString& err
         );
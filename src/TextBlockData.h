@@ -21,6 +21,10 @@
 #define TEXTBLOCKDATA_H
 
 #include <QTextBlockUserData>
+#include <QVector>
+
+#include "HighlighterLineStates.h"
+#include "Token.h"
 
 /**
  * User data for use with the QSyntaxHighlighter.
@@ -35,6 +39,13 @@ class TextBlockData : public QTextBlockUserData
             sentenceCount = 0;
             lixLongWordCount = 0;
             blankLine = true;
+            tokensValid = false;
+            textHash = 0;
+            textLength = 0;
+            previousState = HIGHLIGHTER_LINE_STATE_UNKNOWN;
+            nextState = HIGHLIGHTER_LINE_STATE_UNKNOWN;
+            tokenizedState = HIGHLIGHTER_LINE_STATE_UNKNOWN;
+            highlightPending = false;
         }
 
         virtual ~TextBlockData()
@@ -47,6 +58,28 @@ class TextBlockData : public QTextBlockUserData
         int sentenceCount;
         int lixLongWordCount;
         bool blankLine;
+
+        // The following are cached by the MarkdownHighlighter from the last
+        // time the block was tokenized (possibly on a worker thread), along
+        // with the inputs that produced them.  Note that nextState is the
+        // state returned by the tokenizer's lookAhead() for the following
+        // block's text.  As long as the block's text and the states of its
+        // neighboring blocks are unchanged, the cached tokens are reused so
+        // that style changes (theme, font, etc.) don't require the block to be
+        // tokenized again.
+        //
+        bool tokensValid;
+        uint textHash;
+        int textLength;
+        int previousState;
+        int nextState;
+        int tokenizedState;
+        QVector<Token> tokens;
+
+        // Set by the MarkdownHighlighter when it has put off highlighting
+        // the block until later, i.e., in large document mode.
+        //
+        bool highlightPending;
 };
 
 #endif // TEXTBLOCKDATA_H
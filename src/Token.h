@@ -122,4 +122,6 @@ class Token
         int closingMarkupLength;
 };
 
+Q_DECLARE_TYPEINFO(Token, Q_MOVABLE_TYPE);
+
 #endif
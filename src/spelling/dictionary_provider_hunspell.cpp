@@ -22,6 +22,7 @@
 
 #include "abstract_dictionary.h"
 #include "dictionary_manager.h"
+#include "spelling_cache.h"
 
 #include <QDir>
 #include <QFile>
@@ -64,6 +65,7 @@ public:
 private:
 	Hunspell* m_dictionary;
 	QTextCodec* m_codec;
+	mutable SpellingCache m_cache;
 };
 
 //-----------------------------------------------------------------------------
@@ -166,7 +168,15 @@ QStringRef DictionaryHunspell::check(const QString& string, int start_at) const
 				QStringRef check(&string, index, length);
 				QString word = check.toString();
 				word.replace(QChar(0x2019), QLatin1Char('\''));
-				if (!m_dictionary->spell(m_codec->fromUnicode(word).constData())) {
+
+				// Most text repeats the same words over and over, so avoid
+				// converting and looking up each word in Hunspell every time.
+				bool correct;
+				if (!m_cache.lookup(word, correct)) {
+					correct = m_dictionary->spell(m_codec->fromUnicode(word).constData());
+					m_cache.insert(word, correct);
+				}
+				if (!correct) {
 					return check;
 				}
 			}
@@ -213,6 +223,7 @@ void DictionaryHunspell::addToSession(const QStringList& words)
 	foreach (const QString& word, words) {
 		m_dictionary->add(m_codec->fromUnicode(word).constData());
 	}
+	m_cache.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -222,6 +233,7 @@ void DictionaryHunspell::removeFromSession(const QStringList& words)
 	foreach (const QString& word, words) {
 		m_dictionary->remove(m_codec->fromUnicode(word).constData());
 	}
+	m_cache.clear();
 }
 
 }
@@ -22,6 +22,7 @@
 
 #include "abstract_dictionary.h"
 #include "dictionary_manager.h"
+#include "spelling_cache.h"
 
 #include <QDir>
 #include <QFile>
@@ -96,6 +97,7 @@ public:
 
 private:
 	VoikkoHandle* m_handle;
+	mutable SpellingCache m_cache;
 };
 
 //-----------------------------------------------------------------------------
@@ -154,7 +156,13 @@ QStringRef DictionaryVoikko::check(const QString& string, int start_at) const
 
 		if (is_word || (i == count && index != -1)) {
 			QStringRef check(&string, index, length);
-			if (voikkoSpellCstr(m_handle, check.toString().toUtf8().constData()) != VOIKKO_SPELL_OK) {
+			QString word = check.toString();
+			bool correct;
+			if (!m_cache.lookup(word, correct)) {
+				correct = (voikkoSpellCstr(m_handle, word.toUtf8().constData()) == VOIKKO_SPELL_OK);
+				m_cache.insert(word, correct);
+			}
+			if (!correct) {
 				return check;
 			}
 			index = -1;
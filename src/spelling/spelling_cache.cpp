@@ -0,0 +1,96 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "spelling_cache.h"
+
+#include <QMutexLocker>
+
+//-----------------------------------------------------------------------------
+
+SpellingCache::SpellingCache(int capacity) :
+	m_capacity(qMax(1, capacity)),
+	m_hand(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+
+bool SpellingCache::lookup(const QString& word, bool& correct)
+{
+	QMutexLocker locker(&m_mutex);
+
+	QHash<QString, int>::const_iterator i = m_index.constFind(word);
+	if (i == m_index.constEnd()) {
+		return false;
+	}
+
+	Entry& entry = m_entries[i.value()];
+	entry.referenced = true;
+	correct = entry.correct;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void SpellingCache::insert(const QString& word, bool correct)
+{
+	QMutexLocker locker(&m_mutex);
+
+	QHash<QString, int>::const_iterator i = m_index.constFind(word);
+	if (i != m_index.constEnd()) {
+		m_entries[i.value()].correct = correct;
+		return;
+	}
+
+	Entry entry;
+	entry.word = word;
+	entry.correct = correct;
+	entry.referenced = false;
+
+	if (m_entries.size() < m_capacity) {
+		m_index.insert(word, m_entries.size());
+		m_entries.append(entry);
+		return;
+	}
+
+	// Sweep past the recently used entries, giving each a second chance,
+	// until one that hasn't been used since the last sweep is found.
+	while (m_entries.at(m_hand).referenced) {
+		m_entries[m_hand].referenced = false;
+		m_hand = (m_hand + 1) % m_capacity;
+	}
+
+	m_index.remove(m_entries.at(m_hand).word);
+	m_entries[m_hand] = entry;
+	m_index.insert(word, m_hand);
+	m_hand = (m_hand + 1) % m_capacity;
+}
+
+//-----------------------------------------------------------------------------
+
+void SpellingCache::clear()
+{
+	QMutexLocker locker(&m_mutex);
+
+	m_entries.clear();
+	m_index.clear();
+	m_hand = 0;
+}
+
+//-----------------------------------------------------------------------------
@@ -0,0 +1,76 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef SPELLING_CACHE_H
+#define SPELLING_CACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+/**
+ * Bounded cache of whether words are spelled correctly, for use by
+ * dictionaries to avoid asking the spell checking library about the same
+ * word again and again.  Since every DictionaryRef for a language shares the
+ * same dictionary, the cache is shared by all of them as well.
+ *
+ * Once full, entries are evicted with the CLOCK algorithm, which approximates
+ * least recently used eviction without reordering entries on every lookup.
+ * The cache may be used from multiple threads.
+ */
+class SpellingCache
+{
+public:
+	SpellingCache(int capacity = 16384);
+
+	/**
+	 * Looks up the given word.  Returns true and sets correct to whether the
+	 * word is spelled correctly if the word is in the cache, or returns false
+	 * otherwise.
+	 */
+	bool lookup(const QString& word, bool& correct);
+
+	/**
+	 * Stores whether the given word is spelled correctly.
+	 */
+	void insert(const QString& word, bool correct);
+
+	/**
+	 * Removes all words from the cache.  Call this whenever the dictionary's
+	 * word list changes.
+	 */
+	void clear();
+
+private:
+	struct Entry
+	{
+		QString word;
+		bool correct;
+		bool referenced;
+	};
+
+	QMutex m_mutex;
+	QVector<Entry> m_entries;
+	QHash<QString, int> m_index;
+	int m_capacity;
+	int m_hand;
+};
+
+#endif
@@ -15,7 +15,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#define BUFFER_MAX_ALLOC_SIZE (1024 * 1024 * 16) //16mb
+#define BUFFER_MAX_ALLOC_SIZE (((size_t) -1) / 2)
 
 #include "buffer.h"
 
@@ -63,9 +63,13 @@ bufgrow(struct buf *buf, size_t neosz)
 	if (buf->asize >= neosz)
 		return BUF_OK;
 
+	/* grow by at least half again, so that filling a buffer bit by
+	 * bit doesn't copy its contents over and over */
 	neoasz = buf->asize + buf->unit;
-	while (neoasz < neosz)
-		neoasz += buf->unit;
+	if (neoasz < buf->asize + (buf->asize >> 1))
+		neoasz = buf->asize + (buf->asize >> 1);
+	if (neoasz < neosz)
+		neoasz = neosz;
 
 	neodata = realloc(buf->data, neoasz);
 	if (!neodata)
@@ -223,3 +227,114 @@ bufslurp(struct buf *buf, size_t len)
 	memmove(buf->data, buf->data + len, buf->size);
 }
 
+/* ropenew: allocation of a new chunked buffer with the given page size */
+struct bufrope *
+ropenew(size_t unit)
+{
+	struct bufrope *ret;
+	ret = malloc(sizeof (struct bufrope));
+
+	if (ret) {
+		ret->head = ret->tail = 0;
+		ret->size = 0;
+		ret->unit = unit;
+	}
+	return ret;
+}
+
+/* ropeput: appends raw data to a chunked buffer */
+int
+ropeput(struct bufrope *rope, const void *data, size_t len)
+{
+	const uint8_t *src = data;
+	struct bufpage *page;
+	size_t n;
+
+	assert(rope && rope->unit);
+
+	while (len > 0) {
+		page = rope->tail;
+
+		if (page && page->size == rope->unit && page->next) {
+			/* reuse a page kept by ropereset */
+			page = page->next;
+			rope->tail = page;
+		}
+		else if (!page || page->size == rope->unit) {
+			page = malloc(sizeof (struct bufpage) + rope->unit);
+			if (!page)
+				return BUF_ENOMEM;
+
+			page->next = 0;
+			page->data = (uint8_t *)(page + 1);
+			page->size = 0;
+
+			if (rope->tail)
+				rope->tail->next = page;
+			else
+				rope->head = page;
+			rope->tail = page;
+		}
+
+		n = rope->unit - page->size;
+		if (n > len)
+			n = len;
+
+		memcpy(page->data + page->size, src, n);
+		page->size += n;
+		rope->size += n;
+		src += n;
+		len -= n;
+	}
+
+	return BUF_OK;
+}
+
+/* roperelease: frees a chunked buffer and all of its pages */
+void
+roperelease(struct bufrope *rope)
+{
+	struct bufpage *page, *next;
+
+	if (!rope)
+		return;
+
+	for (page = rope->head; page; page = next) {
+		next = page->next;
+		free(page);
+	}
+
+	free(rope);
+}
+
+/* ropereset: empties a chunked buffer, keeping up to the given number of
+ * its pages to be reused */
+void
+ropereset(struct bufrope *rope, size_t keep)
+{
+	struct bufpage *page, *next, *last = 0;
+	size_t count = 0;
+
+	if (!rope)
+		return;
+
+	for (page = rope->head; page; page = next) {
+		next = page->next;
+
+		if (count < keep) {
+			page->size = 0;
+			last = page;
+			count++;
+		}
+		else
+			free(page);
+	}
+
+	if (last)
+		last->next = 0;
+	else
+		rope->head = 0;
+
+	rope->tail = rope->head;
+	rope->size = 0;
+}
@@ -44,6 +44,22 @@ struct buf {
 	size_t unit;	/* reallocation unit size (0 = read-only buffer) */
 };
 
+/* struct bufpage: fixed-size page of a chunked buffer */
+struct bufpage {
+	struct bufpage *next;
+	uint8_t *data;		/* character data, allocated with the page */
+	size_t size;	/* size of the string in this page */
+};
+
+/* struct bufrope: character array held in a list of fixed-size pages,
+ * which grows without moving (or copying) the data already in it */
+struct bufrope {
+	struct bufpage *head;
+	struct bufpage *tail;
+	size_t size;	/* total size of the string */
+	size_t unit;	/* size of each page */
+};
+
 /* CONST_BUF: global buffer from a string litteral */
 #define BUF_STATIC(string) \
 	{ (uint8_t *)string, sizeof string -1, sizeof string, 0, 0 }
@@ -89,6 +105,20 @@ void bufslurp(struct buf *, size_t);
 /* bufprintf: formatted printing to a buffer */
 void bufprintf(struct buf *, const char *, ...) __attribute__ ((format (printf, 2, 3)));
 
+/* ropenew: allocation of a new chunked buffer with the given page size */
+struct bufrope *ropenew(size_t) __attribute__ ((malloc));
+
+/* ropeput: appends raw data to a chunked buffer, returning BUF_ENOMEM
+ * (with only the data that fit appended) if a page can't be allocated */
+int ropeput(struct bufrope *, const void *, size_t);
+
+/* roperelease: frees a chunked buffer and all of its pages */
+void roperelease(struct bufrope *);
+
+/* ropereset: empties a chunked buffer, keeping up to the given number of
+ * its pages to be reused */
+void ropereset(struct bufrope *, size_t);
+
 #ifdef __cplusplus
 }
 #endif
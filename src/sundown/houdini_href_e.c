@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "houdini.h"
+#include "scan.h"
 
 #define ESCAPE_GROW_FACTOR(x) (((x) * 12) / 10)
 
@@ -50,6 +51,17 @@ static const char HREF_SAFE[] = {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 };
 
+/* the characters to escape, as sd_scan_set_init describes them:
+ * everything outside [!, z] and the unsafe characters inside it */
+static const struct sd_scan_set HREF_UNSAFE_SET = {
+	(const uint8_t *)HREF_SAFE, 1, 0x21, 0x7A,
+	10, { '"', '&', '\'', '<', '>', '[', '\\', ']', '^', '`' },
+	{ 0x13, 0x01, 0x03, 0x01, 0x01, 0x01, 0x03, 0x03,
+	  0x01, 0x01, 0x01, 0x29, 0x2D, 0x29, 0x2D, 0x21 },
+	{ 0x01, 0x01, 0x02, 0x04, 0x00, 0x08, 0x10, 0x20,
+	  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01 }
+};
+
 void
 houdini_escape_href(struct buf *ob, const uint8_t *src, size_t size)
 {
@@ -62,8 +74,7 @@ houdini_escape_href(struct buf *ob, const uint8_t *src, size_t size)
 
 	while (i < size) {
 		org = i;
-		while (i < size && HREF_SAFE[src[i]] != 0)
-			i++;
+		i += sd_scan(&HREF_UNSAFE_SET, src + i, size - i);
 
 		if (i > org)
 			bufput(ob, src + org, i - org);
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "houdini.h"
+#include "scan.h"
 
 #define ESCAPE_GROW_FACTOR(x) (((x) * 12) / 10) /* this is very scientific, yes */
 
@@ -36,6 +37,16 @@ static const char HTML_ESCAPE_TABLE[] = {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 };
 
+/* the same characters, as sd_scan_set_init describes them */
+static const struct sd_scan_set HTML_ESCAPE_SET = {
+	(const uint8_t *)HTML_ESCAPE_TABLE, 0, 0x00, 0xFF,
+	6, { '"', '&', '\'', '/', '<', '>' },
+	{ 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01,
+	  0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x02, 0x01 },
+	{ 0x00, 0x00, 0x01, 0x02, 0x00, 0x00, 0x00, 0x00,
+	  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
+};
+
 static const char *HTML_ESCAPES[] = {
         "",
         "&quot;",
@@ -55,8 +66,7 @@ houdini_escape_html0(struct buf *ob, const uint8_t *src, size_t size, int secure
 
 	while (i < size) {
 		org = i;
-		while (i < size && (esc = HTML_ESCAPE_TABLE[src[i]]) == 0)
-			i++;
+		i += sd_scan(&HTML_ESCAPE_SET, src + i, size - i);
 
 		if (i > org)
 			bufput(ob, src + org, i - org);
@@ -65,6 +75,8 @@ houdini_escape_html0(struct buf *ob, const uint8_t *src, size_t size, int secure
 		if (i >= size)
 			break;
 
+		esc = HTML_ESCAPE_TABLE[src[i]];
+
 		/* The forward slash is only escaped in secure mode */
 		if (src[i] == '/' && !secure) {
 			bufputc(ob, '/');
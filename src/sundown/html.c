@@ -73,6 +73,52 @@ static inline void escape_href(struct buf *ob, const uint8_t *source, size_t len
 /********************
  * GENERIC RENDERER *
  ********************/
+/* put_text • copies the text of a block into the output, running it
+ * through smartypants on the way if requested */
+static void
+put_text(struct buf *ob, const uint8_t *data, size_t size, struct html_renderopt *options)
+{
+	if (options->flags & HTML_SMARTYPANTS)
+		sdhtml_smartypants_text(ob, &options->smartypants, data, size);
+	else
+		bufput(ob, data, size);
+}
+
+/* rndr_block_source • notes the source line of the top-level block about
+ * to be rendered into ob */
+static void
+rndr_block_source(struct buf *ob, size_t line, void *opaque)
+{
+	struct html_renderopt *options = opaque;
+
+	options->source_ob = ob;
+	options->source_line = line;
+}
+
+/* sdhtml_source_line • gives the element being opened by a block callback
+ * the source line of its block, if it is a top-level one */
+void
+sdhtml_source_line(struct buf *ob, const struct html_renderopt *options)
+{
+	char digits[24];
+	size_t line, n = sizeof(digits);
+
+	if (!(options->flags & HTML_SOURCE_LINES) || ob != options->source_ob)
+		return;
+
+	/* written out by hand, since this is done for most blocks and
+	 * bufprintf is slow */
+	line = options->source_line;
+	do {
+		digits[--n] = '0' + line % 10;
+		line /= 10;
+	} while (line);
+
+	BUFPUTSL(ob, " data-source-line=\"");
+	bufput(ob, digits + n, sizeof(digits) - n);
+	bufputc(ob, '"');
+}
+
 static int
 rndr_autolink(struct buf *ob, const struct buf *link, enum mkd_autolink type, void *opaque)
 {
@@ -118,11 +164,16 @@ rndr_autolink(struct buf *ob, const struct buf *link, enum mkd_autolink type, vo
 static void
 rndr_blockcode(struct buf *ob, const struct buf *text, const struct buf *lang, void *opaque)
 {
+	struct html_renderopt *options = opaque;
+
 	if (ob->size) bufputc(ob, '\n');
 
+	BUFPUTSL(ob, "<pre");
+	sdhtml_source_line(ob, options);
+
 	if (lang && lang->size) {
 		size_t i, cls;
-		BUFPUTSL(ob, "<pre><code class=\"");
+		BUFPUTSL(ob, "><code class=\"");
 
 		for (i = 0, cls = 0; i < lang->size; ++i, ++cls) {
 			while (i < lang->size && isspace(lang->data[i]))
@@ -143,19 +194,29 @@ rndr_blockcode(struct buf *ob, const struct buf *text, const struct buf *lang, v
 
 		BUFPUTSL(ob, "\">");
 	} else
-		BUFPUTSL(ob, "<pre><code>");
+		BUFPUTSL(ob, "><code>");
 
 	if (text)
 		escape_html(ob, text->data, text->size);
 
 	BUFPUTSL(ob, "</code></pre>\n");
+
+	/* the closing tags end any raw <code> or <pre> left open before */
+	if (options->flags & HTML_SMARTYPANTS) {
+		sdhtml_smartypants_close(&options->smartypants, "code");
+		sdhtml_smartypants_close(&options->smartypants, "pre");
+	}
 }
 
 static void
 rndr_blockquote(struct buf *ob, const struct buf *text, void *opaque)
 {
+	struct html_renderopt *options = opaque;
+
 	if (ob->size) bufputc(ob, '\n');
-	BUFPUTSL(ob, "<blockquote>\n");
+	BUFPUTSL(ob, "<blockquote");
+	sdhtml_source_line(ob, options);
+	BUFPUTSL(ob, ">\n");
 	if (text) bufput(ob, text->data, text->size);
 	BUFPUTSL(ob, "</blockquote>\n");
 }
@@ -220,12 +281,15 @@ rndr_header(struct buf *ob, const struct buf *text, int level, void *opaque)
 	if (ob->size)
 		bufputc(ob, '\n');
 
+	bufprintf(ob, "<h%d", level);
+	sdhtml_source_line(ob, options);
+
 	if (options->flags & HTML_TOC)
-		bufprintf(ob, "<h%d id=\"toc_%d\">", level, options->toc_data.header_count++);
-	else
-		bufprintf(ob, "<h%d>", level);
+		bufprintf(ob, " id=\"toc_%d\"", options->toc_data.header_count++);
 
-	if (text) bufput(ob, text->data, text->size);
+	bufputc(ob, '>');
+
+	if (text) put_text(ob, text->data, text->size, options);
 	bufprintf(ob, "</h%d>\n", level);
 }
 
@@ -263,8 +327,12 @@ rndr_link(struct buf *ob, const struct buf *link, const struct buf *title, const
 static void
 rndr_list(struct buf *ob, const struct buf *text, int flags, void *opaque)
 {
+	struct html_renderopt *options = opaque;
+
 	if (ob->size) bufputc(ob, '\n');
-	bufput(ob, flags & MKD_LIST_ORDERED ? "<ol>\n" : "<ul>\n", 5);
+	bufput(ob, flags & MKD_LIST_ORDERED ? "<ol" : "<ul", 3);
+	sdhtml_source_line(ob, options);
+	BUFPUTSL(ob, ">\n");
 	if (text) bufput(ob, text->data, text->size);
 	bufput(ob, flags & MKD_LIST_ORDERED ? "</ol>\n" : "</ul>\n", 6);
 }
@@ -278,11 +346,25 @@ rndr_listitem(struct buf *ob, const struct buf *text, int flags, void *opaque)
 		while (size && text->data[size - 1] == '\n')
 			size--;
 
-		bufput(ob, text->data, size);
+		/* the text of an inline item without a sublist goes through
+		 * smartypants here, once its trailing newlines are stripped */
+		if (flags & (MKD_LI_BLOCK | MKD_LI_SUBLIST))
+			bufput(ob, text->data, size);
+		else
+			put_text(ob, text->data, size, opaque);
 	}
 	BUFPUTSL(ob, "</li>\n");
 }
 
+/* rndr_listitem_text • the inline text of an item followed by a sublist
+ * goes through smartypants here, before the sublist is rendered, so that
+ * the quotation state follows the order of the document */
+static void
+rndr_listitem_text(struct buf *ob, const struct buf *text, void *opaque)
+{
+	if (text) put_text(ob, text->data, text->size, opaque);
+}
+
 static void
 rndr_paragraph(struct buf *ob, const struct buf *text, void *opaque)
 {
@@ -299,7 +381,10 @@ rndr_paragraph(struct buf *ob, const struct buf *text, void *opaque)
 	if (i == text->size)
 		return;
 
-	BUFPUTSL(ob, "<p>");
+	BUFPUTSL(ob, "<p");
+	sdhtml_source_line(ob, options);
+	bufputc(ob, '>');
+
 	if (options->flags & HTML_HARD_WRAP) {
 		size_t org;
 		while (i < text->size) {
@@ -308,7 +393,7 @@ rndr_paragraph(struct buf *ob, const struct buf *text, void *opaque)
 				i++;
 
 			if (i > org)
-				bufput(ob, text->data + org, i - org);
+				put_text(ob, text->data + org, i - org, options);
 
 			/*
 			 * do not insert a line break if this newline
@@ -321,7 +406,7 @@ rndr_paragraph(struct buf *ob, const struct buf *text, void *opaque)
 			i++;
 		}
 	} else {
-		bufput(ob, &text->data[i], text->size - i);
+		put_text(ob, &text->data[i], text->size - i, options);
 	}
 	BUFPUTSL(ob, "</p>\n");
 }
@@ -329,6 +414,7 @@ rndr_paragraph(struct buf *ob, const struct buf *text, void *opaque)
 static void
 rndr_raw_block(struct buf *ob, const struct buf *text, void *opaque)
 {
+	struct html_renderopt *options = opaque;
 	size_t org, sz;
 	if (!text) return;
 	sz = text->size;
@@ -337,7 +423,7 @@ rndr_raw_block(struct buf *ob, const struct buf *text, void *opaque)
 	while (org < sz && text->data[org] == '\n') org++;
 	if (org >= sz) return;
 	if (ob->size) bufputc(ob, '\n');
-	bufput(ob, text->data + org, sz - org);
+	put_text(ob, text->data + org, sz - org, options);
 	bufputc(ob, '\n');
 }
 
@@ -356,7 +442,9 @@ rndr_hrule(struct buf *ob, void *opaque)
 {
 	struct html_renderopt *options = opaque;
 	if (ob->size) bufputc(ob, '\n');
-	bufputs(ob, USE_XHTML(options) ? "<hr/>\n" : "<hr>\n");
+	BUFPUTSL(ob, "<hr");
+	sdhtml_source_line(ob, options);
+	bufputs(ob, USE_XHTML(options) ? "/>\n" : ">\n");
 }
 
 static int
@@ -414,8 +502,12 @@ rndr_raw_html(struct buf *ob, const struct buf *text, void *opaque)
 static void
 rndr_table(struct buf *ob, const struct buf *header, const struct buf *body, void *opaque)
 {
+	struct html_renderopt *options = opaque;
+
 	if (ob->size) bufputc(ob, '\n');
-	BUFPUTSL(ob, "<table><thead>\n");
+	BUFPUTSL(ob, "<table");
+	sdhtml_source_line(ob, options);
+	BUFPUTSL(ob, "><thead>\n");
 	if (header)
 		bufput(ob, header->data, header->size);
 	BUFPUTSL(ob, "</thead><tbody>\n");
@@ -436,6 +528,8 @@ rndr_tablerow(struct buf *ob, const struct buf *text, void *opaque)
 static void
 rndr_tablecell(struct buf *ob, const struct buf *text, int flags, void *opaque)
 {
+	struct html_renderopt *options = opaque;
+
 	if (flags & MKD_TABLE_HEADER) {
 		BUFPUTSL(ob, "<th");
 	} else {
@@ -460,7 +554,7 @@ rndr_tablecell(struct buf *ob, const struct buf *text, int flags, void *opaque)
 	}
 
 	if (text)
-		bufput(ob, text->data, text->size);
+		put_text(ob, text->data, text->size, options);
 
 	if (flags & MKD_TABLE_HEADER) {
 		BUFPUTSL(ob, "</th>\n");
@@ -572,6 +666,9 @@ sdhtml_toc_renderer(struct sd_callbacks *callbacks, struct html_renderopt *optio
 
 		NULL,
 		toc_finalize,
+
+		NULL,
+		NULL,
 	};
 
 	memset(options, 0x0, sizeof(struct html_renderopt));
@@ -613,6 +710,9 @@ sdhtml_renderer(struct sd_callbacks *callbacks, struct html_renderopt *options,
 
 		NULL,
 		NULL,
+
+		rndr_block_source,
+		rndr_listitem_text,
 	};
 
 	/* Prepare the options pointer */
@@ -622,6 +722,9 @@ sdhtml_renderer(struct sd_callbacks *callbacks, struct html_renderopt *options,
 	/* Prepare the callbacks */
 	memcpy(callbacks, &cb_default, sizeof(struct sd_callbacks));
 
+	if (!(render_flags & HTML_SOURCE_LINES))
+		callbacks->block_source = NULL;
+
 	if (render_flags & HTML_SKIP_IMAGES)
 		callbacks->image = NULL;
 
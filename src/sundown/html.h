@@ -25,6 +25,16 @@
 extern "C" {
 #endif
 
+/* struct smartypants_data: quotation state of smartypants, which carries
+ * over from one piece of text to the next, along with the tag whose
+ * contents are being passed through untouched, if its closing tag has yet
+ * to be seen */
+struct smartypants_data {
+	int in_squote;
+	int in_dquote;
+	const char *skip_tag;
+};
+
 struct html_renderopt {
 	struct {
 		int header_count;
@@ -34,6 +44,14 @@ struct html_renderopt {
 
 	unsigned int flags;
 
+	/* smartypants state, for HTML_SMARTYPANTS */
+	struct smartypants_data smartypants;
+
+	/* output buffer of the top-level block being rendered, and its line
+	 * in the source, for HTML_SOURCE_LINES */
+	const struct buf *source_ob;
+	size_t source_line;
+
 	/* extra callbacks */
 	void (*link_attributes)(struct buf *ob, const struct buf *url, void *self);
 };
@@ -49,6 +67,8 @@ typedef enum {
 	HTML_HARD_WRAP = (1 << 7),
 	HTML_USE_XHTML = (1 << 8),
 	HTML_ESCAPE = (1 << 9),
+	HTML_SMARTYPANTS = (1 << 10),
+	HTML_SOURCE_LINES = (1 << 11),
 } html_render_mode;
 
 typedef enum {
@@ -69,6 +89,15 @@ sdhtml_toc_renderer(struct sd_callbacks *callbacks, struct html_renderopt *optio
 extern void
 sdhtml_smartypants(struct buf *ob, const uint8_t *text, size_t size);
 
+extern void
+sdhtml_smartypants_close(struct smartypants_data *smrt, const char *tagname);
+
+extern void
+sdhtml_smartypants_text(struct buf *ob, struct smartypants_data *smrt, const uint8_t *text, size_t size);
+
+extern void
+sdhtml_source_line(struct buf *ob, const struct html_renderopt *options);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,11 +26,6 @@
 #define snprintf	_snprintf		
 #endif
 
-struct smartypants_data {
-	int in_squote;
-	int in_dquote;
-};
-
 static size_t smartypants_cb__ltag(struct buf *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
 static size_t smartypants_cb__dquote(struct buf *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
 static size_t smartypants_cb__amp(struct buf *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size);
@@ -112,7 +107,7 @@ smartypants_cb__squote(struct buf *ob, struct smartypants_data *smrt, uint8_t pr
 		}
 
 		if ((t1 == 's' || t1 == 't' || t1 == 'm' || t1 == 'd') &&
-			(size == 3 || word_boundary(text[2]))) {
+			(size <= 2 || word_boundary(text[2]))) {
 			BUFPUTSL(ob, "&rsquo;");
 			return 0;
 		}
@@ -123,14 +118,14 @@ smartypants_cb__squote(struct buf *ob, struct smartypants_data *smrt, uint8_t pr
 			if (((t1 == 'r' && t2 == 'e') ||
 				(t1 == 'l' && t2 == 'l') ||
 				(t1 == 'v' && t2 == 'e')) &&
-				(size == 4 || word_boundary(text[3]))) {
+				(size <= 3 || word_boundary(text[3]))) {
 				BUFPUTSL(ob, "&rsquo;");
 				return 0;
 			}
 		}
 	}
 
-	if (smartypants_quotes(ob, previous_char, size > 0 ? text[1] : 0, 's', &smrt->in_squote))
+	if (smartypants_quotes(ob, previous_char, size > 1 ? text[1] : 0, 's', &smrt->in_squote))
 		return 0;
 
 	bufputc(ob, text[0]);
@@ -259,20 +254,44 @@ smartypants_cb__number(struct buf *ob, struct smartypants_data *smrt, uint8_t pr
 static size_t
 smartypants_cb__dquote(struct buf *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
-	if (!smartypants_quotes(ob, previous_char, size > 0 ? text[1] : 0, 'd', &smrt->in_dquote))
+	if (!smartypants_quotes(ob, previous_char, size > 1 ? text[1] : 0, 'd', &smrt->in_dquote))
 		BUFPUTSL(ob, "&quot;");
 
 	return 0;
 }
 
+static const char *skip_tags[] = {
+  "pre", "code", "var", "samp", "kbd", "math", "script", "style"
+};
+static const size_t skip_tags_count = 8;
+
+/* smartypants_skip • finds the end of the closing tag of the given skip
+ * tag, or returns size if the piece ends before it */
 static size_t
-smartypants_cb__ltag(struct buf *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+smartypants_skip(const char *tagname, const uint8_t *text, size_t size, size_t i)
 {
-	static const char *skip_tags[] = {
-	  "pre", "code", "var", "samp", "kbd", "math", "script", "style"
-	};
-	static const size_t skip_tags_count = 8;
+	for (;;) {
+		while (i < size && text[i] != '<')
+			i++;
+
+		if (i == size)
+			return size;
+
+		if (sdhtml_is_tag(text + i, size - i, tagname) == HTML_TAG_CLOSE)
+			break;
+
+		i++;
+	}
+
+	while (i < size && text[i] != '>')
+		i++;
 
+	return i;
+}
+
+static size_t
+smartypants_cb__ltag(struct buf *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
+{
 	size_t tag, i = 0;
 
 	while (i < size && text[i] != '>')
@@ -284,32 +303,24 @@ smartypants_cb__ltag(struct buf *ob, struct smartypants_data *smrt, uint8_t prev
 	}
 
 	if (tag < skip_tags_count) {
-		for (;;) {
-			while (i < size && text[i] != '<')
-				i++;
-
-			if (i == size)
-				break;
-
-			if (sdhtml_is_tag(text + i, size - i, skip_tags[tag]) == HTML_TAG_CLOSE)
-				break;
-
-			i++;
-		}
+		i = smartypants_skip(skip_tags[tag], text, size, i);
 
-		while (i < size && text[i] != '>')
-			i++;
+		/* the contents run on into the following pieces */
+		if (i == size)
+			smrt->skip_tag = skip_tags[tag];
 	}
 
-	bufput(ob, text, i + 1);
+	bufput(ob, text, i < size ? i + 1 : size);
 	return i;
 }
 
 static size_t
 smartypants_cb__escape(struct buf *ob, struct smartypants_data *smrt, uint8_t previous_char, const uint8_t *text, size_t size)
 {
-	if (size < 2)
+	if (size < 2) {
+		bufputc(ob, '\\');
 		return 0;
+	}
 
 	switch (text[1]) {
 	case '\\':
@@ -357,18 +368,37 @@ static struct {
 };
 #endif
 
+/* sdhtml_smartypants_text • applies smartypants to a piece of HTML, such
+ * as the text of a block as it is rendered, carrying the quotation state
+ * over from the previous piece.  The piece is taken to be surrounded by
+ * tags, i.e. word boundaries. */
 void
-sdhtml_smartypants(struct buf *ob, const uint8_t *text, size_t size)
+sdhtml_smartypants_text(struct buf *ob, struct smartypants_data *smrt, const uint8_t *text, size_t size)
 {
-	size_t i;
-	struct smartypants_data smrt = {0, 0};
+	size_t i = 0;
 
 	if (!text)
 		return;
 
-	bufgrow(ob, size);
+	if (ob->size + size > ob->asize)
+		bufgrow(ob, ob->size + size);
+
+	/* pass through the rest of the contents of a skip tag opened in an
+	 * earlier piece */
+	if (smrt->skip_tag) {
+		i = smartypants_skip(smrt->skip_tag, text, size, 0);
 
-	for (i = 0; i < size; ++i) {
+		if (i == size) {
+			bufput(ob, text, size);
+			return;
+		}
+
+		bufput(ob, text, i + 1);
+		smrt->skip_tag = NULL;
+		i++;
+	}
+
+	for (; i < size; ++i) {
 		size_t org;
 		uint8_t action = 0;
 
@@ -381,9 +411,31 @@ sdhtml_smartypants(struct buf *ob, const uint8_t *text, size_t size)
 
 		if (i < size) {
 			i += smartypants_cb_ptrs[(int)action]
-				(ob, &smrt, i ? text[i - 1] : 0, text + i, size - i);
+				(ob, smrt, i ? text[i - 1] : 0, text + i, size - i);
 		}
 	}
 }
 
+/* sdhtml_smartypants_close • tells smartypants of a closing tag written
+ * outside of the pieces of text it is given, which ends the contents of
+ * a skip tag of the same name */
+void
+sdhtml_smartypants_close(struct smartypants_data *smrt, const char *tagname)
+{
+	if (smrt->skip_tag && !strcmp(smrt->skip_tag, tagname))
+		smrt->skip_tag = NULL;
+}
+
+void
+sdhtml_smartypants(struct buf *ob, const uint8_t *text, size_t size)
+{
+	struct smartypants_data smrt = {0, 0, NULL};
+
+	if (!text)
+		return;
+
+	bufgrow(ob, size);
+	sdhtml_smartypants_text(ob, &smrt, text, size);
+}
+
 
@@ -19,6 +19,7 @@
 
 #include "markdown.h"
 #include "stack.h"
+#include "scan.h"
 
 #include <assert.h>
 #include <string.h>
@@ -29,7 +30,7 @@
 #define strncasecmp	_strnicmp
 #endif
 
-#define REF_TABLE_SIZE 8
+#define REF_TABLE_SIZE 8 /* initial number of slots, a power of two */
 
 #define BUFFER_BLOCK 0
 #define BUFFER_SPAN 1
@@ -49,10 +50,34 @@
 struct link_ref {
 	unsigned int id;
 
+	struct buf *name; /* case-folded */
 	struct buf *link;
 	struct buf *title;
+};
+
+/* ref_table: open-addressing hash table of link references, which grows
+ * to keep at most half of its slots in use */
+struct ref_table {
+	struct link_ref **slots;
+	size_t size;
+	size_t count;
+};
+
+/* line_skip: source lines left out of the prepared text (as reference
+ * definitions) before the line starting at the given offset */
+struct line_skip {
+	size_t offset;
+	size_t count;
+};
 
-	struct link_ref *next;
+/* line_map: where the lines of the prepared text came from */
+struct line_map {
+	size_t *starts;	/* offset of each line in the prepared text */
+	size_t count;
+	size_t asize;
+	struct line_skip *skips;
+	size_t skip_count;
+	size_t skip_asize;
 };
 
 /* char_trigger: function pointer to render active chars */
@@ -110,12 +135,39 @@ struct sd_markdown {
 	struct sd_callbacks	cb;
 	void *opaque;
 
-	struct link_ref *refs[REF_TABLE_SIZE];
+	struct ref_table refs;
 	uint8_t active_char[256];
+	struct sd_scan_set active_set;
 	struct stack work_bufs[2];
 	unsigned int ext_flags;
 	size_t max_nesting;
 	int in_link_body;
+
+	/* output of sd_markdown_render_rope, which is staged in a regular
+	 * buffer and flushed to the rope between top-level blocks */
+	struct bufrope *rope;
+	struct buf *rope_stage;
+	sd_rope_filter rope_filter;
+	int rope_error;
+
+	/* copy of the document being rendered, kept with the staging buffer
+	 * between renders so that they needn't be allocated again */
+	struct buf *doc;
+
+	/* copy of the part of another parser's document being rendered by
+	 * sd_markdown_render_part */
+	struct buf *part;
+
+	/* lines of the prepared text, kept for the block_source callback, and
+	 * the parser whose lines the text being parsed is looked up in, from
+	 * the given offset, along with the last line looked up */
+	struct line_map lines;
+	const struct sd_markdown *line_source;
+	const uint8_t *line_data;
+	size_t line_base;
+	size_t line_next;
+	size_t skip_next;
+	size_t skipped;
 };
 
 /***************************
@@ -147,6 +199,136 @@ rndr_popbuf(struct sd_markdown *rndr, int type)
 	rndr->work_bufs[type].size--;
 }
 
+/* rndr_flush • moves the staged output of sd_markdown_render_rope to the
+ * rope, but for its last few bytes, which callbacks may look back on */
+static void
+rndr_flush(struct sd_markdown *rndr, size_t keep)
+{
+	struct buf *stage = rndr->rope_stage;
+	size_t size;
+
+	if (stage->size <= keep)
+		return;
+
+	size = stage->size - keep;
+
+	/* once a piece is lost, the rest of the output is dropped rather
+	 * than passed on with a hole in it */
+	if (rndr->rope_error == BUF_OK) {
+		if (rndr->rope_filter)
+			rndr->rope_error = rndr->rope_filter(rndr->rope, stage->data, size, rndr->opaque);
+		else
+			rndr->rope_error = ropeput(rndr->rope, stage->data, size);
+	}
+
+	memmove(stage->data, stage->data + size, keep);
+	stage->size = keep;
+}
+
+/* line_start • notes the start of a line of the prepared text */
+static void
+line_start(struct line_map *map, size_t offset)
+{
+	if (map->count == map->asize) {
+		size_t asize = map->asize ? map->asize * 2 : 256;
+		size_t *starts = realloc(map->starts, asize * sizeof(size_t));
+
+		if (!starts)
+			return;
+
+		map->starts = starts;
+		map->asize = asize;
+	}
+
+	map->starts[map->count++] = offset;
+}
+
+/* line_skip • notes source lines left out of the prepared text */
+static void
+line_skip(struct line_map *map, size_t offset, size_t count)
+{
+	if (map->skip_count && map->skips[map->skip_count - 1].offset == offset) {
+		map->skips[map->skip_count - 1].count += count;
+		return;
+	}
+
+	if (map->skip_count == map->skip_asize) {
+		size_t asize = map->skip_asize ? map->skip_asize * 2 : 16;
+		struct line_skip *skips = realloc(map->skips, asize * sizeof(struct line_skip));
+
+		if (!skips)
+			return;
+
+		map->skips = skips;
+		map->skip_asize = asize;
+	}
+
+	map->skips[map->skip_count].offset = offset;
+	map->skips[map->skip_count].count = count;
+	map->skip_count++;
+}
+
+/* line_cursor • starts looking up the source lines of the text to parse,
+ * which starts at the given offset of the prepared text of source */
+static void
+line_cursor(struct sd_markdown *rndr, const struct sd_markdown *source, const uint8_t *data, size_t base)
+{
+	const struct line_map *map = &source->lines;
+	size_t lo = 0, hi = map->count, mid;
+
+	/* first line starting after base */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (map->starts[mid] <= base)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	rndr->line_source = source;
+	rndr->line_data = data;
+	rndr->line_base = base;
+	rndr->line_next = lo;
+	rndr->skip_next = 0;
+	rndr->skipped = 0;
+
+	while (rndr->skip_next < map->skip_count &&
+			map->skips[rndr->skip_next].offset <= base)
+		rndr->skipped += map->skips[rndr->skip_next++].count;
+}
+
+/* source_line • source line of the prepared text at the given offset,
+ * looked up from the last one, which it may not precede */
+static size_t
+source_line(struct sd_markdown *rndr, size_t offset)
+{
+	const struct line_map *map = &rndr->line_source->lines;
+
+	while (rndr->line_next < map->count && map->starts[rndr->line_next] <= offset)
+		rndr->line_next++;
+
+	while (rndr->skip_next < map->skip_count &&
+			map->skips[rndr->skip_next].offset <= offset)
+		rndr->skipped += map->skips[rndr->skip_next++].count;
+
+	return (rndr->line_next ? rndr->line_next - 1 : 0) + rndr->skipped;
+}
+
+/* block_source • gives the renderer the source line of the block starting
+ * at the given position of the text being parsed, if it is a top-level one */
+static void
+block_source(struct buf *ob, struct sd_markdown *rndr, const uint8_t *data)
+{
+	size_t line;
+
+	if (!rndr->line_source ||
+		rndr->work_bufs[BUFFER_SPAN].size + rndr->work_bufs[BUFFER_BLOCK].size > 0)
+		return;
+
+	line = source_line(rndr, rndr->line_base + (size_t)(data - rndr->line_data));
+	rndr->cb.block_source(ob, line, rndr->opaque);
+}
+
 static void
 unscape_text(struct buf *ob, struct buf *src)
 {
@@ -179,56 +361,131 @@ hash_link_ref(const uint8_t *link_ref, size_t length)
 	return hash;
 }
 
+static void
+release_link_ref(struct link_ref *ref)
+{
+	bufrelease(ref->name);
+	bufrelease(ref->link);
+	bufrelease(ref->title);
+	free(ref);
+}
+
+/* find_link_ref_slot • returns the slot holding the reference with the
+ * given hash and name, or the empty slot where it belongs */
+static struct link_ref **
+find_link_ref_slot(struct ref_table *references, unsigned int hash, const uint8_t *name, size_t length)
+{
+	size_t mask = references->size - 1;
+	size_t i = hash & mask;
+
+	while (references->slots[i] != NULL) {
+		struct link_ref *ref = references->slots[i];
+
+		if (ref->id == hash && ref->name->size == length) {
+			size_t j = 0;
+
+			while (j < length && ref->name->data[j] == tolower(name[j]))
+				j++;
+
+			if (j == length)
+				break;
+		}
+
+		i = (i + 1) & mask;
+	}
+
+	return &references->slots[i];
+}
+
+/* grow_link_refs • doubles the number of slots, rehashing the references */
+static int
+grow_link_refs(struct ref_table *references)
+{
+	struct link_ref **old_slots = references->slots;
+	size_t old_size = references->size;
+	size_t new_size = old_size ? old_size * 2 : REF_TABLE_SIZE;
+	size_t i;
+
+	references->slots = calloc(new_size, sizeof(struct link_ref *));
+	if (!references->slots) {
+		references->slots = old_slots;
+		return 0;
+	}
+
+	references->size = new_size;
+
+	for (i = 0; i < old_size; ++i) {
+		struct link_ref *ref = old_slots[i];
+		size_t j;
+
+		if (!ref)
+			continue;
+
+		j = ref->id & (new_size - 1);
+		while (references->slots[j] != NULL)
+			j = (j + 1) & (new_size - 1);
+
+		references->slots[j] = ref;
+	}
+
+	free(old_slots);
+	return 1;
+}
+
 static struct link_ref *
 add_link_ref(
-	struct link_ref **references,
+	struct ref_table *references,
 	const uint8_t *name, size_t name_size)
 {
-	struct link_ref *ref = calloc(1, sizeof(struct link_ref));
+	struct link_ref **slot;
+	struct link_ref *ref;
+	size_t i;
+
+	if ((references->count + 1) * 2 > references->size &&
+		!grow_link_refs(references))
+		return NULL;
 
+	ref = calloc(1, sizeof(struct link_ref));
 	if (!ref)
 		return NULL;
 
 	ref->id = hash_link_ref(name, name_size);
-	ref->next = references[ref->id % REF_TABLE_SIZE];
+	ref->name = bufnew(name_size + 1);
+	for (i = 0; i < name_size; ++i)
+		bufputc(ref->name, tolower(name[i]));
+
+	/* a later definition of the same reference replaces the earlier one */
+	slot = find_link_ref_slot(references, ref->id, name, name_size);
+	if (*slot)
+		release_link_ref(*slot);
+	else
+		references->count++;
 
-	references[ref->id % REF_TABLE_SIZE] = ref;
+	*slot = ref;
 	return ref;
 }
 
 static struct link_ref *
-find_link_ref(struct link_ref **references, uint8_t *name, size_t length)
+find_link_ref(struct ref_table *references, uint8_t *name, size_t length)
 {
-	unsigned int hash = hash_link_ref(name, length);
-	struct link_ref *ref = NULL;
-
-	ref = references[hash % REF_TABLE_SIZE];
-
-	while (ref != NULL) {
-		if (ref->id == hash)
-			return ref;
-
-		ref = ref->next;
-	}
+	if (!references->count)
+		return NULL;
 
-	return NULL;
+	return *find_link_ref_slot(references, hash_link_ref(name, length), name, length);
 }
 
+/* free_link_refs • empties the table, keeping its slots for the next
+ * document */
 static void
-free_link_refs(struct link_ref **references)
+free_link_refs(struct ref_table *references)
 {
 	size_t i;
 
-	for (i = 0; i < REF_TABLE_SIZE; ++i) {
-		struct link_ref *r = references[i];
-		struct link_ref *next;
-
-		while (r) {
-			next = r->next;
-			bufrelease(r->link);
-			bufrelease(r->title);
-			free(r);
-			r = next;
+	for (i = 0; i < references->size && references->count; ++i) {
+		if (references->slots[i]) {
+			release_link_ref(references->slots[i]);
+			references->slots[i] = NULL;
+			references->count--;
 		}
 	}
 }
@@ -362,9 +619,9 @@ parse_inline(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t siz
 
 	while (i < size) {
 		/* copying inactive chars into the output */
-		while (end < size && (action = rndr->active_char[data[end]]) == 0) {
-			end++;
-		}
+		end += sd_scan(&rndr->active_set, data + end, size - end);
+		if (end < size)
+			action = rndr->active_char[data[end]];
 
 		if (rndr->cb.normal_text) {
 			work.data = data + i;
@@ -991,7 +1248,7 @@ char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset
 			id.size = link_e - link_b;
 		}
 
-		lr = find_link_ref(rndr->refs, id.data, id.size);
+		lr = find_link_ref(&rndr->refs, id.data, id.size);
 		if (!lr)
 			goto cleanup;
 
@@ -1026,7 +1283,7 @@ char_link(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t offset
 		}
 
 		/* finding the link_ref */
-		lr = find_link_ref(rndr->refs, id.data, id.size);
+		lr = find_link_ref(&rndr->refs, id.data, id.size);
 		if (!lr)
 			goto cleanup;
 
@@ -1521,6 +1778,9 @@ parse_paragraph(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 				rndr_popbuf(rndr, BUFFER_BLOCK);
 				work.data += beg;
 				work.size = i - beg;
+
+				/* the header is a block of its own */
+				block_source(ob, rndr, work.data);
 			}
 			else work.size = i;
 		}
@@ -1623,6 +1883,24 @@ parse_blockcode(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t
 	return beg;
 }
 
+/* parse_listitem_text • parsing of the inline text of a list item
+ * followed by a sublist */
+static void
+parse_listitem_text(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size)
+{
+	struct buf *text;
+
+	if (!rndr->cb.listitem_text) {
+		parse_inline(ob, rndr, data, size);
+		return;
+	}
+
+	text = rndr_newbuf(rndr, BUFFER_SPAN);
+	parse_inline(text, rndr, data, size);
+	rndr->cb.listitem_text(ob, text, rndr->opaque);
+	rndr_popbuf(rndr, BUFFER_SPAN);
+}
+
 /* parse_listitem • parsing of a single list item */
 /*	assuming initial prefix is already removed */
 static size_t
@@ -1630,7 +1908,7 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 {
 	struct buf *work = 0, *inter = 0;
 	size_t beg = 0, end, pre, sublist = 0, orgpre = 0, i;
-	int in_empty = 0, has_inside_empty = 0, in_fence = 0;
+	int in_empty = 0, has_inside_empty = 0, in_fence = 0, li_flags = 0;
 
 	/* keeping track of the first indentation prefix */
 	while (orgpre < 3 && orgpre < size && data[orgpre] == ' ')
@@ -1744,8 +2022,9 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 	} else {
 		/* intermediate render of inline li */
 		if (sublist && sublist < work->size) {
-			parse_inline(inter, rndr, work->data, sublist);
+			parse_listitem_text(inter, rndr, work->data, sublist);
 			parse_block(inter, rndr, work->data + sublist, work->size - sublist);
+			li_flags |= MKD_LI_SUBLIST;
 		}
 		else
 			parse_inline(inter, rndr, work->data, work->size);
@@ -1753,7 +2032,7 @@ parse_listitem(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t s
 
 	/* render of li itself */
 	if (rndr->cb.listitem)
-		rndr->cb.listitem(ob, inter, *flags, rndr->opaque);
+		rndr->cb.listitem(ob, inter, *flags | li_flags, rndr->opaque);
 
 	rndr_popbuf(rndr, BUFFER_SPAN);
 	rndr_popbuf(rndr, BUFFER_SPAN);
@@ -2199,6 +2478,8 @@ parse_block(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size
 		txt_data = data + beg;
 		end = size - beg;
 
+		block_source(ob, rndr, txt_data);
+
 		if (is_atxheader(rndr, txt_data, end))
 			beg += parse_atxheader(ob, rndr, txt_data, end);
 
@@ -2241,6 +2522,9 @@ parse_block(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size
 
 		else
 			beg += parse_paragraph(ob, rndr, txt_data, end);
+
+		if (rndr->rope && ob == rndr->rope_stage && ob->size >= rndr->rope->unit)
+			rndr_flush(rndr, 1);
 	}
 }
 
@@ -2252,7 +2536,7 @@ parse_block(struct buf *ob, struct sd_markdown *rndr, uint8_t *data, size_t size
 
 /* is_ref • returns whether a line is a reference or not */
 static int
-is_ref(const uint8_t *data, size_t beg, size_t end, size_t *last, struct link_ref **refs)
+is_ref(const uint8_t *data, size_t beg, size_t end, size_t *last, struct ref_table *refs)
 {
 /*	int n; */
 	size_t i = 0;
@@ -2370,10 +2654,10 @@ static void expand_tabs(struct buf *ob, const uint8_t *line, size_t size)
 
 	while (i < size) {
 		size_t org = i;
+		const uint8_t *next = memchr(line + i, '\t', size - i);
 
-		while (i < size && line[i] != '\t') {
-			i++; tab++;
-		}
+		i = next ? (size_t)(next - line) : size;
+		tab += i - org;
 
 		if (i > org)
 			bufput(ob, line + org, i - org);
@@ -2444,35 +2728,55 @@ sd_markdown_new(
 	if (extensions & MKDEXT_SUPERSCRIPT)
 		md->active_char['^'] = MD_CHAR_SUPERSCRIPT;
 
+	sd_scan_set_init(&md->active_set, md->active_char, 0);
+
 	/* Extension data */
 	md->ext_flags = extensions;
 	md->opaque = opaque;
 	md->max_nesting = max_nesting;
 	md->in_link_body = 0;
 
+	md->rope = NULL;
+	md->rope_stage = NULL;
+	md->rope_filter = NULL;
+	md->rope_error = BUF_OK;
+	md->doc = NULL;
+	md->part = NULL;
+
+	md->refs.slots = NULL;
+	md->refs.size = 0;
+	md->refs.count = 0;
+
+	memset(&md->lines, 0x0, sizeof(struct line_map));
+	md->line_source = NULL;
+
 	return md;
 }
 
-void
-sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md)
+/* prepare_document • first pass: looking for references, copying
+ * everything else into the text to render */
+static size_t
+prepare_document(struct sd_markdown *md, const uint8_t *document, size_t doc_size)
 {
-#define MARKDOWN_GROW(x) ((x) + ((x) >> 1))
 	static const char UTF8_BOM[] = {0xEF, 0xBB, 0xBF};
 
 	struct buf *text;
-	size_t beg, end;
+	struct line_map *map = md->cb.block_source ? &md->lines : NULL;
+	size_t beg, end, i, count;
+
+	if (!md->doc)
+		md->doc = bufnew(64);
 
-	text = bufnew(64);
+	text = md->doc;
 	if (!text)
-		return;
+		return 0;
+
+	text->size = 0;
+	md->in_link_body = 0;
 
 	/* Preallocate enough space for our buffer to avoid expanding while copying */
 	bufgrow(text, doc_size);
 
-	/* reset the references table */
-	memset(&md->refs, 0x0, REF_TABLE_SIZE * sizeof(void *));
-
-	/* first pass: looking for references, copying everything else */
 	beg = 0;
 
 	/* Skip a possible UTF-8 BOM, even though the Unicode standard
@@ -2480,9 +2784,26 @@ sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, str
 	if (doc_size >= 3 && memcmp(document, UTF8_BOM, 3) == 0)
 		beg += 3;
 
+	if (map) {
+		map->count = 0;
+		map->skip_count = 0;
+		line_start(map, 0);
+	}
+
 	while (beg < doc_size) /* iterating over lines */
-		if (is_ref(document, beg, doc_size, &end, md->refs))
+		if (is_ref(document, beg, doc_size, &end, &md->refs)) {
+			/* counting the lines left out, by the same rule as below */
+			if (map) {
+				for (i = beg, count = 0; i < end; i++)
+					if (document[i] == '\n' || (document[i] == '\r' &&
+							i + 1 < doc_size && document[i + 1] != '\n'))
+						count++;
+
+				line_skip(map, text->size, count);
+			}
+
 			beg = end;
+		}
 		else { /* skipping to the next line */
 			end = beg;
 			while (end < doc_size && document[end] != '\n' && document[end] != '\r')
@@ -2494,40 +2815,291 @@ sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, str
 
 			while (end < doc_size && (document[end] == '\n' || document[end] == '\r')) {
 				/* add one \n per newline */
-				if (document[end] == '\n' || (end + 1 < doc_size && document[end + 1] != '\n'))
+				if (document[end] == '\n' || (end + 1 < doc_size && document[end + 1] != '\n')) {
 					bufputc(text, '\n');
+					if (map)
+						line_start(map, text->size);
+				}
 				end++;
 			}
 
 			beg = end;
 		}
 
-	/* pre-grow the output buffer to minimize allocations */
-	bufgrow(ob, MARKDOWN_GROW(text->size));
+	/* adding a final newline if not already present */
+	if (text->size && text->data[text->size - 1] != '\n' &&  text->data[text->size - 1] != '\r')
+		bufputc(text, '\n');
+
+	return text->size;
+}
+
+static void
+render_document(struct buf *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md)
+{
+#define MARKDOWN_GROW(x) ((x) + ((x) >> 1))
+	struct buf *text;
+
+	prepare_document(md, document, doc_size);
+
+	text = md->doc;
+	if (!text)
+		return;
+
+	/* pre-grow the output buffer to minimize allocations, unless it
+	 * is only staging output for a rope */
+	if (!md->rope)
+		bufgrow(ob, MARKDOWN_GROW(text->size));
 
 	/* second pass: actual rendering */
 	if (md->cb.doc_header)
 		md->cb.doc_header(ob, md->opaque);
 
-	if (text->size) {
-		/* adding a final newline if not already present */
-		if (text->data[text->size - 1] != '\n' &&  text->data[text->size - 1] != '\r')
-			bufputc(text, '\n');
+	if (md->cb.block_source)
+		line_cursor(md, md, text->data, 0);
 
+	if (text->size)
 		parse_block(ob, md, text->data, text->size);
-	}
+
+	md->line_source = NULL;
 
 	if (md->cb.doc_footer)
 		md->cb.doc_footer(ob, md->opaque);
 
 	/* clean-up */
-	bufrelease(text);
-	free_link_refs(md->refs);
+	free_link_refs(&md->refs);
+
+	assert(md->work_bufs[BUFFER_SPAN].size == 0);
+	assert(md->work_bufs[BUFFER_BLOCK].size == 0);
+}
+
+void
+sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md)
+{
+	render_document(ob, document, doc_size, md);
+}
+
+/* sd_markdown_render_rope • renders into a chunked buffer, so that the
+ * output never has to be moved as it grows.  The output is passed through
+ * the given filter, if any, in pieces that end between top-level blocks.
+ * Returns BUF_ENOMEM, with the output cut short, if the buffer ran out of
+ * memory. */
+int
+sd_markdown_render_rope(struct bufrope *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md, sd_rope_filter filter)
+{
+	int error;
+
+	if (!md->rope_stage)
+		md->rope_stage = bufnew(ob->unit);
+
+	if (!md->rope_stage)
+		return BUF_ENOMEM;
+
+	md->rope_stage->size = 0;
+	md->rope = ob;
+	md->rope_filter = filter;
+	md->rope_error = BUF_OK;
+
+	render_document(md->rope_stage, document, doc_size, md);
+	rndr_flush(md, 0);
+
+	error = md->rope_error;
+	md->rope = NULL;
+	md->rope_filter = NULL;
+	md->rope_error = BUF_OK;
+	return error;
+}
+
+size_t
+sd_markdown_prepare(struct sd_markdown *md, const uint8_t *document, size_t doc_size)
+{
+	return prepare_document(md, document, doc_size);
+}
+
+/* what the parser may be in the middle of at the start of a top-level line,
+ * as tracked by sd_markdown_split */
+#define SPLIT_BLOCK_START	1	/* nothing: a new block starts there */
+#define SPLIT_PARAGRAPH		2
+#define SPLIT_FENCED_CODE	4
+#define SPLIT_OTHER		8	/* a list, a blockquote, a table, etc. */
+
+/* split_block_start • returns what a top-level block starting on the given
+ * line leaves the parser in the middle of, at the start of the next line */
+static int
+split_block_start(struct sd_markdown *md, uint8_t *data, size_t size)
+{
+	size_t i;
+
+	if ((md->ext_flags & MKDEXT_FENCED_CODE) && is_codefence(data, size, NULL))
+		return SPLIT_FENCED_CODE;
+
+	if (is_atxheader(md, data, size) || is_hrule(data, size))
+		return SPLIT_BLOCK_START;
+
+	if (!isalpha(data[0]))
+		return SPLIT_OTHER;
+
+	/* a line with a pipe may be the header of a table */
+	for (i = 0; i < size && data[i] != '\n'; ++i)
+		if (data[i] == '|')
+			return SPLIT_OTHER;
+
+	return SPLIT_PARAGRAPH;
+}
+
+/* sd_markdown_split • splits the prepared text into parts of at least
+ * min_part_size bytes (and about size / max_parts), at unindented lines
+ * which follow an empty line and start with a letter.  Since the parser
+ * may still be in the middle of a fenced code block or an HTML block
+ * there, the lines that might open or close one are followed through the
+ * text, keeping every interpretation of them open until they agree.
+ * bounds receives the start of each part followed by the size of the
+ * text, and the number of parts is returned. */
+size_t
+sd_markdown_split(struct sd_markdown *md, size_t *bounds, size_t max_parts, size_t min_part_size)
+{
+	struct buf *text = md->doc;
+	size_t part_size, parts = 0;
+	size_t beg = 0, end, html_start = 0, html_until = 0;
+	int state = SPLIT_BLOCK_START, prev_empty = 1;
+
+	if (!text || !max_parts)
+		return 0;
+
+	part_size = text->size / max_parts;
+	if (part_size < min_part_size)
+		part_size = min_part_size;
+
+	bounds[parts++] = 0;
+
+	while (beg < text->size && parts < max_parts) {
+		uint8_t *line = text->data + beg;
+		int next = 0, empty, fence;
+
+		for (end = beg + 1; end < text->size && text->data[end - 1] != '\n'; end++);
+
+		empty = is_empty(line, end - beg) != 0;
+		fence = (md->ext_flags & MKDEXT_FENCED_CODE) &&
+			is_codefence(line, end - beg, NULL) != 0;
+
+		/* a new block starts at the end of an HTML block, if there was
+		 * one (see below) */
+		if (html_until && beg > html_start && beg <= html_until)
+			state |= SPLIT_BLOCK_START;
+
+		if (beg - bounds[parts - 1] >= part_size &&
+			!(state & SPLIT_FENCED_CODE) && beg >= html_until &&
+			prev_empty && isalpha(line[0]))
+			bounds[parts++] = beg;
+
+		if (state & SPLIT_FENCED_CODE) {
+			struct buf trail = { 0, 0, 0, 0 };
+
+			if (fence && is_codefence(line, end - beg, &trail) && trail.size == 0)
+				next |= SPLIT_BLOCK_START;
+			else
+				next |= SPLIT_FENCED_CODE;
+		}
+
+		if (state & SPLIT_BLOCK_START)
+			next |= empty ? SPLIT_BLOCK_START : split_block_start(md, line, end - beg);
+
+		if (state & SPLIT_PARAGRAPH) {
+			if (empty || is_headerline(line, end - beg) ||
+				is_atxheader(md, line, end - beg) || is_hrule(line, end - beg))
+				next |= SPLIT_BLOCK_START;
+			else if (prefix_quote(line, end - beg))
+				next |= SPLIT_OTHER;
+			else if ((md->ext_flags & MKDEXT_LAX_SPACING) && !isalnum(line[0]))
+				next |= SPLIT_OTHER | (fence ? SPLIT_FENCED_CODE : 0);
+			else
+				next |= SPLIT_PARAGRAPH;
+		}
+
+		/* after an empty line, an unindented line which is neither a
+		 * list item nor quoted ends any list, blockquote, indented code
+		 * or table; otherwise a fence might be opening one */
+		if (state & SPLIT_OTHER) {
+			if (empty)
+				next |= SPLIT_OTHER;
+			else if (prev_empty && line[0] != ' ' && line[0] != '>' &&
+				!prefix_uli(line, end - beg) && !prefix_oli(line, end - beg))
+				next |= split_block_start(md, line, end - beg);
+			else if (fence)
+				next |= SPLIT_FENCED_CODE | SPLIT_OTHER;
+			else
+				next |= SPLIT_OTHER;
+		}
+
+		/* an unindented tag might open an HTML block, which could span
+		 * empty lines */
+		if (line[0] == '<' && (state & ~SPLIT_FENCED_CODE)) {
+			size_t html_end = parse_htmlblock(NULL, md, line, text->size - beg, 0);
+
+			if (html_end) {
+				if (beg > html_until)
+					html_start = beg;
+
+				if (beg + html_end > html_until)
+					html_until = beg + html_end;
+			}
+		}
+
+		state = next;
+		prev_empty = empty;
+		beg = end;
+	}
+
+	bounds[parts] = text->size;
+	return parts;
+}
+
+void
+sd_markdown_render_part(struct buf *ob, struct sd_markdown *md, const struct sd_markdown *source, size_t beg, size_t end)
+{
+	struct ref_table refs = md->refs;
+
+	/* the references are only looked up, so they may be shared by the
+	 * parsers of all the parts */
+	if (md != source)
+		md->refs = source->refs;
+
+	md->in_link_body = 0;
+
+	if (beg == 0 && md->cb.doc_header)
+		md->cb.doc_header(ob, md->opaque);
+
+	/* the part is copied, since the parser may rearrange its text in
+	 * place (see parse_blockquote) */
+	if (end > beg) {
+		if (!md->part)
+			md->part = bufnew(64);
+
+		md->part->size = 0;
+		bufput(md->part, source->doc->data + beg, end - beg);
+
+		if (md->cb.block_source)
+			line_cursor(md, source, md->part->data, beg);
+
+		parse_block(ob, md, md->part->data, md->part->size);
+		md->line_source = NULL;
+	}
+
+	if (end == source->doc->size && md->cb.doc_footer)
+		md->cb.doc_footer(ob, md->opaque);
+
+	if (md != source)
+		md->refs = refs;
 
 	assert(md->work_bufs[BUFFER_SPAN].size == 0);
 	assert(md->work_bufs[BUFFER_BLOCK].size == 0);
 }
 
+void
+sd_markdown_release(struct sd_markdown *md)
+{
+	free_link_refs(&md->refs);
+}
+
 void
 sd_markdown_free(struct sd_markdown *md)
 {
@@ -2542,6 +3114,12 @@ sd_markdown_free(struct sd_markdown *md)
 	stack_free(&md->work_bufs[BUFFER_SPAN]);
 	stack_free(&md->work_bufs[BUFFER_BLOCK]);
 
+	bufrelease(md->rope_stage);
+	bufrelease(md->doc);
+	bufrelease(md->part);
+	free(md->lines.starts);
+	free(md->lines.skips);
+	free(md->refs.slots);
 	free(md);
 }
 
@@ -97,10 +97,24 @@ struct sd_callbacks {
 	/* header and footer */
 	void (*doc_header)(struct buf *ob, void *opaque);
 	void (*doc_footer)(struct buf *ob, void *opaque);
+
+	/* source line (counting from 0) of each top-level block, given before
+	 * the block is rendered into ob - NULL skips the line lookups */
+	void (*block_source)(struct buf *ob, size_t line, void *opaque);
+
+	/* inline text of a list item followed by a sublist, given once it is
+	 * rendered and before the sublist is - NULL copies the text into the
+	 * item as is */
+	void (*listitem_text)(struct buf *ob, const struct buf *text, void *opaque);
 };
 
 struct sd_markdown;
 
+/* sd_rope_filter • passes rendered output on to a chunked buffer, e.g.
+ * through smartypants, in pieces that end between top-level blocks,
+ * returning BUF_OK, or BUF_ENOMEM as ropeput does */
+typedef int (*sd_rope_filter)(struct bufrope *ob, const uint8_t *data, size_t size, void *opaque);
+
 /*********
  * FLAGS *
  *********/
@@ -108,6 +122,7 @@ struct sd_markdown;
 /* list/listitem flags */
 #define MKD_LIST_ORDERED	1
 #define MKD_LI_BLOCK		2  /* <li> containing block data */
+#define MKD_LI_SUBLIST		4  /* inline <li> followed by a sublist */
 
 /**********************
  * EXPORTED FUNCTIONS *
@@ -123,6 +138,27 @@ sd_markdown_new(
 extern void
 sd_markdown_render(struct buf *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md);
 
+extern int
+sd_markdown_render_rope(struct bufrope *ob, const uint8_t *document, size_t doc_size, struct sd_markdown *md, sd_rope_filter filter);
+
+/* rendering a document in parts, possibly on several threads: the first
+ * pass is made once with sd_markdown_prepare, then the parts returned by
+ * sd_markdown_split may each be rendered with sd_markdown_render_part by a
+ * different parser (one per thread), which concatenated give the same
+ * output as sd_markdown_render, provided the renderer carries no state from
+ * one top-level block to the next.  sd_markdown_release ends the render. */
+extern size_t
+sd_markdown_prepare(struct sd_markdown *md, const uint8_t *document, size_t doc_size);
+
+extern size_t
+sd_markdown_split(struct sd_markdown *md, size_t *bounds, size_t max_parts, size_t min_part_size);
+
+extern void
+sd_markdown_render_part(struct buf *ob, struct sd_markdown *md, const struct sd_markdown *source, size_t beg, size_t end);
+
+extern void
+sd_markdown_release(struct sd_markdown *md);
+
 extern void
 sd_markdown_free(struct sd_markdown *md);
 
@@ -0,0 +1,254 @@
+#include "scan.h"
+
+#include <string.h>
+
+/*
+ * The vector scanners look at a whole block of text at once, and return
+ * at the first byte of the block in the set. SSE2 is part of every x86-64
+ * target, so it is used whenever the compiler provides it: each byte is
+ * compared with the range and the needles of the set, which is only worth
+ * it for the smaller sets. CPUs with AVX2 classify each byte by its two
+ * nibbles instead, which costs the same for any set. Short runs, the end
+ * of a run, and every run on other targets go through the table like the
+ * loops these replace.
+ */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define SCAN_SSE2
+#	include <emmintrin.h>
+#endif
+
+#if defined(SCAN_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#	define SCAN_AVX2
+#	include <immintrin.h>
+#endif
+
+#if defined(SCAN_SSE2) && defined(_MSC_VER)
+#	include <intrin.h>	/* _BitScanForward */
+#endif
+
+#define SCAN_SCALAR_PREFIX 8
+#define SCAN_SSE2_MAX_NEEDLES 10
+
+#define IN_SET(set, c) (((set)->table[(c)] == 0) == (set)->inverted)
+
+#if defined(SCAN_SSE2) || defined(SCAN_AVX2)
+static inline unsigned
+first_bit(unsigned mask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned)index;
+#else
+	return (unsigned)__builtin_ctz(mask);
+#endif
+}
+#endif
+
+/* scan_table • byte-at-a-time scan through the table of the set */
+static size_t
+scan_table(const struct sd_scan_set *set, const uint8_t *data, size_t size)
+{
+	size_t i = 0;
+
+	while (i < size && !IN_SET(set, data[i]))
+		i++;
+
+	return i;
+}
+
+#ifdef SCAN_SSE2
+/* scan_sse2 • 16 bytes at a time, against the range and the needles */
+static size_t
+scan_sse2(const struct sd_scan_set *set, const uint8_t *data, size_t size)
+{
+	__m128i needles[SD_SCAN_MAX_NEEDLES];
+	__m128i lo = _mm_set1_epi8((char)set->lo);
+	__m128i hi = _mm_set1_epi8((char)set->hi);
+	size_t i = 0, n;
+
+	for (n = 0; n < set->count; n++)
+		needles[n] = _mm_set1_epi8((char)set->needles[n]);
+
+	while (i + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128i inside = _mm_and_si128(
+			_mm_cmpeq_epi8(_mm_max_epu8(block, lo), block),
+			_mm_cmpeq_epi8(_mm_min_epu8(block, hi), block));
+		__m128i hits = _mm_setzero_si128();
+		unsigned mask;
+
+		for (n = 0; n < set->count; n++)
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[n]));
+
+		mask = (unsigned)_mm_movemask_epi8(hits) |
+			(~(unsigned)_mm_movemask_epi8(inside) & 0xFFFF);
+
+		if (mask)
+			return i + first_bit(mask);
+
+		i += 16;
+	}
+
+	return i + scan_table(set, data + i, size - i);
+}
+#endif
+
+#ifdef SCAN_AVX2
+/* scan_avx2 • 32 (then 16) bytes at a time, by nibble classes */
+__attribute__((target("avx2")))
+static size_t
+scan_avx2(const struct sd_scan_set *set, const uint8_t *data, size_t size)
+{
+	__m128i low = _mm_loadu_si128((const __m128i *)set->low_nibbles);
+	__m128i high = _mm_loadu_si128((const __m128i *)set->high_nibbles);
+	__m256i low2 = _mm256_broadcastsi128_si256(low);
+	__m256i high2 = _mm256_broadcastsi128_si256(high);
+	__m256i nibble2 = _mm256_set1_epi8(0x0F);
+	__m128i nibble = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+	unsigned mask;
+
+	while (i + 32 <= size) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)(data + i));
+		__m256i classes = _mm256_and_si256(
+			_mm256_shuffle_epi8(low2, _mm256_and_si256(block, nibble2)),
+			_mm256_shuffle_epi8(high2,
+				_mm256_and_si256(_mm256_srli_epi16(block, 4), nibble2)));
+
+		mask = ~(unsigned)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(classes, _mm256_setzero_si256()));
+
+		for (; mask; mask &= mask - 1)
+			if (IN_SET(set, data[i + first_bit(mask)]))
+				return i + first_bit(mask);
+
+		i += 32;
+	}
+
+	if (i + 16 <= size) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+		__m128i classes = _mm_and_si128(
+			_mm_shuffle_epi8(low, _mm_and_si128(block, nibble)),
+			_mm_shuffle_epi8(high,
+				_mm_and_si128(_mm_srli_epi16(block, 4), nibble)));
+
+		mask = ~(unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(classes, _mm_setzero_si128())) & 0xFFFF;
+
+		for (; mask; mask &= mask - 1)
+			if (IN_SET(set, data[i + first_bit(mask)]))
+				return i + first_bit(mask);
+
+		i += 16;
+	}
+
+	return i + scan_table(set, data + i, size - i);
+}
+#endif
+
+void
+sd_scan_set_init(struct sd_scan_set *set, const uint8_t *table, int inverted)
+{
+	uint8_t columns[16][16];
+	size_t lo = 0, hi = 255, c, h, b, buckets = 0;
+
+	set->table = table;
+	set->inverted = inverted;
+	set->count = 0;
+
+	memset(set->low_nibbles, 0x0, sizeof(set->low_nibbles));
+	memset(set->high_nibbles, 0x0, sizeof(set->high_nibbles));
+
+	/* nibble classes: the rows of the set with the same low nibbles
+	 * share a bit, and the last bit takes all rows beyond the eighth
+	 * shape (which makes it a superset the table then narrows down) */
+	memset(columns, 0x0, sizeof(columns));
+
+	for (c = 0; c < 256; c++)
+		columns[c >> 4][c & 0xF] = IN_SET(set, c);
+
+	for (h = 0; h < 16; h++) {
+		if (memchr(columns[h], 1, 16) == NULL)
+			continue;
+
+		for (b = 0; b < buckets; b++) {
+			size_t row = 0;
+
+			while (!(set->high_nibbles[row] & (1 << b)))
+				row++;
+
+			if (memcmp(columns[row], columns[h], 16) == 0)
+				break;
+		}
+
+		if (b == buckets) {
+			if (buckets < 8)
+				buckets++;
+			else
+				b = 7;
+		}
+
+		set->high_nibbles[h] |= (uint8_t)(1 << b);
+
+		for (c = 0; c < 16; c++)
+			if (columns[h][c])
+				set->low_nibbles[c] |= (uint8_t)(1 << b);
+	}
+
+	/* range and needles */
+	while (lo < 256 && IN_SET(set, lo))
+		lo++;
+
+	if (lo == 256) {
+		set->lo = set->hi = 0;
+		set->count = SIZE_MAX;
+		return;
+	}
+
+	while (IN_SET(set, hi))
+		hi--;
+
+	set->lo = (uint8_t)lo;
+	set->hi = (uint8_t)hi;
+
+	for (c = lo; c <= hi; c++) {
+		if (!IN_SET(set, c))
+			continue;
+
+		if (set->count == SD_SCAN_MAX_NEEDLES) {
+			set->count = SIZE_MAX;
+			return;
+		}
+
+		set->needles[set->count++] = (uint8_t)c;
+	}
+}
+
+size_t
+sd_scan(const struct sd_scan_set *set, const uint8_t *data, size_t size)
+{
+	size_t i;
+
+	/* most runs end within a few bytes, which the table finds quicker
+	 * than it takes to load the vectors */
+	i = scan_table(set, data, size < SCAN_SCALAR_PREFIX ? size : SCAN_SCALAR_PREFIX);
+	if (i < SCAN_SCALAR_PREFIX)
+		return i;
+
+	data += i;
+	size -= i;
+
+#ifdef SCAN_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		return i + scan_avx2(set, data, size);
+#endif
+
+#ifdef SCAN_SSE2
+	if (set->count <= SCAN_SSE2_MAX_NEEDLES)
+		return i + scan_sse2(set, data, size);
+#endif
+
+	return i + scan_table(set, data, size);
+}
@@ -0,0 +1,42 @@
+#ifndef SCAN_H__
+#define SCAN_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SD_SCAN_MAX_NEEDLES 16
+
+/* struct sd_scan_set: set of bytes to look for in a run of text, along
+ * with the two forms of it the vector scanners use. For the SSE2 one,
+ * every byte below lo or above hi is in the set and so are the needles
+ * between them (count is SIZE_MAX if that takes too many needles). For
+ * the AVX2 one, a byte may be in the set only if the entries for its low
+ * and high nibble share a bit; the table has the final say. */
+struct sd_scan_set {
+	const uint8_t *table;	/* non-zero for each byte in the set */
+	int inverted;	/* zero for each byte in the set instead */
+	uint8_t lo, hi;
+	size_t count;
+	uint8_t needles[SD_SCAN_MAX_NEEDLES];
+	uint8_t low_nibbles[16];
+	uint8_t high_nibbles[16];
+};
+
+/* sd_scan_set_init: describes the bytes whose table entry is non-zero
+ * (or zero, if inverted) */
+void
+sd_scan_set_init(struct sd_scan_set *set, const uint8_t *table, int inverted);
+
+/* sd_scan: offset of the first byte of data in the set, or size */
+size_t
+sd_scan(const struct sd_scan_set *set, const uint8_t *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
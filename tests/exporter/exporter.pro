@@ -0,0 +1,56 @@
+################################################################################
+#
+# Copyright (C) 2026 agent
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Compares the Sundown exporter's rendering of large documents in parts on
+# several threads with rendering them all at once, over the quick reference
+# guides and a generated corpus.
+#
+TEMPLATE = app
+TARGET = render_test
+QT += concurrent
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+HEADERS += ../../src/ExportFormat.h \
+    ../../src/ExportJob.h \
+    ../../src/Exporter.h \
+    ../../src/RenderCache.h \
+    ../../src/SundownExporter.h
+
+SOURCES += render_test.cpp \
+    ../../src/ExportFormat.cpp \
+    ../../src/ExportJob.cpp \
+    ../../src/Exporter.cpp \
+    ../../src/RenderCache.cpp \
+    ../../src/SundownExporter.cpp \
+    ../../src/sundown/autolink.c \
+    ../../src/sundown/buffer.c \
+    ../../src/sundown/houdini_href_e.c \
+    ../../src/sundown/houdini_html_e.c \
+    ../../src/sundown/html_smartypants.c \
+    ../../src/sundown/html.c \
+    ../../src/sundown/markdown.c \
+    ../../src/sundown/scan.c \
+    ../../src/sundown/stack.c
+
+check.commands = ./$$TARGET $$files($$PWD/../../resources/*.md)
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
@@ -0,0 +1,422 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+/*
+ * Checks that SundownExporter, which splits large documents into parts and
+ * renders them concurrently, gives the same HTML as rendering the whole
+ * document at once with Sundown, with every combination of smart
+ * typography, heading anchors and source lines.  The documents are the
+ * files given on the command line, repeated until they are large enough
+ * to be rendered in parts, and documents pieced together at random from
+ * blocks chosen for the renderer state that carries from one block to the
+ * next (open quotations, heading numbers, link references defined in one
+ * part and used in another, and blocks that span empty lines).
+ *
+ *     render_test [-n count] [-s seed] [file...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QThread>
+
+#include "SundownExporter.h"
+
+#include "sundown/markdown.h"
+#include "sundown/html.h"
+#include "sundown/buffer.h"
+
+#define GENERATED_DOCUMENT_COUNT 50
+
+// Size (in bytes of UTF-8) of each document, which is above the size from
+// which SundownExporter renders a document in parts.
+//
+#define DOCUMENT_SIZE (320 * 1024)
+
+static const char* blocks[] =
+{
+    "Plain paragraph text, with *emphasis* and **strong** text.\n",
+    "A paragraph \"with a quotation\" and it's 'single' -- dashes.\n",
+    "A paragraph that opens a \"quotation\n",
+    "A paragraph that closes a quotation\" after it.\n",
+    "A paragraph that opens a 'single quotation\n",
+    "and one that ends with it.'\n",
+    "Link to [a reference][ref] and [another one][later].\n",
+    "[ref]: http://example.com/ \"Title\"\n",
+    "[later]: http://example.com/later\n",
+    "# \"Heading\" one\n",
+    "## Heading two ##\n",
+    "Setext heading\n==============\n",
+    "Another setext heading\n--------------\n",
+    "- item one\n- item \"two\n\n- item three\"\n",
+    "1. first\n2. second\n\n   continued\n",
+    "> quoted \"text\n>\n> still quoted\"\n",
+    "> # Quoted heading\n",
+    "    indented \"code\"\n\n    more code\n",
+    "```\nfenced \"code\"\n\nwith an empty line\n```\n",
+    "~~~\nanother fence\n\n# not a heading\n~~~\n",
+    "<div>\n\"html\" block\n\nwith an empty line\n</div>\n",
+    "<pre>\n\"raw\"\n\n</pre>\n",
+    "| \"a\" | 'b' |\n|-----|-----|\n| c's | d |\n",
+    "***\n",
+    "Paragraph with `code \"span\"` and <b>html</b> &amp; an entity.\n",
+    "Text (c) (tm) 1/2 ... and <http://example.com/autolink>.\n",
+    "\n",
+    NULL
+};
+
+static unsigned long randomState;
+
+static unsigned long nextRandom()
+{
+    randomState = (randomState * 1103515245UL) + 12345UL;
+    return (randomState >> 16) & 0x7fff;
+}
+
+static QString generateDocument()
+{
+    int blockCount = 0;
+    QByteArray document;
+
+    while (NULL != blocks[blockCount])
+    {
+        blockCount++;
+    }
+
+    while (document.size() < DOCUMENT_SIZE)
+    {
+        document += blocks[nextRandom() % blockCount];
+        document += '\n';
+    }
+
+    return QString::fromUtf8(document.constData(), document.size());
+}
+
+/*
+ * Sundown HTML render options with the state needed to give headings
+ * anchor ids, as SundownExporter does.
+ */
+struct reference_renderopt
+{
+    struct html_renderopt html;
+    const char* anchor_prefix;
+    int header_count;
+};
+
+static void rndr_reference_header
+(
+    struct buf* ob,
+    const struct buf* text,
+    int level,
+    void* opaque
+)
+{
+    struct reference_renderopt* options =
+        (struct reference_renderopt*) opaque;
+
+    if (ob->size)
+    {
+        bufputc(ob, '\n');
+    }
+
+    bufprintf(ob, "<h%d", level);
+    sdhtml_source_line(ob, &options->html);
+
+    if (NULL != options->anchor_prefix)
+    {
+        bufprintf
+        (
+            ob,
+            " id=\"%s%d\">",
+            options->anchor_prefix,
+            ++options->header_count
+        );
+    }
+    else
+    {
+        bufputc(ob, '>');
+    }
+
+    if (NULL != text && (options->html.flags & HTML_SMARTYPANTS))
+    {
+        sdhtml_smartypants_text
+        (
+            ob,
+            &options->html.smartypants,
+            text->data,
+            text->size
+        );
+    }
+    else if (NULL != text)
+    {
+        bufput(ob, text->data, text->size);
+    }
+
+    bufprintf(ob, "</h%d>\n", level);
+}
+
+/*
+ * Renders the whole of the given text at once, with the same extensions and
+ * render options as SundownExporter.
+ */
+static QString renderAtOnce(const QString& text, const ExportOptions& options)
+{
+    struct sd_callbacks callbacks;
+    struct reference_renderopt renderOptions;
+    QByteArray utf8Text = text.toUtf8();
+    QByteArray anchorPrefix = options.headingAnchorPrefix.toUtf8();
+
+    // As in SundownExporter, the source lines callback is installed, and
+    // then the source lines flag is set for each render.
+    //
+    sdhtml_renderer(&callbacks, &renderOptions.html, HTML_SOURCE_LINES);
+    renderOptions.html.flags &= ~HTML_SOURCE_LINES;
+    callbacks.header = rndr_reference_header;
+    renderOptions.anchor_prefix = NULL;
+    renderOptions.header_count = 0;
+
+    if (!options.headingAnchorPrefix.isNull())
+    {
+        renderOptions.anchor_prefix = anchorPrefix.constData();
+    }
+
+    if (options.smartTypographyEnabled)
+    {
+        renderOptions.html.flags |= HTML_SMARTYPANTS;
+    }
+
+    if (options.sourceLinesEnabled)
+    {
+        renderOptions.html.flags |= HTML_SOURCE_LINES;
+    }
+
+    struct sd_markdown* markdown = sd_markdown_new
+    (
+        MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_SPACE_HEADERS
+            | MKDEXT_SUPERSCRIPT | MKDEXT_STRIKETHROUGH | MKDEXT_AUTOLINK,
+        16,
+        &callbacks,
+        &renderOptions
+    );
+    struct buf* ob = bufnew(64 * 1024);
+
+    sd_markdown_render
+    (
+        ob,
+        (const uint8_t*) utf8Text.constData(),
+        utf8Text.length(),
+        markdown
+    );
+
+    QString html = QString::fromUtf8((const char*) ob->data, ob->size);
+
+    bufrelease(ob);
+    sd_markdown_free(markdown);
+    return html;
+}
+
+/*
+ * Renders the given document both ways with every combination of options,
+ * and reports any difference.  Returns the number of renders that differ.
+ */
+static int check
+(
+    SundownExporter& exporter,
+    const QString& text,
+    const QString& name,
+    qint64& elapsed
+)
+{
+    int differences = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        ExportOptions options;
+        options.smartTypographyEnabled = (0 != (i & 1));
+        options.sourceLinesEnabled = (0 != (i & 2));
+
+        if (0 != (i & 4))
+        {
+            options.headingAnchorPrefix = "heading-";
+        }
+
+        QElapsedTimer timer;
+        QString html;
+
+        timer.start();
+        exporter.exportToHtml(text, options, html);
+        elapsed += timer.elapsed();
+
+        QString expected = renderAtOnce(text, options);
+
+        if (html != expected)
+        {
+            int index = 0;
+
+            while
+            (
+                (index < html.length())
+                && (index < expected.length())
+                && (html[index] == expected[index])
+            )
+            {
+                index++;
+            }
+
+            fprintf
+            (
+                stderr,
+                "MISMATCH: %s (smart typography %d, source lines %d, "
+                "anchors %d) at character %d\n"
+                "--- at once ---\n%s\n--- in parts ---\n%s\n---\n",
+                name.toUtf8().constData(),
+                options.smartTypographyEnabled,
+                options.sourceLinesEnabled,
+                !options.headingAnchorPrefix.isNull(),
+                index,
+                expected.mid(qMax(0, index - 200), 400).toUtf8().constData(),
+                html.mid(qMax(0, index - 200), 400).toUtf8().constData()
+            );
+            differences++;
+        }
+    }
+
+    return differences;
+}
+
+/*
+ * Reads the given UTF-8 file, and repeats its text until it is large enough
+ * to be rendered in parts.  Returns a null QString if the file could not be
+ * read.
+ */
+static QString readDocument(const char* path)
+{
+    QFile file(QString::fromLocal8Bit(path));
+
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        fprintf
+        (
+            stderr,
+            "%s: %s\n",
+            path,
+            file.errorString().toUtf8().constData()
+        );
+        return QString();
+    }
+
+    QByteArray text = file.readAll();
+    QByteArray document;
+
+    if (text.isEmpty())
+    {
+        return QString("");
+    }
+
+    while (document.size() < DOCUMENT_SIZE)
+    {
+        document += text;
+        document += "\n\n";
+    }
+
+    return QString::fromUtf8(document.constData(), document.size());
+}
+
+int main(int argc, char** argv)
+{
+    SundownExporter exporter;
+    unsigned long count = GENERATED_DOCUMENT_COUNT;
+    unsigned long seed = 1;
+    int failures = 0;
+    int differences = 0;
+    int documents = 0;
+    qint64 elapsed = 0;
+
+    if (QThread::idealThreadCount() < 2)
+    {
+        printf
+        (
+            "Warning: only one processor core, so documents are rendered "
+            "in one piece rather than in parts.\n"
+        );
+    }
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if ((0 == qstrcmp(argv[arg], "-n")) && ((arg + 1) < argc))
+        {
+            count = strtoul(argv[++arg], NULL, 10);
+        }
+        else if ((0 == qstrcmp(argv[arg], "-s")) && ((arg + 1) < argc))
+        {
+            seed = strtoul(argv[++arg], NULL, 10);
+        }
+        else
+        {
+            QString document = readDocument(argv[arg]);
+
+            if (document.isNull())
+            {
+                failures++;
+            }
+            else
+            {
+                differences += check
+                (
+                    exporter,
+                    document,
+                    QString::fromLocal8Bit(argv[arg]),
+                    elapsed
+                );
+                documents++;
+            }
+        }
+    }
+
+    randomState = seed;
+
+    for (unsigned long i = 0; i < count; i++)
+    {
+        QString name = QString("generated document %1 (seed %2)")
+            .arg(i)
+            .arg(seed);
+
+        differences += check(exporter, generateDocument(), name, elapsed);
+        documents++;
+    }
+
+    printf
+    (
+        "%d of %d renders differ (%lld ms rendering in parts)\n",
+        differences,
+        documents * 8,
+        (long long) elapsed
+    );
+
+    if ((failures > 0) || (differences > 0))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,311 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include <QString>
+#include <QChar>
+#include <QRegExp>
+
+#include "RegexInlineTokenizer.h"
+#include "MarkdownTokenizer.h"
+#include "MarkdownStates.h"
+
+// This character is used to replace escape characters and other characters
+// with special meaning in a dummy copy of the current line being parsed,
+// for ease of parsing.
+//
+static const QChar DUMMY_CHAR('$');
+
+
+RegexInlineTokenizer::RegexInlineTokenizer()
+{
+    emphasisRegex.setPattern("(\\*(?![\\s*]).*[^\\s*]\\*)|_(?![\\s_]).*[^\\s_]_");
+    emphasisRegex.setMinimal(true);
+    strongRegex.setPattern("\\*\\*(?=\\S).*\\S\\*\\*(?!\\*)|__(?=\\S).*\\S__(?!_)");
+    strongRegex.setMinimal(true);
+    strikethroughRegex.setPattern("~~[^\\s]+.*[^\\s]+~~");
+    strikethroughRegex.setMinimal(true);
+    verbatimRegex.setPattern("`+");
+    htmlTagRegex.setPattern("<[^<>]+>");
+    htmlTagRegex.setMinimal(true);
+    htmlEntityRegex.setPattern("&[a-zA-Z]+;|&#x?[0-9]+;");
+    automaticLinkRegex.setPattern("(<[a-zA-Z]+\\:.+>)|(<.+@.+>)");
+    automaticLinkRegex.setMinimal(true);
+    inlineLinkRegex.setPattern("\\[.+\\]\\(.+\\)");
+    inlineLinkRegex.setMinimal(true);
+    referenceLinkRegex.setPattern("\\[(.+)\\]");
+    referenceLinkRegex.setMinimal(true);
+    referenceDefinitionRegex.setPattern("^\\s*\\[.+\\]:");
+    imageRegex.setPattern("!\\[.*\\]\\(.+\\)");
+    imageRegex.setMinimal(true);
+    htmlInlineCommentRegex.setPattern("<!--.*-->");
+    htmlInlineCommentRegex.setMinimal(true);
+    mentionRegex.setPattern("\\B@\\w+(\\-\\w+)*(/\\w+(\\-\\w+)*)?");
+}
+
+RegexInlineTokenizer::~RegexInlineTokenizer()
+{
+    ;
+}
+
+void RegexInlineTokenizer::tokenize
+(
+    const QString& text,
+    int currentState,
+    int previousState,
+    int nextState
+)
+{
+    Q_UNUSED(currentState);
+    Q_UNUSED(nextState);
+
+    this->previousState = previousState;
+    setState(MarkdownStateParagraph);
+
+    QString escapedText = dummyOutEscapeCharacters(text);
+
+    // Check if the line is a reference definition.
+    if (referenceDefinitionRegex.exactMatch(escapedText))
+    {
+        int colonIndex = escapedText.indexOf(':');
+        Token token;
+        token.setType(TokenReferenceDefinition);
+        token.setPosition(0);
+        token.setLength(colonIndex + 1);
+        addToken(token);
+
+        // Replace the first bracket so that the '[...]:' reference definition
+        // start doesn't get highlighted as a reference link.
+        //
+        int firstBracketIndex = escapedText.indexOf(QChar('['));
+
+        if (firstBracketIndex >= 0)
+        {
+            escapedText[firstBracketIndex] = DUMMY_CHAR;
+        }
+    }
+
+    tokenizeVerbatim(escapedText);
+    tokenizeHtmlComments(escapedText);
+    tokenizeMatches(TokenImage, escapedText, imageRegex, 0, 0, false, true);
+    tokenizeMatches(TokenInlineLink, escapedText, inlineLinkRegex, 0, 0, false, true);
+    tokenizeMatches(TokenReferenceLink, escapedText, referenceLinkRegex, 0, 0, false, true);
+    tokenizeMatches(TokenHtmlEntity, escapedText, htmlEntityRegex);
+    tokenizeMatches(TokenAutomaticLink, escapedText, automaticLinkRegex, 0, 0, false, true);
+    tokenizeMatches(TokenStrikethrough, escapedText, strikethroughRegex, 2, 2);
+    tokenizeMatches(TokenStrong, escapedText, strongRegex, 2, 2, true);
+    tokenizeMatches(TokenEmphasis, escapedText, emphasisRegex, 1, 1, true);
+    tokenizeMatches(TokenHtmlTag, escapedText, htmlTagRegex);
+    tokenizeMatches(TokenMention, escapedText, mentionRegex, 0, 0, false, true);
+}
+
+void RegexInlineTokenizer::tokenizeVerbatim(QString& text)
+{
+    int index = verbatimRegex.indexIn(text);
+
+    while (index >= 0)
+    {
+        QString end = "";
+        int count = verbatimRegex.matchedLength();
+
+        // Search for the matching end, which should have the same number
+        // of back ticks as the start.
+        //
+        for (int i = 0; i < count; i++)
+        {
+            end += '`';
+        }
+
+        int endIndex = text.indexOf(end, index + count);
+
+        // If the end was found, add the verbatim token.
+        if (endIndex >= 0)
+        {
+            Token token;
+
+            token.setType(TokenVerbatim);
+            token.setPosition(index);
+            token.setLength(endIndex + count - index);
+            token.setOpeningMarkupLength(count);
+            token.setClosingMarkupLength(count);
+            this->addToken(token);
+
+            // Fill out the token match in the string with the dummy
+            // character so that searches for other Markdown elements
+            // don't find anything within this token's range in the string.
+            //
+            for (int i = index; i < (index + token.getLength()); i++)
+            {
+                text[i] = DUMMY_CHAR;
+            }
+
+            index += token.getLength();
+        }
+        // Else start searching again at the very next character.
+        else
+        {
+            index++;
+        }
+
+        index = verbatimRegex.indexIn(text, index);
+    }
+}
+
+void RegexInlineTokenizer::tokenizeHtmlComments(QString& text)
+{
+    // Check for the end of a multiline comment so that it doesn't get further
+    // tokenized.
+    //
+    if (MarkdownStateComment == previousState)
+    {
+        int commentEnd = text.indexOf("-->");
+
+        for (int i = 0; i < commentEnd + 3; i++)
+        {
+            text[i] = DUMMY_CHAR;
+        }
+    }
+
+    // Now check for inline comments (non-multiline).
+    int commentStart = text.indexOf(htmlInlineCommentRegex);
+
+    while (commentStart >= 0)
+    {
+        int commentLength = htmlInlineCommentRegex.matchedLength();
+        Token token;
+
+        token.setType(TokenHtmlComment);
+        token.setPosition(commentStart);
+        token.setLength(commentLength);
+        addToken(token);
+
+        // Replace comment segment with dummy characters so that it doesn't
+        // get tokenized again.
+        //
+        for (int i = commentStart; i < (commentStart + commentLength); i++)
+        {
+            text[i] = DUMMY_CHAR;
+        }
+
+        commentStart = text.indexOf
+            (
+                htmlInlineCommentRegex,
+                commentStart + commentLength
+            );
+    }
+
+    // Find multiline comment start, if any.
+    commentStart = text.indexOf("<!--");
+
+    if (commentStart >= 0)
+    {
+        Token token;
+
+        token.setType(TokenHtmlComment);
+        token.setPosition(commentStart);
+        token.setLength(text.length() - commentStart);
+        addToken(token);
+        setState(MarkdownStateComment);
+
+        // Replace comment segment with dummy characters so that it doesn't
+        // get tokenized again.
+        //
+        for (int i = commentStart; i < text.length(); i++)
+        {
+            text[i] = DUMMY_CHAR;
+        }
+    }
+}
+
+void RegexInlineTokenizer::tokenizeMatches
+(
+    int tokenType,
+    QString& text,
+    QRegExp& regex,
+    const int markupStartCount,
+    const int markupEndCount,
+    const bool replaceMarkupChars,
+    const bool replaceAllChars
+)
+{
+    int index = text.indexOf(regex);
+
+    while (index >= 0)
+    {
+        int length = regex.matchedLength();
+        Token token;
+
+        token.setType(tokenType);
+        token.setPosition(index);
+        token.setLength(length);
+
+        if (markupStartCount > 0)
+        {
+            token.setOpeningMarkupLength(markupStartCount);
+        }
+
+        if (markupEndCount > 0)
+        {
+            token.setClosingMarkupLength(markupEndCount);
+        }
+
+        if (replaceAllChars)
+        {
+            for (int i = index; i < (index + length); i++)
+            {
+                text[i] = DUMMY_CHAR;
+            }
+        }
+        else if (replaceMarkupChars)
+        {
+            for (int i = index; i < (index + markupStartCount); i++)
+            {
+                text[i] = DUMMY_CHAR;
+            }
+
+            for (int i = (index + length - markupEndCount); i < (index + length); i++)
+            {
+                text[i] = DUMMY_CHAR;
+            }
+        }
+
+        addToken(token);
+        index = text.indexOf(regex, index + length);
+    }
+}
+
+QString RegexInlineTokenizer::dummyOutEscapeCharacters(const QString& text) const
+{
+    bool escape = false;
+    QString escapedText = text;
+
+    for (int i = 0; i < text.length(); i++)
+    {
+        if (escape)
+        {
+            escapedText[i] = DUMMY_CHAR; // Use a dummy character.
+            escape = false;
+        }
+        else if (QChar('\\') == text[i])
+        {
+            escape = true;
+        }
+    }
+
+    return escapedText;
+}
@@ -0,0 +1,81 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef REGEX_INLINE_TOKENIZER_H
+#define REGEX_INLINE_TOKENIZER_H
+
+#include <QRegExp>
+#include <QString>
+
+#include "HighlightTokenizer.h"
+
+/**
+ * Tokenizes the inline elements of a paragraph line with the chain of
+ * regular expression passes that MarkdownTokenizer used before its
+ * single-pass scanner, as a reference against which to check the scanner.
+ * Each pass blanks out the text it matches in a copy of the line, so that
+ * the passes after it cannot match anything within it.
+ */
+class RegexInlineTokenizer : public HighlightTokenizer
+{
+    public:
+        RegexInlineTokenizer();
+        ~RegexInlineTokenizer();
+
+        void tokenize
+        (
+            const QString& text,
+            int currentState,
+            int previousState,
+            int nextState
+        );
+
+    private:
+        int previousState;
+
+        QRegExp emphasisRegex;
+        QRegExp strongRegex;
+        QRegExp strikethroughRegex;
+        QRegExp verbatimRegex;
+        QRegExp htmlTagRegex;
+        QRegExp htmlEntityRegex;
+        QRegExp automaticLinkRegex;
+        QRegExp inlineLinkRegex;
+        QRegExp referenceLinkRegex;
+        QRegExp referenceDefinitionRegex;
+        QRegExp imageRegex;
+        QRegExp htmlInlineCommentRegex;
+        QRegExp mentionRegex;
+
+        void tokenizeVerbatim(QString& text);
+        void tokenizeHtmlComments(QString& text);
+        void tokenizeMatches
+        (
+            int tokenType,
+            QString& text,
+            QRegExp& regex,
+            const int markupStartCount = 0,
+            const int markupEndCount = 0,
+            const bool replaceMarkupChars = false,
+            const bool replaceAllChars = false
+        );
+        QString dummyOutEscapeCharacters(const QString& text) const;
+};
+
+#endif // REGEX_INLINE_TOKENIZER_H
@@ -0,0 +1,51 @@
+################################################################################
+#
+# Copyright (C) 2026 agent
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Compares the Markdown tokenizer's single-pass inline scanner with the
+# regular expression passes it replaced, over the paragraph lines of the
+# quick reference guides and a generated corpus, and checks that
+# tokenizing the generated lines a second time allocates no memory.  "make
+# benchmark" times the tokenizer over the same documents instead.
+#
+TEMPLATE = app
+TARGET = tokenizer_test
+QT -= gui
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+HEADERS += RegexInlineTokenizer.h \
+    ../../src/HighlightTokenizer.h \
+    ../../src/MarkdownTokenizer.h \
+    ../../src/Token.h
+
+SOURCES += tokenizer_test.cpp \
+    RegexInlineTokenizer.cpp \
+    ../../src/HighlightTokenizer.cpp \
+    ../../src/MarkdownTokenizer.cpp \
+    ../../src/Token.cpp
+
+check.commands = ./$$TARGET $$files($$PWD/../../resources/*.md)
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
+
+benchmark.commands = ./$$TARGET -b 100 $$files($$PWD/../../resources/*.md)
+benchmark.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += benchmark
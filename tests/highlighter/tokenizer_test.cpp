@@ -0,0 +1,700 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+/*
+ * Checks that MarkdownTokenizer's single-pass inline scanner gives the same
+ * tokens and line state as the regular expression passes it replaced
+ * (see RegexInlineTokenizer) on paragraph lines of well-formed Markdown.
+ * The lines are pieced together at random from self-contained inline
+ * elements separated by plain words.  The paragraph lines of any files
+ * given on the command line are compared too, but differences there are
+ * only listed, since the scanner deliberately resolves some overlapping
+ * markup differently (an email autolink can no longer span several HTML
+ * tags, for example).
+ *
+ * It also checks that, once the tokenizer's token buffer has grown to fit
+ * the lines it is given, tokenizing them again allocates no memory at all,
+ * counting the blocks allocated with operator new and, with glibc, with
+ * malloc(), calloc() and realloc(), which Qt's containers use.
+ *
+ * Given -b, it instead times tokenizing the files, and a generated document
+ * in which every kind of block is followed by a paragraph of prose as in a
+ * typical document, the given number of times over.  Run it on two
+ * revisions to compare how fast they classify and tokenize lines.
+ *
+ *     tokenizer_test [-n count] [-s seed] [file...]
+ *     tokenizer_test -b passes [-n count] [-s seed] [file...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <QtAlgorithms>
+
+#include "MarkdownTokenizer.h"
+#include "MarkdownStates.h"
+#include "RegexInlineTokenizer.h"
+
+#define GENERATED_LINE_COUNT 20000
+#define MAX_FRAGMENT_COUNT 12
+#define PROSE_LINES_PER_BLOCK 8
+
+// Number of blocks of memory allocated while countingAllocations is set.
+static bool countingAllocations = false;
+static int allocationCount = 0;
+
+#ifdef __GLIBC__
+// Replace glibc's allocation functions, which the Qt libraries call as
+// well, with ones that count the blocks they allocate.  A realloc() that
+// grows a block in place doesn't count.
+//
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* block, size_t size);
+
+extern "C" void* malloc(size_t size)
+{
+    if (countingAllocations)
+    {
+        allocationCount++;
+    }
+
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    if (countingAllocations)
+    {
+        allocationCount++;
+    }
+
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* block, size_t size)
+{
+    void* newBlock = __libc_realloc(block, size);
+
+    if (countingAllocations && (newBlock != block))
+    {
+        allocationCount++;
+    }
+
+    return newBlock;
+}
+
+#define allocateBlock __libc_malloc
+#else
+#define allocateBlock malloc
+#endif
+
+void* operator new(size_t size)
+{
+    void* block = allocateBlock((size > 0) ? size : 1);
+
+    if (NULL == block)
+    {
+        throw std::bad_alloc();
+    }
+
+    if (countingAllocations)
+    {
+        allocationCount++;
+    }
+
+    return block;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* block)
+{
+    free(block);
+}
+
+void operator delete[](void* block)
+{
+    free(block);
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete(void* block, size_t)
+{
+    free(block);
+}
+
+void operator delete[](void* block, size_t)
+{
+    free(block);
+}
+#endif
+
+static const char* words[] =
+{
+    "ghostwriter", "lorem", "ipsum", "dolor", "sit", "amet", "the", "quick",
+    "brown", "fox", "jumps", "over", "lazy", "dog", "and", "or", "(see",
+    "below)", "it's", "x=1,", "4.5", "a/b",
+    NULL
+};
+
+// Inline elements that contain neither an at sign nor a reference link.
+static const char* tagFragments[] =
+{
+    "*emphasis*", "_emphasis_", "*two words*", "_two words_",
+    "**strong**", "__strong__", "**two words**", "__two words__",
+    "~~struck out~~", "~~struck~~",
+    "**strong *nested emphasis* text**", "*emphasis **nested strong** text*",
+    "*emphasis with `code` inside*", "**strong with [a link](page.html)**",
+    "`code`", "``co`de``", "`*not emphasis*`", "``` triple ```",
+    "[a link](http://example.com)", "[link *text*](page.html)",
+    "![an image](image.png)",
+    "![](image.png)", "<http://example.com/path>", "<b>", "</b>",
+    "<span class=\"note\">", "</span>", "&amp;", "&copy;", "&#169;",
+    "&#x41;", "<!-- a comment -->", "\\*not emphasis\\*", "\\`not code\\`",
+    "\\<not a tag>", "\\[not a link]",
+    NULL
+};
+
+// Reference links, which the regular expressions would match as the start
+// of any inline link or image later in the line, and so are kept out of
+// lines with those.
+//
+static const char* referenceFragments[] =
+{
+    "[a reference]", "[a reference][id]", "[*emphasis* in a reference]",
+    "\\[not a link]", "*emphasis*", "**strong**", "`code`", "<b>", "</b>",
+    "&amp;",
+    NULL
+};
+
+// Inline elements that contain an at sign, which the regular expressions
+// would match as part of an email autolink starting at any earlier HTML
+// tag, and so are kept out of lines with tags.
+//
+static const char* atFragments[] =
+{
+    "@user", "@user-name", "@user/repository", "@user-name/repository-name",
+    "<user@example.com>", "(@user)", "*emphasis*", "**strong**",
+    "~~struck out~~", "`code`", "[a link](page.html)", "&amp;",
+    NULL
+};
+
+// Lines of the block-level constructs, each of which is followed by a
+// generated line of text (if it ends with a space) and a few lines of
+// prose in the generated benchmark document.
+//
+static const char* blocks[] =
+{
+    "# ", "## ", "###### ", "Setext heading\n=====", "Setext heading\n-----",
+    "- ", "* ", "+ ", "1. ", "10) ", "    - ", "> ", "> > ", "    ",
+    "\t", "```\ncode\n```", "~~~ {.cpp}\ncode\n~~~", "* * *", "---",
+    "___", "a | b\n---|---\n", "<!--\ncomment\n-->", "[id]:",
+    NULL
+};
+
+static int countOf(const char** strings)
+{
+    int count = 0;
+
+    while (NULL != strings[count])
+    {
+        count++;
+    }
+
+    return count;
+}
+
+static QString generateLine()
+{
+    const char** fragments = tagFragments;
+
+    switch (qrand() % 4)
+    {
+        case 0:
+            fragments = atFragments;
+            break;
+        case 1:
+            fragments = referenceFragments;
+            break;
+        default:
+            break;
+    }
+
+    int wordCount = countOf(words);
+    int fragmentCount = countOf(fragments);
+    int count = 1 + (qrand() % MAX_FRAGMENT_COUNT);
+
+    // Reference definitions are only recognized as the whole line.
+    if (0 == (qrand() % 50))
+    {
+        return QString("[%1]:").arg(words[qrand() % wordCount]);
+    }
+
+    // Start with a word, so that the line can only be a paragraph line.
+    QString line = words[qrand() % wordCount];
+
+    for (int i = 0; i < count; i++)
+    {
+        line += ' ';
+
+        if (0 == (qrand() % 2))
+        {
+            line += fragments[qrand() % fragmentCount];
+        }
+        else
+        {
+            line += words[qrand() % wordCount];
+        }
+    }
+
+    // An unclosed comment runs on to the following lines.
+    if ((tagFragments == fragments) && (0 == (qrand() % 20)))
+    {
+        line += " <!-- an unclosed comment";
+    }
+
+    return line;
+}
+
+static bool tokenLessThan(const Token& t1, const Token& t2)
+{
+    if (t1.getPosition() != t2.getPosition())
+    {
+        return t1.getPosition() < t2.getPosition();
+    }
+    else if (t1.getLength() != t2.getLength())
+    {
+        return t1.getLength() < t2.getLength();
+    }
+
+    return t1.getType() < t2.getType();
+}
+
+/*
+ * Returns the tokens in a canonical order, since the two tokenizers needn't
+ * add tokens at the same position in the same order.
+ */
+static QVector<Token> sortedTokens(const HighlightTokenizer& tokenizer)
+{
+    QVector<Token> tokens = tokenizer.getTokens();
+    qStableSort(tokens.begin(), tokens.end(), tokenLessThan);
+    return tokens;
+}
+
+static void printTokens(const QVector<Token>& tokens, int state)
+{
+    fprintf(stderr, "state %d\n", state);
+
+    for (int i = 0; i < tokens.size(); i++)
+    {
+        fprintf
+        (
+            stderr,
+            "  type %d at %d+%d (markup %d/%d)\n",
+            tokens[i].getType(),
+            tokens[i].getPosition(),
+            tokens[i].getLength(),
+            tokens[i].getOpeningMarkupLength(),
+            tokens[i].getClosingMarkupLength()
+        );
+    }
+}
+
+/*
+ * Tokenizes the given paragraph line both ways, and reports any difference.
+ */
+static bool checkLine
+(
+    MarkdownTokenizer& tokenizer,
+    RegexInlineTokenizer& reference,
+    const QString& text,
+    int previousState,
+    const QString& name
+)
+{
+    tokenizer.clear();
+    tokenizer.tokenize(text, MarkdownStateUnknown, previousState, MarkdownStateUnknown);
+    reference.clear();
+    reference.tokenize(text, MarkdownStateUnknown, previousState, MarkdownStateUnknown);
+
+    QVector<Token> actual = sortedTokens(tokenizer);
+    QVector<Token> expected = sortedTokens(reference);
+    bool same =
+        (tokenizer.getState() == reference.getState())
+        && (actual.size() == expected.size());
+
+    for (int i = 0; same && (i < actual.size()); i++)
+    {
+        same =
+            (actual[i].getType() == expected[i].getType())
+            && (actual[i].getPosition() == expected[i].getPosition())
+            && (actual[i].getLength() == expected[i].getLength())
+            && (actual[i].getOpeningMarkupLength() == expected[i].getOpeningMarkupLength())
+            && (actual[i].getClosingMarkupLength() == expected[i].getClosingMarkupLength());
+    }
+
+    if (!same)
+    {
+        fprintf
+        (
+            stderr,
+            "MISMATCH: %s\n--- input ---\n%s\n--- regular expressions ---\n",
+            name.toUtf8().constData(),
+            text.toUtf8().constData()
+        );
+        printTokens(expected, reference.getState());
+        fputs("--- single pass ---\n", stderr);
+        printTokens(actual, tokenizer.getState());
+        fputs("---\n", stderr);
+    }
+
+    return same;
+}
+
+/*
+ * Appends the lines of the given UTF-8 file to the list, returning false if
+ * the file could not be read.
+ */
+static bool readLines(const QString& path, QStringList& lines)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        fprintf
+        (
+            stderr,
+            "%s: %s\n",
+            path.toUtf8().constData(),
+            file.errorString().toUtf8().constData()
+        );
+        return false;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+    lines += in.readAll().split('\n');
+    return true;
+}
+
+/*
+ * Compares the paragraph lines of the given file, returning the number of
+ * lines that differ, or -1 if the file could not be read.
+ */
+static int checkFile
+(
+    MarkdownTokenizer& tokenizer,
+    RegexInlineTokenizer& reference,
+    const QString& path,
+    int& lineCount
+)
+{
+    QStringList lines;
+
+    if (!readLines(path, lines))
+    {
+        return -1;
+    }
+
+    int previousState = MarkdownStateParagraphBreak;
+    int differences = 0;
+
+    for (int i = 0; i < lines.size(); i++)
+    {
+        int nextState = MarkdownStateUnknown;
+
+        if ((i + 1) < lines.size())
+        {
+            nextState = tokenizer.lookAhead(lines[i + 1]);
+        }
+
+        tokenizer.clear();
+        tokenizer.tokenize(lines[i], MarkdownStateUnknown, previousState, nextState);
+        int state = tokenizer.getState();
+
+        // Only plain paragraph lines go straight to the inline scanner.
+        if
+        (
+            (MarkdownStateParagraph == state)
+            && (MarkdownStateComment != previousState)
+            && (MarkdownStateUnknown == nextState)
+        )
+        {
+            QString name = QString("%1:%2").arg(path).arg(i + 1);
+            lineCount++;
+
+            if (!checkLine(tokenizer, reference, lines[i], previousState, name))
+            {
+                differences++;
+            }
+        }
+
+        previousState = state;
+    }
+
+    return differences;
+}
+
+/*
+ * Tokenizes the given lines twice with a new tokenizer, returning the number
+ * of blocks of memory allocated while clearing and tokenizing the lines the
+ * second time.
+ */
+static int checkTokenBuffer(const QStringList& lines)
+{
+    MarkdownTokenizer tokenizer;
+    int allocations = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        int previousState = MarkdownStateParagraphBreak;
+
+        for (int i = 0; i < lines.size(); i++)
+        {
+            int nextState = MarkdownStateUnknown;
+
+            if ((i + 1) < lines.size())
+            {
+                nextState = tokenizer.lookAhead(lines[i + 1]);
+            }
+
+            // Clearing the tokens must keep their memory for the next line,
+            // and getting them sorted must not copy them.
+            //
+            allocationCount = 0;
+            countingAllocations = (pass > 0);
+
+            tokenizer.clear();
+            tokenizer.tokenize(lines[i], MarkdownStateUnknown, previousState, nextState);
+            previousState = tokenizer.getState();
+            tokenizer.getTokens();
+
+            countingAllocations = false;
+            allocations += allocationCount;
+        }
+    }
+
+    return allocations;
+}
+
+/*
+ * Generates a document of the given number of blocks, each of them a block
+ * construct followed by a paragraph of plain prose.
+ */
+static QStringList generateDocument(unsigned long blockCount)
+{
+    int blockTypeCount = countOf(blocks);
+    QStringList lines;
+
+    for (unsigned long i = 0; i < blockCount; i++)
+    {
+        QString block = blocks[qrand() % blockTypeCount];
+
+        if (block.endsWith(" ") || block.endsWith("\t"))
+        {
+            block += generateLine();
+        }
+
+        lines += block.split('\n');
+        lines.append("");
+
+        for (int j = 0; j < PROSE_LINES_PER_BLOCK; j++)
+        {
+            lines.append(generateLine());
+        }
+
+        lines.append("");
+    }
+
+    return lines;
+}
+
+/*
+ * Tokenizes the given document the given number of times over, as the
+ * highlighter would when the whole document is rehighlighted, and prints
+ * how long it took.
+ */
+static void benchmark(const QString& name, const QStringList& lines, int passes)
+{
+    MarkdownTokenizer tokenizer;
+    QElapsedTimer timer;
+    int tokenCount = 0;
+
+    timer.start();
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        int previousState = MarkdownStateParagraphBreak;
+
+        for (int i = 0; i < lines.size(); i++)
+        {
+            int nextState = MarkdownStateUnknown;
+
+            if ((i + 1) < lines.size())
+            {
+                nextState = tokenizer.lookAhead(lines[i + 1]);
+            }
+
+            tokenizer.clear();
+            tokenizer.tokenize(lines[i], MarkdownStateUnknown, previousState, nextState);
+            previousState = tokenizer.getState();
+            tokenCount += tokenizer.getTokens().size();
+        }
+    }
+
+    qint64 elapsed = timer.elapsed();
+    double lineCount = (double) lines.size() * passes;
+
+    printf
+    (
+        "%s: %d lines x %d passes in %lld ms (%.3f us per line, %d tokens)\n",
+        name.toUtf8().constData(),
+        lines.size(),
+        passes,
+        (long long) elapsed,
+        (lineCount > 0) ? ((elapsed * 1000.0) / lineCount) : 0.0,
+        tokenCount
+    );
+}
+
+int main(int argc, char** argv)
+{
+    MarkdownTokenizer tokenizer;
+    RegexInlineTokenizer reference;
+    QStringList paths;
+    unsigned long count = GENERATED_LINE_COUNT;
+    unsigned int seed = 1;
+    int passes = 0;
+    int failures = 0;
+    int generatedDifferences = 0;
+    int fileDifferences = 0;
+    int fileLines = 0;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if ((0 == qstrcmp(argv[arg], "-n")) && ((arg + 1) < argc))
+        {
+            count = strtoul(argv[++arg], NULL, 10);
+        }
+        else if ((0 == qstrcmp(argv[arg], "-s")) && ((arg + 1) < argc))
+        {
+            seed = strtoul(argv[++arg], NULL, 10);
+        }
+        else if ((0 == qstrcmp(argv[arg], "-b")) && ((arg + 1) < argc))
+        {
+            passes = strtoul(argv[++arg], NULL, 10);
+        }
+        else
+        {
+            paths.append(QString::fromLocal8Bit(argv[arg]));
+        }
+    }
+
+    qsrand(seed);
+
+    if (passes > 0)
+    {
+        QStringList lines;
+
+        for (int i = 0; i < paths.size(); i++)
+        {
+            if (!readLines(paths[i], lines))
+            {
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!lines.isEmpty())
+        {
+            benchmark("files", lines, passes);
+        }
+
+        // Make the generated document about as many lines long as the
+        // generated corpus is for the checks.
+        //
+        benchmark
+        (
+            QString("generated document (seed %1)").arg(seed),
+            generateDocument(count / (PROSE_LINES_PER_BLOCK + 4)),
+            passes
+        );
+        return EXIT_SUCCESS;
+    }
+
+    for (int i = 0; i < paths.size(); i++)
+    {
+        int differences = checkFile(tokenizer, reference, paths[i], fileLines);
+
+        if (differences < 0)
+        {
+            failures++;
+        }
+        else
+        {
+            fileDifferences += differences;
+        }
+    }
+
+    QStringList generatedLines;
+
+    for (unsigned long i = 0; i < count; i++)
+    {
+        QString name = QString("generated line %1 (seed %2)").arg(i).arg(seed);
+        generatedLines.append(generateLine());
+
+        if
+        (
+            !checkLine
+            (
+                tokenizer,
+                reference,
+                generatedLines.last(),
+                MarkdownStateParagraphBreak,
+                name
+            )
+        )
+        {
+            generatedDifferences++;
+        }
+    }
+
+    int allocations = checkTokenBuffer(generatedLines);
+
+    printf("%d of %d paragraph lines in files differ\n", fileDifferences, fileLines);
+    printf("%d of %lu generated lines differ\n", generatedDifferences, count);
+    printf("%d blocks allocated tokenizing the generated lines again\n", allocations);
+
+    if ((failures > 0) || (generatedDifferences > 0) || (allocations > 0))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,40 @@
+################################################################################
+#
+# Copyright (C) 2026 agent
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Checks the probes with which the exporter factory finds the installed
+# Markdown processors, with stand-in processors written as shell scripts:
+# how long a probe waits for a slow processor, and which results are
+# remembered between runs of the application.
+#
+TEMPLATE = app
+TARGET = probe_test
+QT -= gui
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+HEADERS += ../../src/ProcessorProbe.h
+
+SOURCES += probe_test.cpp \
+    ../../src/ProcessorProbe.cpp
+
+check.commands = ./$$TARGET
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
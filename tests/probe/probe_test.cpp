@@ -0,0 +1,272 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+/*
+ * Checks ProcessorProbe with stand-in processors, which are shell scripts
+ * written to a temporary directory put at the front of the PATH:
+ *
+ *   - A processor that takes a second to answer, which is longer than
+ *     probes used to wait, is found, and its result is remembered.
+ *   - A processor that never answers is found, but its result is not
+ *     remembered, so that it is probed again next time.
+ *   - A processor that isn't installed, and so fails to start, is
+ *     remembered as missing.
+ *   - Remembered results are used for as long as the processor's
+ *     executable stays the same, and are not written back.
+ *
+ *     probe_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSettings>
+#include <QString>
+
+#include "ProcessorProbe.h"
+
+static int failures = 0;
+
+static void expect(bool condition, const char* description)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", description);
+        failures++;
+    }
+}
+
+/*
+ * Writes a stand-in processor to the given directory as a shell script
+ * that runs the given commands.  Returns false on failure.
+ */
+static bool writeProcessor
+(
+    const QDir& directory,
+    const QString& name,
+    const QByteArray& commands
+)
+{
+    QFile file(directory.absoluteFilePath(name));
+
+    if
+    (
+        !file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || (file.write("#!/bin/sh\n" + commands + "\n") < 0)
+    )
+    {
+        fprintf
+        (
+            stderr,
+            "%s: %s\n",
+            file.fileName().toUtf8().constData(),
+            file.errorString().toUtf8().constData()
+        );
+        return false;
+    }
+
+    file.close();
+
+    return file.setPermissions
+    (
+        QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner
+    );
+}
+
+/*
+ * Runs the given probe with the result remembered in the given settings,
+ * as ExporterFactory does at startup, and remembers its new result.
+ * Returns the probe that was run, and sets saved to whether its result
+ * was remembered.
+ */
+static ProcessorProbe runProbe
+(
+    QSettings& settings,
+    const QString& name,
+    bool& saved
+)
+{
+    ProcessorProbe probe(name, name + " --version");
+
+    probe.load(settings);
+    probe = ProcessorProbe::run(probe);
+    saved = probe.save(settings);
+    settings.sync();
+    return probe;
+}
+
+/*
+ * Removes the given temporary directory and the files in it.
+ */
+static void removeDirectory(const QDir& directory)
+{
+    foreach (const QString& name, directory.entryList(QDir::Files))
+    {
+        QFile::remove(directory.absoluteFilePath(name));
+    }
+
+    directory.rmdir(directory.absolutePath());
+}
+
+/*
+ * Runs the checks with the stand-in processors in the given directory,
+ * remembering their results in a settings file there.
+ */
+static void checkProbes(const QDir& directory)
+{
+    QSettings settings
+    (
+        directory.absoluteFilePath("probes.ini"),
+        QSettings::IniFormat
+    );
+    QElapsedTimer timer;
+    bool saved = false;
+    ProcessorProbe result;
+
+    // Probes used to give up on a processor after half a second, which
+    // isn't long enough for pandoc while the system is busy at login.
+    //
+    expect
+    (
+        ProcessorProbe::TIMEOUT >= 5000,
+        "probes wait at least 5 seconds for a processor"
+    );
+
+    timer.start();
+    result = runProbe(settings, "slowproc", saved);
+
+    expect(result.available, "a slow processor is found");
+    expect(result.finished, "a slow processor's probe runs to the end");
+    expect(!result.cached, "a new processor is probed");
+    expect
+    (
+        result.output.contains("1.2.3"),
+        "a slow processor's version output is read"
+    );
+    expect(saved, "a slow processor's result is remembered");
+    expect(timer.elapsed() >= 1000, "the slow processor is run");
+
+    timer.start();
+    result = runProbe(settings, "slowproc", saved);
+
+    expect(result.cached, "a remembered result is used");
+    expect(result.available, "a remembered processor is still found");
+    expect
+    (
+        result.output.contains("1.2.3"),
+        "a remembered processor's version output is kept"
+    );
+    expect(!saved, "a remembered result is not written back");
+    expect(timer.elapsed() < 1000, "a remembered processor isn't run");
+
+    // Changing the executable's size changes its signature.
+    if (!writeProcessor(directory, "slowproc", "echo slowproc 1.2.4"))
+    {
+        failures++;
+    }
+
+    result = runProbe(settings, "slowproc", saved);
+
+    expect(!result.cached, "a changed processor is probed again");
+    expect
+    (
+        result.output.contains("1.2.4"),
+        "a changed processor's new version output is read"
+    );
+    expect(saved, "a changed processor's result is remembered");
+
+    result = runProbe(settings, "noproc", saved);
+
+    expect(!result.available, "a missing processor isn't found");
+    expect(result.finished, "a processor that fails to start is finished");
+    expect(saved, "a missing processor is remembered as missing");
+
+    result = runProbe(settings, "noproc", saved);
+
+    expect(result.cached, "a remembered missing processor isn't run again");
+    expect(!result.available, "a remembered missing processor isn't found");
+
+    timer.start();
+    result = runProbe(settings, "hangproc", saved);
+
+    expect(result.available, "a processor that never answers is found");
+    expect(!result.finished, "a processor that never answers times out");
+    expect(!saved, "a timed out probe isn't remembered");
+    expect
+    (
+        !settings.contains("hangproc/signature"),
+        "nothing is remembered for a timed out probe"
+    );
+    expect
+    (
+        timer.elapsed() >= ProcessorProbe::TIMEOUT,
+        "a processor that never answers is given the whole timeout"
+    );
+
+    result = runProbe(settings, "hangproc", saved);
+
+    expect(!result.cached, "a timed out processor is probed again");
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QDir directory = QDir::temp();
+    QString directoryName = QString("probe_test.%1")
+        .arg(QCoreApplication::applicationPid());
+
+    if (!directory.mkpath(directoryName) || !directory.cd(directoryName))
+    {
+        fprintf(stderr, "Could not create a temporary directory.\n");
+        return EXIT_FAILURE;
+    }
+
+    if
+    (
+        !writeProcessor(directory, "slowproc", "sleep 1\necho slowproc 1.2.3")
+        || !writeProcessor(directory, "hangproc", "exec sleep 60")
+    )
+    {
+        removeDirectory(directory);
+        return EXIT_FAILURE;
+    }
+
+    qputenv
+    (
+        "PATH",
+        QFile::encodeName(directory.absolutePath()) + ':' + qgetenv("PATH")
+    );
+
+    checkProbes(directory);
+    removeDirectory(directory);
+
+    printf("%d checks failed\n", failures);
+
+    if (failures > 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+/*
+ * Checks that rendering with HTML_SMARTYPANTS, which runs smartypants over
+ * the text of each block as it is rendered, gives the same output byte for
+ * byte as running sdhtml_smartypants() over the whole of the HTML rendered
+ * without it.  The corpus is made up of the files given on the command
+ * line, a set of edge cases, and documents pieced together at random from
+ * fragments of Markdown that smartypants and the renderer treat specially.
+ *
+ *     smartypants_test [-n count] [-s seed] [file...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+
+#define GENERATED_DOCUMENT_COUNT 20000
+#define MAX_FRAGMENT_COUNT 80
+
+static const char *edge_cases[] = {
+	" * \"\n- \"",
+	"- \"a\n  - \"b\n    - c\"\n  - d\"\n- e\"",
+	"\"hello\"world",
+	"it's \"quoted\" and 'single' -- dashes --- and... (c) (tm) 1/2",
+	"<pre>\n\"raw\"\n\nstill \"raw\"</pre>\n\n\"cooked\"",
+	"a <pre>\"b\"\n\n\"c\"\n\n    \"code\"\n\n\"d\"",
+	"a <code>\"b\"\n\n```\n\"x\"\n```\n\n\"c\"",
+	"| \"a\" | 'b' |\n|---|---|\n| \"c\" | d's |",
+	"# \"Heading\"\n\n\"para\"",
+	"> \"quote\n> more\"\n\n- item \"one\n\n- item two\"",
+	"\\\"escaped\\\" \\'too\\'",
+	"``double backticks''",
+	"",
+	NULL
+};
+
+static const char *fragments[] = {
+	"\"", "'", " ", "\n", "\n\n", "- ", "* ", "1. ", "  ", "    ", "> ",
+	"#", "word", "it's", "--", "---", "...", ". . .", "(c)", "(r)", "(tm)",
+	"1/2", "1/4th", "3/4", "`", "``", "```", "~~~", "<b>", "</b>", "<pre>",
+	"</pre>", "<code>", "</code>", "<kbd>", "&amp;", "&quot;", "**", "_",
+	"[a](b)", "[a](b \"t\")", "<!-- x -->", "|", "|---|", "\t", "x\"y",
+	"\"z", "'s", "'re", "<div>\n", "</div>\n", "http://a.b \"q\"",
+	"![i](j)", "==", "\\\"", "\\'", "^", "~~",
+	NULL
+};
+
+static unsigned long random_state;
+
+static unsigned long
+next_random(void)
+{
+	random_state = random_state * 1103515245UL + 12345UL;
+	return (random_state >> 16) & 0x7fff;
+}
+
+static void
+generate_document(struct buf *doc)
+{
+	size_t fragment_count = 0, count, i;
+
+	while (fragments[fragment_count])
+		fragment_count++;
+
+	doc->size = 0;
+	count = 1 + next_random() % MAX_FRAGMENT_COUNT;
+
+	for (i = 0; i < count; ++i)
+		bufputs(doc, fragments[next_random() % fragment_count]);
+}
+
+static struct buf *
+render(const struct buf *doc, int one_pass)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_markdown *markdown;
+	struct buf *ob = bufnew(1024);
+
+	sdhtml_renderer(&callbacks, &options, one_pass ? HTML_SMARTYPANTS : 0);
+	markdown = sd_markdown_new(
+		MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_SPACE_HEADERS |
+		MKDEXT_SUPERSCRIPT | MKDEXT_STRIKETHROUGH | MKDEXT_AUTOLINK,
+		16, &callbacks, &options);
+
+	sd_markdown_render(ob, doc->data, doc->size, markdown);
+	sd_markdown_free(markdown);
+
+	if (!one_pass) {
+		struct buf *smart = bufnew(1024);
+		sdhtml_smartypants(smart, ob->data, ob->size);
+		bufrelease(ob);
+		ob = smart;
+	}
+
+	return ob;
+}
+
+/* check • renders the document both ways, and reports any difference */
+static int
+check(const struct buf *doc, const char *name)
+{
+	struct buf *two_pass = render(doc, 0);
+	struct buf *one_pass = render(doc, 1);
+	int same = two_pass->size == one_pass->size &&
+		memcmp(two_pass->data, one_pass->data, two_pass->size) == 0;
+
+	if (!same) {
+		fprintf(stderr, "MISMATCH: %s\n--- input ---\n", name);
+		fwrite(doc->data, 1, doc->size, stderr);
+		fputs("\n--- two passes ---\n", stderr);
+		fwrite(two_pass->data, 1, two_pass->size, stderr);
+		fputs("--- one pass ---\n", stderr);
+		fwrite(one_pass->data, 1, one_pass->size, stderr);
+		fputs("---\n", stderr);
+	}
+
+	bufrelease(two_pass);
+	bufrelease(one_pass);
+	return same;
+}
+
+static int
+read_file(struct buf *doc, const char *path)
+{
+	FILE *in = fopen(path, "rb");
+	size_t ret;
+
+	if (!in) {
+		perror(path);
+		return 0;
+	}
+
+	doc->size = 0;
+	bufgrow(doc, 1024);
+
+	while ((ret = fread(doc->data + doc->size, 1, doc->asize - doc->size, in)) > 0) {
+		doc->size += ret;
+		bufgrow(doc, doc->size + 1024);
+	}
+
+	fclose(in);
+	return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct buf *doc = bufnew(1024);
+	unsigned long count = GENERATED_DOCUMENT_COUNT, seed = 1, i;
+	int failures = 0, documents = 0, arg;
+	char name[64];
+
+	for (arg = 1; arg < argc; ++arg) {
+		if (!strcmp(argv[arg], "-n") && arg + 1 < argc)
+			count = strtoul(argv[++arg], NULL, 10);
+		else if (!strcmp(argv[arg], "-s") && arg + 1 < argc)
+			seed = strtoul(argv[++arg], NULL, 10);
+		else if (read_file(doc, argv[arg])) {
+			failures += !check(doc, argv[arg]);
+			documents++;
+		} else
+			failures++;
+	}
+
+	for (i = 0; edge_cases[i]; ++i) {
+		doc->size = 0;
+		bufputs(doc, edge_cases[i]);
+		sprintf(name, "edge case %lu", i);
+		failures += !check(doc, name);
+		documents++;
+	}
+
+	random_state = seed;
+
+	for (i = 0; i < count; ++i) {
+		generate_document(doc);
+		sprintf(name, "generated document %lu (seed %lu)", i, seed);
+		failures += !check(doc, name);
+		documents++;
+	}
+
+	bufrelease(doc);
+	printf("%d of %d documents differ\n", failures, documents);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,44 @@
+################################################################################
+#
+# Copyright (C) 2026 agent
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Compares sundown's one-pass smartypants rendering with the two-pass one
+# over the quick reference guides and a generated corpus.
+#
+TEMPLATE = app
+TARGET = smartypants_test
+CONFIG += console warn_on
+CONFIG -= qt app_bundle
+OBJECTS_DIR = .obj/$$TARGET
+
+INCLUDEPATH += ../../src/sundown
+
+SOURCES += smartypants_test.c \
+    ../../src/sundown/autolink.c \
+    ../../src/sundown/buffer.c \
+    ../../src/sundown/houdini_href_e.c \
+    ../../src/sundown/houdini_html_e.c \
+    ../../src/sundown/html_smartypants.c \
+    ../../src/sundown/html.c \
+    ../../src/sundown/markdown.c \
+    ../../src/sundown/scan.c \
+    ../../src/sundown/stack.c
+
+check.commands = ./$$TARGET $$files($$PWD/../../resources/*.md)
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
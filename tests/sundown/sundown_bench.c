@@ -0,0 +1,517 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+/*
+ * Times sundown over generated documents of several kinds, and reports
+ * the throughput of rendering each one to HTML, both into a single buffer
+ * and into a chunked one, as ghostwriter does.  For each document, it
+ * also times sd_scan() through the document for the characters the inline
+ * parser stops at and for the characters the HTML escaper stops at,
+ * against a byte-at-a-time loop through the same tables, and checks that
+ * both find the same characters.  The corpora are:
+ *
+ *   prose   running text with a little inline markup, in which the runs
+ *           between active characters are long;
+ *   code    fenced and indented code blocks, full of characters that
+ *           have to be escaped, between short paragraphs;
+ *   large   100 MB of both, rendered once by default, for the cost of
+ *           growing the output of a very large document;
+ *   references
+ *           prose in which every few words are a reference link, to one
+ *           of 10,000 reference definitions at the end, for the cost of
+ *           adding and looking up link references.  Every link is
+ *           checked to have been found.
+ *
+ * Each corpus is timed over a number of passes of its own, unless one is
+ * given for all of them.
+ *
+ *     sundown_bench [-p passes] [corpus...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "markdown.h"
+#include "html.h"
+#include "buffer.h"
+#include "scan.h"
+
+#define MEGABYTE (1024.0 * 1024.0)
+#define REFERENCE_COUNT 10000
+
+struct corpus {
+	const char *name;
+	void (*generate)(struct buf *doc, size_t size);
+	size_t size;
+	unsigned long passes;
+	int links_only; /* whether the HTML should have no '[' left in it */
+};
+
+static const char *words[] = {
+	"the", "of", "and", "a", "to", "in", "is", "you", "that", "it", "he",
+	"was", "for", "on", "are", "as", "with", "his", "they", "I", "at",
+	"be", "this", "have", "from", "or", "one", "had", "by", "word", "but",
+	"not", "what", "all", "were", "we", "when", "your", "can", "said",
+	"there", "use", "an", "each", "which", "she", "do", "how", "their",
+	"if", "will", "up", "other", "about", "out", "many", "then", "them",
+	"these", "so", "some", "her", "would", "make", "like", "him", "into",
+	"time", "has", "look", "two", "more", "write", "go", "see", "number",
+	"no", "way", "could", "people", "my", "than", "first", "water",
+	"been", "call", "who", "oil", "its", "now", "find", "long", "down",
+	"day", "did", "get", "come", "made", "may", "part", "chapter",
+	"manuscript", "paragraph", "character", "narrative", "distance",
+	NULL
+};
+
+static const char *code_lines[] = {
+	"static int compare(const void *a, const void *b)",
+	"{",
+	"\tconst struct entry *x = (const struct entry *)a;",
+	"\tif (x->size < y->size && x->data[0] != '\\0')",
+	"\t\treturn -1;",
+	"\tfor (i = 0; i < count; i++) {",
+	"\t\tmask |= (flags[i] & 0x0F) << (i * 4);",
+	"\t\tprintf(\"%s: <%d> \\\"%s\\\"\\n\", name, i, s);",
+	"\t}",
+	"\treturn a > b ? a - b : b - a;",
+	"}",
+	"std::vector<std::pair<int, std::string>> items;",
+	"if (a >= 0 && b <= 10 || c == '&') { x = y >> 2; }",
+	"<a href=\"/path/to/file?x=1&y=2\">link</a>",
+	"",
+	NULL
+};
+
+static unsigned long random_state = 1;
+
+static unsigned long
+next_random(void)
+{
+	random_state = random_state * 1103515245UL + 12345UL;
+	return (random_state >> 16) & 0x7fff;
+}
+
+static size_t
+count_strings(const char **strings)
+{
+	size_t count = 0;
+
+	while (strings[count])
+		count++;
+
+	return count;
+}
+
+/* generate_prose • paragraphs of wrapped sentences, with some emphasis,
+ * links and code spans */
+static void
+generate_prose(struct buf *doc, size_t size)
+{
+	size_t word_count = count_strings(words);
+	size_t column = 0, sentence = 0, i;
+
+	while (doc->size < size) {
+		size_t length = 6 + next_random() % 14;
+
+		for (i = 0; i < length; ++i) {
+			const char *word = words[next_random() % word_count];
+			unsigned long markup = next_random() % 40;
+
+			if (column > 72) {
+				bufputc(doc, '\n');
+				column = 0;
+			} else if (column > 0) {
+				bufputc(doc, ' ');
+				column++;
+			}
+
+			if (markup == 0)
+				bufprintf(doc, "*%s*", word);
+			else if (markup == 1)
+				bufprintf(doc, "[%s](http://example.com/%s)", word, word);
+			else if (markup == 2)
+				bufprintf(doc, "`%s()`", word);
+			else
+				bufputs(doc, word);
+
+			column += strlen(word) + 2;
+		}
+
+		bufputs(doc, (next_random() % 5) ? "." : ",");
+
+		if (++sentence % (4 + next_random() % 4) == 0) {
+			bufputs(doc, "\n\n");
+			column = 0;
+		}
+	}
+
+	bufputc(doc, '\n');
+}
+
+/* generate_code • fenced and indented code blocks between short
+ * paragraphs */
+static void
+generate_code(struct buf *doc, size_t size)
+{
+	size_t line_count = count_strings(code_lines);
+	size_t length, i;
+
+	while (doc->size < size) {
+		int fenced = (next_random() % 3) != 0;
+
+		bufputs(doc, "The following listing shows the change.\n\n");
+
+		if (fenced)
+			bufputs(doc, "```c\n");
+
+		length = 5 + next_random() % 30;
+
+		for (i = 0; i < length; ++i) {
+			if (!fenced)
+				bufputs(doc, "    ");
+
+			bufputs(doc, code_lines[next_random() % line_count]);
+			bufputc(doc, '\n');
+		}
+
+		if (fenced)
+			bufputs(doc, "```\n");
+
+		bufputc(doc, '\n');
+	}
+}
+
+/* generate_large • prose and code in turn */
+static void
+generate_large(struct buf *doc, size_t size)
+{
+	while (doc->size < size) {
+		generate_prose(doc, doc->size + 64 * 1024);
+		bufputc(doc, '\n');
+		generate_code(doc, doc->size + 64 * 1024);
+	}
+}
+
+/* generate_references • paragraphs of words and reference links, full,
+ * in another case and collapsed, followed by the definitions of all of
+ * them; no other text has a '[' in it */
+static void
+generate_references(struct buf *doc, size_t size)
+{
+	size_t word_count = count_strings(words);
+	size_t column = 0, words_left = 0, start, i;
+
+	while (doc->size < size) {
+		const char *word = words[next_random() % word_count];
+		unsigned long link = next_random() % 4;
+		unsigned long id = next_random() % REFERENCE_COUNT;
+
+		if (column > 72) {
+			bufputc(doc, '\n');
+			column = 0;
+		} else if (column > 0) {
+			bufputc(doc, ' ');
+		}
+
+		start = doc->size;
+
+		if (link == 0)
+			bufprintf(doc, "[%s][ref %lu]", word, id);
+		else if (link == 1)
+			bufprintf(doc, "[%s][Ref %lu]", word, id);
+		else if (link == 2)
+			bufprintf(doc, "[ref %lu][]", id);
+		else
+			bufputs(doc, word);
+
+		column += doc->size - start + 1;
+
+		if (words_left-- == 0) {
+			bufputs(doc, ".\n\n");
+			column = 0;
+			words_left = 20 + next_random() % 60;
+		}
+	}
+
+	bufputc(doc, '\n');
+
+	for (i = 0; i < REFERENCE_COUNT; ++i)
+		bufprintf(doc, "[ref %lu]: http://example.com/%lu \"Reference %lu\"\n",
+			(unsigned long)i, (unsigned long)i, (unsigned long)i);
+}
+
+static const struct corpus corpora[] = {
+	{ "prose", generate_prose, 4 * 1024 * 1024, 10, 0 },
+	{ "code", generate_code, 4 * 1024 * 1024, 10, 0 },
+	{ "large", generate_large, 100 * 1024 * 1024, 1, 0 },
+	{ "references", generate_references, 2 * 1024 * 1024, 10, 1 },
+	{ NULL, NULL, 0, 0, 0 }
+};
+
+static double
+seconds_since(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static double
+throughput(size_t bytes, unsigned long passes, double seconds)
+{
+	if (seconds <= 0.0)
+		seconds = 1.0 / CLOCKS_PER_SEC;
+
+	return (double)bytes * passes / MEGABYTE / seconds;
+}
+
+/* render • renders the document with the extensions ghostwriter uses,
+ * into a single buffer, or else into a chunked one; returns the size of
+ * the HTML, or 0 if the chunked buffer ran out of memory */
+static size_t
+render(const struct buf *doc, int rope)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_markdown *markdown;
+	size_t size = 0;
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	markdown = sd_markdown_new(
+		MKDEXT_TABLES | MKDEXT_FENCED_CODE | MKDEXT_SPACE_HEADERS |
+		MKDEXT_SUPERSCRIPT | MKDEXT_STRIKETHROUGH | MKDEXT_AUTOLINK,
+		16, &callbacks, &options);
+
+	if (rope) {
+		struct bufrope *ob = ropenew(64 * 1024);
+
+		if (sd_markdown_render_rope(ob, doc->data, doc->size, markdown, NULL) == BUF_OK)
+			size = ob->size;
+
+		roperelease(ob);
+	} else {
+		struct buf *ob = bufnew(64 * 1024);
+
+		sd_markdown_render(ob, doc->data, doc->size, markdown);
+		size = ob->size;
+		bufrelease(ob);
+	}
+
+	sd_markdown_free(markdown);
+	return size;
+}
+
+/* count_unresolved • renders the document into a single buffer and
+ * returns the number of '[' left in the HTML, each the start of a link
+ * that wasn't turned into one */
+static size_t
+count_unresolved(const struct buf *doc)
+{
+	struct sd_callbacks callbacks;
+	struct html_renderopt options;
+	struct sd_markdown *markdown;
+	struct buf *ob = bufnew(64 * 1024);
+	size_t count = 0, i;
+
+	sdhtml_renderer(&callbacks, &options, 0);
+	markdown = sd_markdown_new(0, 16, &callbacks, &options);
+	sd_markdown_render(ob, doc->data, doc->size, markdown);
+
+	for (i = 0; i < ob->size; ++i)
+		count += (ob->data[i] == '[');
+
+	sd_markdown_free(markdown);
+	bufrelease(ob);
+	return count;
+}
+
+/* count_scan • number of bytes of data in the set, found with sd_scan */
+static size_t
+count_scan(const struct sd_scan_set *set, const uint8_t *data, size_t size)
+{
+	size_t i = 0, count = 0;
+
+	while (i < size) {
+		i += sd_scan(set, data + i, size - i);
+
+		if (i < size) {
+			count++;
+			i++;
+		}
+	}
+
+	return count;
+}
+
+/* count_table • the same, stopping at each byte of data in the set on the
+ * way through, as the loops sd_scan replaced did */
+static size_t
+count_table(const struct sd_scan_set *set, const uint8_t *data, size_t size)
+{
+	size_t i = 0, count = 0;
+
+	while (i < size) {
+		while (i < size && (set->table[data[i]] == 0) != set->inverted)
+			i++;
+
+		if (i < size) {
+			count++;
+			i++;
+		}
+	}
+
+	return count;
+}
+
+/* time_scan • times both ways of finding the set in the document, and
+ * reports their throughput; returns 0 if they differ */
+static int
+time_scan(const struct buf *doc, const char *name, const uint8_t *table,
+	unsigned long passes)
+{
+	struct sd_scan_set set;
+	size_t scanned = 0, tabled = 0;
+	double scan_seconds, table_seconds;
+	unsigned long pass;
+	clock_t start;
+
+	sd_scan_set_init(&set, table, 0);
+
+	start = clock();
+	for (pass = 0; pass < passes; ++pass)
+		scanned = count_scan(&set, doc->data, doc->size);
+	scan_seconds = seconds_since(start);
+
+	start = clock();
+	for (pass = 0; pass < passes; ++pass)
+		tabled = count_table(&set, doc->data, doc->size);
+	table_seconds = seconds_since(start);
+
+	printf("  %-20s sd_scan %8.1f MB/s, table %8.1f MB/s (%lu found)\n",
+		name, throughput(doc->size, passes, scan_seconds),
+		throughput(doc->size, passes, table_seconds),
+		(unsigned long)scanned);
+
+	if (scanned != tabled) {
+		fprintf(stderr, "MISMATCH: %s: sd_scan found %lu, the table %lu\n",
+			name, (unsigned long)scanned, (unsigned long)tabled);
+		return 0;
+	}
+
+	return 1;
+}
+
+/* bench • generates the corpus and times it; returns 0 on a mismatch */
+static int
+bench(const struct corpus *corpus, unsigned long passes)
+{
+	static const char *active = "*_~`\n[<\\&:@w^";
+	static const char *escaped = "\"&'/<>";
+	uint8_t active_table[256], escape_table[256];
+	struct buf *doc = bufnew(64 * 1024);
+	unsigned long pass;
+	size_t html_size = 0, rope_size = 0, i;
+	double seconds, rope_seconds;
+	clock_t start;
+	int ok = 1;
+
+	memset(active_table, 0, sizeof(active_table));
+	memset(escape_table, 0, sizeof(escape_table));
+
+	for (i = 0; active[i]; ++i)
+		active_table[(uint8_t)active[i]] = 1;
+
+	for (i = 0; escaped[i]; ++i)
+		escape_table[(uint8_t)escaped[i]] = 1;
+
+	random_state = 1;
+	corpus->generate(doc, corpus->size);
+
+	start = clock();
+	for (pass = 0; pass < passes; ++pass)
+		html_size = render(doc, 0);
+	seconds = seconds_since(start);
+
+	start = clock();
+	for (pass = 0; pass < passes; ++pass)
+		rope_size = render(doc, 1);
+	rope_seconds = seconds_since(start);
+
+	printf("%s (%lu KB of Markdown, %lu KB of HTML)\n", corpus->name,
+		(unsigned long)(doc->size / 1024),
+		(unsigned long)(html_size / 1024));
+	printf("  %-20s %8.1f MB/s, to a rope %8.1f MB/s\n", "render",
+		throughput(doc->size, passes, seconds),
+		throughput(doc->size, passes, rope_seconds));
+
+	if (rope_size != html_size) {
+		fprintf(stderr, "MISMATCH: %s: %lu bytes of HTML in a rope, %lu in a buffer\n",
+			corpus->name, (unsigned long)rope_size, (unsigned long)html_size);
+		ok = 0;
+	}
+
+	if (corpus->links_only) {
+		size_t unresolved = count_unresolved(doc);
+
+		if (unresolved) {
+			fprintf(stderr, "MISMATCH: %s: %lu links not found\n",
+				corpus->name, (unsigned long)unresolved);
+			ok = 0;
+		}
+	}
+
+	ok &= time_scan(doc, "active characters", active_table, passes);
+	ok &= time_scan(doc, "HTML escapes", escape_table, passes);
+
+	bufrelease(doc);
+	return ok;
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned long passes = 0;
+	int failures = 0, named = 0, arg;
+	size_t i;
+
+	for (arg = 1; arg < argc; ++arg) {
+		if (!strcmp(argv[arg], "-p") && arg + 1 < argc) {
+			passes = strtoul(argv[++arg], NULL, 10);
+			continue;
+		}
+
+		for (i = 0; corpora[i].name; ++i)
+			if (!strcmp(argv[arg], corpora[i].name))
+				break;
+
+		if (!corpora[i].name) {
+			fprintf(stderr, "unknown corpus: %s\n", argv[arg]);
+			return EXIT_FAILURE;
+		}
+
+		failures += !bench(&corpora[i], passes ? passes : corpora[i].passes);
+		named++;
+	}
+
+	if (!named)
+		for (i = 0; corpora[i].name; ++i)
+			failures += !bench(&corpora[i], passes ? passes : corpora[i].passes);
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+################################################################################
+#
+# Copyright (C) 2026 agent
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Times sundown's rendering of generated prose, code, a 100 MB document of
+# both and text linking to 10,000 reference definitions, and its scanning
+# for the characters that end runs of plain text.  "make check" runs it
+# once to check that the vector scanner finds the same characters as the
+# table, that rendering into a chunked buffer gives as much HTML as
+# rendering into a single one, and that every reference link is found.
+# "make benchmark" runs it for timing.
+#
+TEMPLATE = app
+TARGET = sundown_bench
+CONFIG += console warn_on
+CONFIG -= qt app_bundle
+OBJECTS_DIR = .obj/$$TARGET
+
+INCLUDEPATH += ../../src/sundown
+
+SOURCES += sundown_bench.c \
+    ../../src/sundown/autolink.c \
+    ../../src/sundown/buffer.c \
+    ../../src/sundown/houdini_href_e.c \
+    ../../src/sundown/houdini_html_e.c \
+    ../../src/sundown/html_smartypants.c \
+    ../../src/sundown/html.c \
+    ../../src/sundown/markdown.c \
+    ../../src/sundown/scan.c \
+    ../../src/sundown/stack.c
+
+check.commands = ./$$TARGET -p 1
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
+
+benchmark.commands = ./$$TARGET
+benchmark.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += benchmark
@@ -0,0 +1,26 @@
+################################################################################
+#
+# Copyright (C) 2026 agent
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Checks and benchmarks for ghostwriter's rendering and highlighting code.
+# Build them with qmake and make from this directory, then run the checks
+# with "make check".
+#
+TEMPLATE = subdirs
+SUBDIRS = sundown highlighter exporter
+unix: SUBDIRS += probe worker
@@ -0,0 +1,54 @@
+--[[
+  Stands in for pandoc's Lua interpreter under a plain Lua interpreter, so
+  that ghostwriter's render worker script can be checked without pandoc
+  installed:
+
+      lua pandoc-standin.lua render-worker.lua <input format> [--smart]
+
+  The pandoc module it provides renders each document as escaped
+  preformatted text, labelled with the reader that pandoc would have been
+  asked for and with the number of documents this process has rendered, so
+  that a check can tell whether the worker was kept running.  A document
+  of "!error" raises an error while it is read, and a document of "!exit"
+  makes the process exit.
+--]]
+
+local entities =
+{
+    ["&"] = "&amp;",
+    ["<"] = "&lt;",
+    [">"] = "&gt;",
+    ['"'] = "&quot;"
+}
+
+local renders = 0
+
+pandoc = {}
+
+function pandoc.read(text, reader)
+    if text == "!error" then
+        error("stand-in read error", 0)
+    elseif text == "!exit" then
+        os.exit(1)
+    end
+
+    return { text = text, reader = reader }
+end
+
+function pandoc.write(document, format)
+    renders = renders + 1
+
+    return string.format
+    (
+        '<pre data-reader="%s" data-format="%s" data-render="%d">%s</pre>\n',
+        document.reader,
+        format,
+        renders,
+        (document.text:gsub('[&<>"]', entities))
+    )
+end
+
+local script = table.remove(arg, 1)
+
+arg[0] = script
+dofile(script)
@@ -0,0 +1,50 @@
+################################################################################
+#
+# Copyright (C) 2026 agent
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+################################################################################
+
+# Checks the Live HTML Preview's render worker protocol end to end, running
+# the render worker script that is shipped for pandoc under a plain Lua
+# interpreter with a stand-in for pandoc, and checks that renders fall back
+# to one process each when the worker can't be used.  Needs "lua" in the
+# PATH.  Render workers aren't used on Windows.
+#
+TEMPLATE = app
+TARGET = worker_test
+QT += concurrent
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../src
+
+HEADERS += ../../src/CommandLineExporter.h \
+    ../../src/ExportFormat.h \
+    ../../src/ExportJob.h \
+    ../../src/Exporter.h \
+    ../../src/RenderCache.h
+
+SOURCES += worker_test.cpp \
+    ../../src/CommandLineExporter.cpp \
+    ../../src/ExportFormat.cpp \
+    ../../src/ExportJob.cpp \
+    ../../src/Exporter.cpp \
+    ../../src/RenderCache.cpp
+
+check.commands = ./$$TARGET $$PWD/../../resources/render-worker.lua \
+    $$PWD/pandoc-standin.lua
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
@@ -0,0 +1,287 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2026 agent
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+/*
+ * Checks CommandLineExporter's render workers end to end, with the render
+ * worker script shipped for pandoc run by a plain Lua interpreter under
+ * pandoc-standin.lua:
+ *
+ *   - Documents, including empty lines, multibyte UTF-8 text and a large
+ *     document, come back from the worker whole.
+ *   - The worker is kept running between renders, and is given the input
+ *     format and smart typography argument.
+ *   - An error raised by the processor is shown as a failed export, and
+ *     the worker carries on.
+ *   - A worker that exits is started again for the next render, while the
+ *     render it exited on falls back to the HTML render command.
+ *   - Renders fall back to the HTML render command for a worker that
+ *     can't be started, or that doesn't follow the protocol, straight
+ *     away rather than after waiting on the worker again.
+ *
+ *     worker_test render-worker.lua pandoc-standin.lua
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QString>
+
+#include "CommandLineExporter.h"
+
+// Time in milliseconds under which renders that fall back to the HTML
+// render command should be done, which is well under the time a render
+// worker is given to start.
+//
+#define FALLBACK_TIME_LIMIT 5000
+
+static int failures = 0;
+
+static void expect(bool condition, const char* description)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", description);
+        failures++;
+    }
+}
+
+/*
+ * Returns the HTML that pandoc-standin.lua gives for the given document
+ * as the given render of its process.
+ */
+static QString standInHtml
+(
+    const QString& text,
+    const QString& reader,
+    int render
+)
+{
+    QString escapedText = text;
+
+    escapedText.replace('&', "&amp;");
+    escapedText.replace('<', "&lt;");
+    escapedText.replace('>', "&gt;");
+    escapedText.replace('"', "&quot;");
+
+    return QString
+        (
+            "<pre data-reader=\"%1\" data-format=\"html\" "
+            "data-render=\"%2\">%3</pre>\n"
+        )
+        .arg(reader)
+        .arg(render)
+        .arg(escapedText);
+}
+
+static QString exportToHtml
+(
+    CommandLineExporter& exporter,
+    const QString& text,
+    bool smartTypographyEnabled = false
+)
+{
+    ExportOptions options;
+    QString html;
+
+    options.smartTypographyEnabled = smartTypographyEnabled;
+    exporter.exportToHtml(text, options, html);
+    return html;
+}
+
+/*
+ * Checks the worker running the given script under the pandoc stand-in.
+ */
+static void checkWorker(const QString& scriptPath, const QString& standInPath)
+{
+    CommandLineExporter exporter("Stand-in");
+    QString text = "# Heading\n\nSome \"text\" & <b>tags</b>.\n\n\n"
+        "Second paragraph.\n";
+    QString unicodeText = QString::fromUtf8
+    (
+        "Caf\xc3\xa9 \xe2\x82\xac 100 \xf0\x9f\x98\x80\r\ncarriage return\n"
+    );
+    QString largeText;
+
+    while (largeText.length() < (1024 * 1024))
+    {
+        largeText += text;
+    }
+
+    // The HTML render command gives the text back as it is, so that a
+    // render that fell back to it can be told apart from the worker's.
+    //
+    exporter.setHtmlRenderCommand("cat");
+    exporter.setSmartTypographyOnArgument("--smart");
+    exporter.setHtmlRenderWorkerCommand
+    (
+        QString("lua \"%1\" \"%2\" commonmark %3")
+            .arg(standInPath)
+            .arg(scriptPath)
+            .arg(CommandLineExporter::SMART_TYPOGRAPHY_ARG)
+    );
+
+    expect
+    (
+        exportToHtml(exporter, text)
+            == standInHtml(text, "commonmark-smart", 1),
+        "a document is rendered by the worker"
+    );
+    expect
+    (
+        exportToHtml(exporter, text)
+            == standInHtml(text, "commonmark-smart", 2),
+        "the worker is kept running between renders"
+    );
+    expect
+    (
+        exportToHtml(exporter, unicodeText)
+            == standInHtml(unicodeText, "commonmark-smart", 3),
+        "multibyte UTF-8 text comes back whole"
+    );
+    expect
+    (
+        exportToHtml(exporter, largeText)
+            == standInHtml(largeText, "commonmark-smart", 4),
+        "a large document comes back whole"
+    );
+    expect
+    (
+        exportToHtml(exporter, QString("")).isEmpty(),
+        "an empty document gives empty HTML"
+    );
+
+    // Smart typography is a different command, and so a worker of its
+    // own.
+    //
+    expect
+    (
+        exportToHtml(exporter, text, true)
+            == standInHtml(text, "commonmark+smart", 1),
+        "the smart typography argument is passed to the worker"
+    );
+
+    QString html = exportToHtml(exporter, "!error");
+
+    expect
+    (
+        html.contains("stand-in read error") && !html.contains("<pre"),
+        "an error raised by the processor is shown as a failed export"
+    );
+    expect
+    (
+        exportToHtml(exporter, text)
+            == standInHtml(text, "commonmark-smart", 5),
+        "the worker carries on after an error"
+    );
+    expect
+    (
+        exportToHtml(exporter, "!exit") == "!exit",
+        "the render on which the worker exits falls back to the render "
+        "command"
+    );
+    expect
+    (
+        exportToHtml(exporter, text)
+            == standInHtml(text, "commonmark-smart", 1),
+        "a worker that exited is started again"
+    );
+}
+
+/*
+ * Checks that renders with the given worker command, which can't be used,
+ * fall back to the HTML render command straight away.
+ */
+static void checkFallback
+(
+    const QString& workerCommand,
+    const char* description
+)
+{
+    CommandLineExporter exporter("Fallback");
+    QString text = "Some text.\n";
+    QElapsedTimer timer;
+    bool fellBack = true;
+
+    exporter.setHtmlRenderCommand("cat");
+    exporter.setHtmlRenderWorkerCommand(workerCommand);
+
+    timer.start();
+
+    for (int i = 0; i < 5; i++)
+    {
+        fellBack = fellBack && (exportToHtml(exporter, text) == text);
+    }
+
+    expect(fellBack, description);
+    expect
+    (
+        timer.elapsed() < FALLBACK_TIME_LIMIT,
+        "a worker that can't be used is given up on straight away"
+    );
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s render-worker.lua pandoc-standin.lua\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    QString scriptPath = QString::fromLocal8Bit(argv[1]);
+    QString standInPath = QString::fromLocal8Bit(argv[2]);
+    QProcess lua;
+
+    lua.start("lua -v");
+
+    if (!lua.waitForStarted() || !lua.waitForFinished())
+    {
+        printf("SKIPPED: lua isn't installed\n");
+        return EXIT_SUCCESS;
+    }
+
+    checkWorker(scriptPath, standInPath);
+    checkFallback
+    (
+        QString("lua \"%1\" \"%2.missing\" markdown")
+            .arg(standInPath)
+            .arg(scriptPath),
+        "renders fall back for a worker that exits on starting"
+    );
+    checkFallback
+    (
+        "cat",
+        "renders fall back for a worker that doesn't follow the protocol"
+    );
+
+    printf("%d checks failed\n", failures);
+
+    if (failures > 0)
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}